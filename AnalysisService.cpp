@@ -0,0 +1,218 @@
+/*
+* Copyright 2026 Rochus Keller <mailto:me@rochus-keller.ch>
+*
+* This file is part of the EbnfStudio application.
+*
+* The following is the license that applies to this copy of the
+* application. For a license to use the application under conditions
+* other than those described here, please email to me@rochus-keller.ch.
+*
+* GNU General Public License Usage
+* This file may be used under the terms of the GNU General Public
+* License (GPL) versions 2.0 or 3.0 as published by the Free Software
+* Foundation and appearing in the file LICENSE.GPL included in
+* the packaging of this file. Please review the following information
+* to ensure GNU General Public Licensing requirements will be met:
+* http://www.fsf.org/licensing/licenses/info/GPLv2.html and
+* http://www.gnu.org/copyleft/gpl.html.
+*/
+
+#include "AnalysisService.h"
+#include "EbnfLexer.h"
+#include "EbnfParser.h"
+#include "FirstFollowSet.h"
+#include "EbnfAnalyzer.h"
+#include "EbnfAnalyzer2.h"
+#include <QCoreApplication>
+#include <QRunnable>
+#include <QEvent>
+#include <QThread>
+
+static const QEvent::Type s_doneEvent = QEvent::Type( QEvent::registerEventType() );
+
+class AnalysisService::Done : public QEvent
+{
+public:
+    Result* d_res; // zero if the job was cancelled
+    Done( Result* res ):QEvent(s_doneEvent),d_res(res){}
+    ~Done()
+    {
+        // also if the event is discarded together with the service
+        if( d_res )
+            delete d_res->d_tbl;
+        delete d_res;
+    }
+};
+
+class AnalysisService::Job : public QRunnable
+{
+public:
+    AnalysisService* d_service;
+    QThread* d_target;
+    quint32 d_id;
+    Mode d_mode;
+    int d_threads;
+    QByteArray d_text;
+    EbnfSyntax::Keywords d_keywords;
+    QSharedPointer<QAtomicInt> d_cancel;
+    EbnfErrors* d_sink; // set on the syntax before it is published
+
+    Job():d_service(0),d_target(0),d_id(0),d_mode(ParseOnly),d_threads(1),d_sink(0){}
+    bool isCancelled() const { return d_cancel->load() != 0; }
+    void run()
+    {
+        Result* res = 0;
+        if( !isCancelled() )
+            res = process();
+        if( res && isCancelled() )
+        {
+            delete res->d_tbl;
+            delete res;
+            res = 0;
+        }
+        if( res && res->d_tbl )
+            res->d_tbl->moveToThread( d_target );
+        QCoreApplication::postEvent( d_service, new Done(res) );
+    }
+    Result* process()
+    {
+        Result* res = new Result();
+        res->d_id = d_id;
+        res->d_mode = d_mode;
+
+        // the errors object lives and dies in this thread; only the entries are handed over
+        EbnfErrors errs;
+        errs.setBuffered(true);
+        if( d_mode == ParseOnly )
+            res->d_syn = reparse( &errs );
+        else
+            res->d_syn = parse( &errs );
+        if( res->d_syn.data() && !isCancelled() )
+        {
+            res->d_keywords = res->d_syn->getKeywords();
+            res->d_syn->finishSyntax();
+            if( d_mode != ParseOnly && !isCancelled() )
+            {
+                FirstFollowSet* tbl = new FirstFollowSet();
+                tbl->setSyntax( res->d_syn.data() );
+                if( d_mode == AnalyzeExact )
+                    EbnfAnalyzer2::checkForAmbiguity( tbl, &errs, 0, d_threads, d_cancel.data() );
+                else
+                    EbnfAnalyzer::checkForAmbiguity( tbl, &errs );
+                res->d_tbl = tbl;
+            }
+        }
+        if( res->d_syn.data() )
+            res->d_syn->setErrs(d_sink); // the receivers must not modify the published syntax
+        res->d_issues = errs.getBuffer();
+        return res;
+    }
+    EbnfSyntaxRef parse( EbnfErrors* errs )
+    {
+        EbnfLexer l;
+        l.setKeywords( d_keywords );
+        l.setBuffer( d_text );
+        EbnfParser p;
+        p.setErrors(errs);
+        if( p.parse( &l ) )
+            return EbnfSyntaxRef( p.getSyntax() );
+        else
+            return EbnfSyntaxRef();
+    }
+    EbnfSyntaxRef reparse( EbnfErrors* errs )
+    {
+        QMutexLocker lock( &d_service->d_workLock );
+        QList<Working>& working = d_service->d_working;
+        EbnfSyntaxRef syn;
+        for( int i = 0; i < working.size(); i++ )
+        {
+            // only a syntax nobody else refers to can be modified
+            if( working[i].d_syn->ref.load() == 1 && working[i].d_keywords == d_keywords &&
+                    working[i].d_text != d_text ) // finishSyntax would not report again
+            {
+                Working w = working.takeAt(i);
+                w.d_syn->setErrs(errs);
+                EbnfParser p;
+                if( p.reparse( w.d_syn.data(), w.d_text, d_text ) )
+                    syn = w.d_syn;
+                else
+                    w.d_syn->setErrs(0);
+                break;
+            }
+        }
+        if( syn.data() == 0 )
+            syn = parse( errs );
+        if( syn.data() )
+        {
+            Working w;
+            w.d_syn = syn;
+            w.d_text = d_text;
+            w.d_keywords = d_keywords;
+            working.prepend(w);
+            // one is usually still shown by the receivers, the other one can be modified
+            while( working.size() > 2 )
+                working.removeLast();
+        }
+        return syn;
+    }
+};
+
+AnalysisService::AnalysisService(QObject *parent) : QObject(parent),d_errs(0),d_lastId(0),d_pending(0)
+{
+    // one job at a time; a superseded job releases the thread at its next checkpoint
+    d_pool.setMaxThreadCount(1);
+}
+
+AnalysisService::~AnalysisService()
+{
+    cancel();
+    d_pool.waitForDone();
+    delete d_result.d_tbl;
+}
+
+quint32 AnalysisService::post(const QByteArray& text, const EbnfSyntax::Keywords& kw, Mode mode, int threads)
+{
+    cancel();
+    d_cancel = QSharedPointer<QAtomicInt>( new QAtomicInt(0) );
+    Job* job = new Job();
+    job->d_service = this;
+    job->d_target = thread();
+    job->d_id = ++d_lastId;
+    job->d_mode = mode;
+    job->d_threads = threads;
+    job->d_text = text;
+    job->d_keywords = kw;
+    job->d_cancel = d_cancel;
+    job->d_sink = d_errs;
+    d_pending++;
+    d_pool.start(job);
+    return job->d_id;
+}
+
+void AnalysisService::cancel()
+{
+    if( !d_cancel.isNull() )
+        d_cancel->fetchAndStoreOrdered(1);
+}
+
+FirstFollowSet* AnalysisService::takeTable()
+{
+    FirstFollowSet* tbl = d_result.d_tbl;
+    d_result.d_tbl = 0;
+    return tbl;
+}
+
+bool AnalysisService::event(QEvent* e)
+{
+    if( e->type() != s_doneEvent )
+        return QObject::event(e);
+    d_pending--;
+    Done* done = static_cast<Done*>(e);
+    if( done->d_res == 0 || done->d_res->d_id != d_lastId )
+        return true; // stale, Done cleans up
+    delete d_result.d_tbl;
+    d_result = *done->d_res;
+    done->d_res->d_tbl = 0;
+    emit sigFinished();
+    return true;
+}
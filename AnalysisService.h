@@ -0,0 +1,89 @@
+#ifndef ANALYSISSERVICE_H
+#define ANALYSISSERVICE_H
+
+/*
+* Copyright 2026 Rochus Keller <mailto:me@rochus-keller.ch>
+*
+* This file is part of the EbnfStudio application.
+*
+* The following is the license that applies to this copy of the
+* application. For a license to use the application under conditions
+* other than those described here, please email to me@rochus-keller.ch.
+*
+* GNU General Public License Usage
+* This file may be used under the terms of the GNU General Public
+* License (GPL) versions 2.0 or 3.0 as published by the Free Software
+* Foundation and appearing in the file LICENSE.GPL included in
+* the packaging of this file. Please review the following information
+* to ensure GNU General Public Licensing requirements will be met:
+* http://www.fsf.org/licensing/licenses/info/GPLv2.html and
+* http://www.gnu.org/copyleft/gpl.html.
+*/
+
+#include <QObject>
+#include <QThreadPool>
+#include <QSharedPointer>
+#include <QAtomicInt>
+#include <QMutex>
+#include "EbnfSyntax.h"
+#include "EbnfErrors.h"
+
+class FirstFollowSet;
+
+// Parses and analyzes a snapshot of the editor text on a worker thread and publishes the syntax
+// and the issues in the thread of the service. A new post() supersedes all previous ones: a
+// running job stops at its next checkpoint and results of stale jobs are dropped. ParseOnly jobs
+// reparse only the edited productions of a syntax which is no longer referenced by the receivers.
+class AnalysisService : public QObject
+{
+    Q_OBJECT
+public:
+    enum Mode { ParseOnly, Analyze, AnalyzeExact };
+    struct Result
+    {
+        quint32 d_id;
+        Mode d_mode;
+        EbnfSyntaxRef d_syn; // null if the parser failed; not modified anymore once published
+        EbnfSyntax::Keywords d_keywords; // as extended by the lexer
+        QList<EbnfErrors::Entry> d_issues; // in report order
+        FirstFollowSet* d_tbl; // only with Analyze and AnalyzeExact, see takeTable
+        Result():d_id(0),d_mode(ParseOnly),d_tbl(0){}
+    };
+
+    explicit AnalysisService(QObject *parent = 0);
+    ~AnalysisService();
+
+    quint32 post( const QByteArray& text, const EbnfSyntax::Keywords&, Mode = ParseOnly, int threads = 1 );
+    void setErrs( EbnfErrors* errs ) { d_errs = errs; } // of the published syntax, for later reports
+    void cancel();
+    bool isBusy() const { return d_pending > 0; }
+
+    // valid in the slots connected to sigFinished
+    const Result& getResult() const { return d_result; }
+    FirstFollowSet* takeTable(); // the caller becomes the owner
+
+signals:
+    void sigFinished();
+
+protected:
+    bool event(QEvent*);
+private:
+    class Job;
+    class Done;
+    struct Working
+    {
+        EbnfSyntaxRef d_syn;
+        QByteArray d_text;
+        EbnfSyntax::Keywords d_keywords;
+    };
+    QList<Working> d_working; // most recent first, only used by the jobs
+    QMutex d_workLock;
+    QThreadPool d_pool;
+    QSharedPointer<QAtomicInt> d_cancel; // of the most recent job
+    Result d_result;
+    EbnfErrors* d_errs;
+    quint32 d_lastId;
+    int d_pending;
+};
+
+#endif // ANALYSISSERVICE_H
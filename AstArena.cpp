@@ -0,0 +1,82 @@
+/*
+* Copyright 2026 Rochus Keller <mailto:me@rochus-keller.ch>
+*
+* This file is part of the EbnfStudio application.
+*
+* The following is the license that applies to this copy of the
+* application. For a license to use the application under conditions
+* other than those described here, please email to me@rochus-keller.ch.
+*
+* GNU General Public License Usage
+* This file may be used under the terms of the GNU General Public
+* License (GPL) versions 2.0 or 3.0 as published by the Free Software
+* Foundation and appearing in the file LICENSE.GPL included in
+* the packaging of this file. Please review the following information
+* to ensure GNU General Public Licensing requirements will be met:
+* http://www.fsf.org/licensing/licenses/info/GPLv2.html and
+* http://www.gnu.org/copyleft/gpl.html.
+*/
+
+#include "AstArena.h"
+#include <stdlib.h>
+
+static const quint32 s_blockSize = 32 * 1024;
+static const quint32 s_align = 8;
+
+AstArena::AstArena():d_cur(0),d_left(0),d_allocated(0)
+{
+}
+
+AstArena::~AstArena()
+{
+    clear();
+}
+
+void* AstArena::allocate(size_t size)
+{
+    size = ( size + s_align - 1 ) & ~size_t( s_align - 1 );
+    if( size > s_blockSize / 4 )
+    {
+        // large objects get their own block, the current one is continued afterwards
+        char* b = (char*)::malloc( size );
+        Q_CHECK_PTR( b );
+        d_blocks.prepend( b );
+        d_allocated += size;
+        return b;
+    }
+    if( size > d_left )
+    {
+        d_cur = (char*)::malloc( s_blockSize );
+        Q_CHECK_PTR( d_cur );
+        d_blocks.append( d_cur );
+        d_left = s_blockSize;
+        d_allocated += s_blockSize;
+    }
+    void* res = d_cur;
+    d_cur += size;
+    d_left -= size;
+    return res;
+}
+
+void AstArena::adopt(AstArena& other)
+{
+    if( &other == this )
+        return;
+    // the current block stays the last one
+    d_blocks = other.d_blocks + d_blocks;
+    d_allocated += other.d_allocated;
+    other.d_blocks.clear();
+    other.d_cur = 0;
+    other.d_left = 0;
+    other.d_allocated = 0;
+}
+
+void AstArena::clear()
+{
+    foreach( char* b, d_blocks )
+        ::free( b );
+    d_blocks.clear();
+    d_cur = 0;
+    d_left = 0;
+    d_allocated = 0;
+}
@@ -0,0 +1,45 @@
+#ifndef ASTARENA_H
+#define ASTARENA_H
+
+/*
+* Copyright 2026 Rochus Keller <mailto:me@rochus-keller.ch>
+*
+* This file is part of the EbnfStudio application.
+*
+* The following is the license that applies to this copy of the
+* application. For a license to use the application under conditions
+* other than those described here, please email to me@rochus-keller.ch.
+*
+* GNU General Public License Usage
+* This file may be used under the terms of the GNU General Public
+* License (GPL) versions 2.0 or 3.0 as published by the Free Software
+* Foundation and appearing in the file LICENSE.GPL included in
+* the packaging of this file. Please review the following information
+* to ensure GNU General Public Licensing requirements will be met:
+* http://www.fsf.org/licensing/licenses/info/GPLv2.html and
+* http://www.gnu.org/copyleft/gpl.html.
+*/
+
+#include <QList>
+
+// Bump allocator for the nodes, definitions and symbols of a syntax. Memory is only returned all at once by
+// clear() or the destructor; the owner still has to run the destructors of the objects.
+class AstArena
+{
+public:
+    AstArena();
+    ~AstArena();
+
+    void* allocate( size_t );
+    void adopt( AstArena& ); // takes over the memory of the other arena, which is empty afterwards
+    void clear();
+    quint32 getAllocated() const { return d_allocated; } // in bytes, including the unused rest of blocks
+private:
+    Q_DISABLE_COPY(AstArena)
+    QList<char*> d_blocks;
+    char* d_cur;
+    quint32 d_left;
+    quint32 d_allocated;
+};
+
+#endif // ASTARENA_H
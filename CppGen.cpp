@@ -23,12 +23,14 @@
 #include "EbnfAnalyzer.h"
 #include "EbnfAnalyzer2.h"
 #include "LaParser.h"
+#include "Tracer.h"
 #include <QFile>
 #include <QTextStream>
 #include <QDir>
 #include <QtDebug>
+#include <algorithm>
 
-CppGen::CppGen():d_tbl(0),d_syn(0),d_pseudoKeywords(false),d_genSynTree(false),d_exact(true)
+CppGen::CppGen():d_tbl(0),d_syn(0),d_flat(0),d_pseudoKeywords(false),d_genSynTree(false),d_exact(true),d_firstK(0),d_llk(0)
 {
 
 }
@@ -37,6 +39,7 @@ bool CppGen::generate(const QString& ebnfPath, EbnfSyntax* syn, FirstFollowSet*
 {
     if( syn == 0 || syn->getOrderedDefs().isEmpty() )
         return false;
+    TraceSpan span("CppGen.generate");
 
     Q_ASSERT( syn != 0 );
     tbl->setSyntax(syn);
@@ -53,6 +56,9 @@ bool CppGen::generate(const QString& ebnfPath, EbnfSyntax* syn, FirstFollowSet*
 
     d_tbl = tbl;
     d_syn = syn;
+    d_flat = &syn->getFlat();
+    FirstKCache firstK(syn);
+    d_llk = ( d_firstK != 0 && d_firstK->getSyntax() == syn ) ? d_firstK : &firstK;
 
     const Ast::Definition* root = syn->getOrderedDefs()[0];
 
@@ -151,6 +157,9 @@ bool CppGen::generate(const QString& ebnfPath, EbnfSyntax* syn, FirstFollowSet*
         if( d->d_node == 0 ) // || d->d_tok.d_op == EbnfToken::Transparent )
             continue;
 
+        TraceSpan first("CppGen.firstSet");
+        if( first.isActive() )
+            first.addArg("def", d->d_tok.d_val.toBa());
         bout << "static inline bool FIRST_" << d->d_tok.d_val.toStr() << "(int tt) {" << endl;
         //EbnfAnalyzer::LlkNodes firsts;
         //EbnfAnalyzer::calcLlkFirstSet(1,firsts,d->d_node,tbl);
@@ -265,17 +274,20 @@ bool CppGen::generate(const QString& ebnfPath, EbnfSyntax* syn, FirstFollowSet*
         if( d->d_node == 0 ) // || d->d_tok.d_op == EbnfToken::Transparent )
             continue;
 
+        TraceSpan prod("CppGen.production");
+        if( prod.isActive() )
+            prod.addArg("def", d->d_tok.d_val.toBa());
         bout << "void Parser::" << d->d_tok.d_val.toStr() << (d_genSynTree ?"(SynTree* st) {":"() {") << endl;
         if( d_genSynTree && d->d_tok.d_op != EbnfToken::Transparent )
         {
             bout << "\t" << "{ SynTree* tmp = new SynTree(SynTree::R_" << d->d_tok.d_val.toStr() << ", la); ";
             bout << "st->d_children.append(tmp); st = tmp; }" << endl;
         }
-        writeNode( bout, d->d_node, 0 );
+        writeNode( bout, d_flat->getBody(i), 0 );
         bout << "}" << endl << endl;
     }
 
-
+    d_llk = 0;
     return true;
 }
 
@@ -295,6 +307,7 @@ bool CppGen::writeVisitor(const QString& path, EbnfSyntax* syn, FirstFollowSet*
     const QByteArray nameSpace = syn->getPragmaFirst("%namespace").toBa();
 
     d_tbl = tbl;
+    d_flat = &syn->getFlat();
     d_syn = syn;
 
     QFile body( path );
@@ -328,7 +341,7 @@ bool CppGen::writeVisitor(const QString& path, EbnfSyntax* syn, FirstFollowSet*
         bout << ws(2) << "SynTree* sub = st->d_children[i];" << endl;
         bout << ws(2) << "switch(sub->d_tok.d_type) {" << endl;
         QSet<EbnfToken::Sym> unique;
-        writeNode2( bout, d->d_node, unique );
+        writeNode2( bout, d_flat->getBody(i), unique );
         bout << ws(2) << "}" << endl;
         bout << ws(1) << "}" << endl;
         bout << ws(0) << "}" << endl << endl;
@@ -391,10 +404,11 @@ void CppGen::writeCond( QTextStream& out, bool loop, const QList<const Ast::Node
     out << " ) {" << endl;
 }
 
-void CppGen::writeNode(QTextStream& out, Ast::Node* node, int level)
+void CppGen::writeNode(QTextStream& out, int id, int level)
 {
-    if( node == 0 )
+    if( id == -1 )
         return;
+    const Ast::Node* node = d_flat->getNode(id);
 
     if( node->d_tok.d_op == EbnfToken::Skip )
         return;
@@ -413,12 +427,12 @@ void CppGen::writeNode(QTextStream& out, Ast::Node* node, int level)
         break;
     case Ast::Node::ZeroOrOne:
         out << ws(level);
-        writeCond(out, false, findFirstsOf(node));
+        writeCond(out, false, findFirstsOf(id));
         level++;
         break;
     case Ast::Node::ZeroOrMore:
         out << ws(level);
-        writeCond(out, true, findFirstsOf(node));
+        writeCond(out, true, findFirstsOf(id));
         level++;
         break;
     }
@@ -447,21 +461,21 @@ void CppGen::writeNode(QTextStream& out, Ast::Node* node, int level)
                 << (d_genSynTree?"(st);":"();") << endl;
         break;
     case Ast::Node::Alternative:
-        for( int i = 0; i < node->d_subs.size(); i++ )
+        for( int sub = d_flat->getSubBegin(id); sub < d_flat->getSubEnd(id); sub++ )
         {
-            if( i != 0 )
+            if( sub != d_flat->getSubBegin(id) )
                 out << ws(level) << "} else ";
             else
                 out << ws(level);
-            writeCond(out, false, findFirstsOf(node->d_subs[i], true));
-            writeNode( out, node->d_subs[i], level+1 );
+            writeCond(out, false, findFirstsOf(sub, true));
+            writeNode( out, sub, level+1 );
         }
         out << ws(level) << "} else" << endl;
         out << ws(level+1) << "invalid(\"" << node->d_owner->d_tok.d_val.toBa() << "\");" << endl;
         break;
     case Ast::Node::Sequence:
-        for( int i = 0; i < node->d_subs.size(); i++ )
-            writeNode( out, node->d_subs[i], level );
+        for( int sub = d_flat->getSubBegin(id); sub < d_flat->getSubEnd(id); sub++ )
+            writeNode( out, sub, level );
         break;
     case Ast::Node::Predicate:
         // qWarning() << "Coco::writeNode: Ast::Node::Predicate";
@@ -479,10 +493,11 @@ void CppGen::writeNode(QTextStream& out, Ast::Node* node, int level)
     }
 }
 
-void CppGen::writeNode2(QTextStream& out, Ast::Node* node, QSet<EbnfToken::Sym>& unique)
+void CppGen::writeNode2(QTextStream& out, int id, QSet<EbnfToken::Sym>& unique)
 {
-    if( node == 0 )
+    if( id == -1 )
         return;
+    const Ast::Node* node = d_flat->getNode(id);
 
     if( node->d_tok.d_op == EbnfToken::Skip )
         return;
@@ -511,7 +526,7 @@ void CppGen::writeNode2(QTextStream& out, Ast::Node* node, QSet<EbnfToken::Sym>&
         {
             if( node->d_def->d_tok.d_op == EbnfToken::Transparent )
             {
-                writeNode2( out, node->d_def->d_node, unique );
+                writeNode2( out, d_flat->getTarget(id), unique );
                 //for( int i = 0; i < node->d_def->d_node->d_subs.size(); i++ )
                 //    writeNode2( out, node->d_def->d_node->d_subs[i], unique );
             }else
@@ -527,8 +542,8 @@ void CppGen::writeNode2(QTextStream& out, Ast::Node* node, QSet<EbnfToken::Sym>&
         break;
     case Ast::Node::Alternative:
     case Ast::Node::Sequence:
-        for( int i = 0; i < node->d_subs.size(); i++ )
-            writeNode2( out, node->d_subs[i], unique );
+        for( int sub = d_flat->getSubBegin(id); sub < d_flat->getSubEnd(id); sub++ )
+            writeNode2( out, sub, unique );
         break;
     case Ast::Node::Predicate:
         // qWarning() << "Coco::writeNode: Ast::Node::Predicate";
@@ -682,7 +697,8 @@ void CppGen::handlePredicateExact(QTextStream& out, const Ast::Node* pred)
     if( ll <= 0 )
         return;
 
-    LlkSequenceSet seqs = EbnfAnalyzer2::computeFirstKForNode(ll, pred->d_parent, d_syn);
+    Q_ASSERT( d_llk != 0 );
+    LlkSequenceSet seqs = d_llk->getFirstK(ll, pred->d_parent);
     seqs.remove(LlkSequence()); // remove epsilon, only "take" paths
     if( seqs.isEmpty() )
         return;
@@ -697,19 +713,20 @@ void CppGen::handlePredicateExact(QTextStream& out, const Ast::Node* pred)
             const LlkSequence& b = sorted[j];
             const int len = qMin(a.size(), b.size());
             bool swap = false;
-            for( int p = 0; p < len; p++ )
+            bool decided = false;
+            for( int p = 0; p < len && !decided; p++ )
             {
-                const QString na = a[p].d_node->d_tok.d_val.toStr();
-                const QString nb = b[p].d_node->d_tok.d_val.toStr();
-                if( na < nb )
-                    break;
-                if( na > nb )
+                const QString na = d_syn->getTerminal(a[p])->d_tok.d_val.toStr();
+                const QString nb = d_syn->getTerminal(b[p])->d_tok.d_val.toStr();
+                if( na != nb )
                 {
-                    swap = true;
-                    break;
+                    swap = na > nb;
+                    decided = true;
                 }
             }
-            if( !swap && a.size() > b.size() )
+            // only a common prefix puts the shorter sequence first; otherwise the result
+            // depended on the iteration order of the set
+            if( !decided && a.size() > b.size() )
                 swap = true;
             if( swap )
                 sorted.swap(i, j);
@@ -730,7 +747,7 @@ void CppGen::handlePredicateExact(QTextStream& out, const Ast::Node* pred)
         {
             if( i != 0 )
                 out << "&& ";
-            const Ast::Node* n = seq[i].d_node;
+            const Ast::Node* n = d_syn->getTerminal(seq[i]);
             const QString tokName = "Tok_" + GenUtils::symToString(n->d_tok.d_val.toStr());
             if( d_pseudoKeywords && n->d_literal && GenUtils::looksLikeKeyword(n->d_tok.d_val.toStr()) )
                 out << "peek(" << i+1 << ").d_code == " << tokName << " ";
@@ -743,19 +760,27 @@ void CppGen::handlePredicateExact(QTextStream& out, const Ast::Node* pred)
     out << ") ";
 }
 
-QList<const Ast::Node*> CppGen::findFirstsOf(Ast::Node* node, bool checkFollowSet) const
+static bool sourceOrder( const Ast::Node* lhs, const Ast::Node* rhs )
+{
+    if( lhs->d_tok.d_lineNr != rhs->d_tok.d_lineNr )
+        return lhs->d_tok.d_lineNr < rhs->d_tok.d_lineNr;
+    return lhs->d_tok.d_colNr < rhs->d_tok.d_colNr;
+}
+
+QList<const Ast::Node*> CppGen::findFirstsOf(int id, bool checkFollowSet) const
 {
     QList<const Ast::Node*> res;
     // TODO why not just d_tbl->getFirstNodeSet(node).toList() ?
-    if( node->d_type == Ast::Node::Terminal || node->d_type == Ast::Node::Nonterminal )
+    const quint8 type = d_flat->getType(id);
+    if( type == Ast::Node::Terminal || type == Ast::Node::Nonterminal )
     {
-        res.append(node);
+        res.append(d_flat->getNode(id));
     }else
     {
-        Q_ASSERT( node->d_type == Ast::Node::Alternative || node->d_type == Ast::Node::Sequence );
-        for( int i = 0; i < node->d_subs.size(); i++ )
+        Q_ASSERT( type == Ast::Node::Alternative || type == Ast::Node::Sequence );
+        for( int i = d_flat->getSubBegin(id); i < d_flat->getSubEnd(id); i++ )
         {
-            Ast::Node* sub = node->d_subs[i];
+            const Ast::Node* sub = d_flat->getNode(i);
 
             if( sub->d_tok.d_op == EbnfToken::Skip )
                 continue;
@@ -765,7 +790,7 @@ QList<const Ast::Node*> CppGen::findFirstsOf(Ast::Node* node, bool checkFollowSe
             switch( sub->d_type )
             {
             case Ast::Node::Predicate:
-                Q_ASSERT( node->d_type == Ast::Node::Sequence && res.isEmpty() );
+                Q_ASSERT( type == Ast::Node::Sequence && res.isEmpty() );
                 res.append(sub);
                 return res;
             case Ast::Node::Terminal:
@@ -774,19 +799,22 @@ QList<const Ast::Node*> CppGen::findFirstsOf(Ast::Node* node, bool checkFollowSe
                 break;
             case Ast::Node::Alternative:
             case Ast::Node::Sequence:
-                res += findFirstsOf(sub);
+                res += findFirstsOf(i);
                 break;
             }
 
-            if( node->d_type == Ast::Node::Sequence && !sub->isNullable() )
+            if( type == Ast::Node::Sequence && !d_flat->isNullable(i) )
                 break; // stop after the first non-optional
         }
     }
-    if( checkFollowSet && node->isNullable() )
+    if( checkFollowSet && d_flat->isNullable(id) )
     {
         // if an option in an alternative is nullable then the the stuff behind the alternative must
         // be visible otherwise no option of the alternative might fit.
-        res += d_tbl->getFollowNodeSet(node).toList();
+        // in source order, otherwise the condition depends on the insertion history of the set
+        QList<const Ast::Node*> follow = d_tbl->getFollowNodeSet(id).toList();
+        std::stable_sort( follow.begin(), follow.end(), sourceOrder );
+        res += follow;
     }
     return res;
 }
@@ -25,6 +25,7 @@
 
 class QTextStream;
 class FirstFollowSet;
+class FirstKCache;
 
 class CppGen
 {
@@ -33,16 +34,20 @@ public:
     bool generate(const QString& ebnfPath, EbnfSyntax*, FirstFollowSet*);
     bool writeVisitor(const QString& path, EbnfSyntax*, FirstFollowSet*);
     bool d_exact;
+    FirstKCache* d_firstK; // optional, reuses the First_k tables of a preceding exact analysis
 protected:
-    void writeNode(QTextStream& out, Ast::Node* node, int level);
-    void writeNode2(QTextStream& out, Ast::Node* node, QSet<EbnfToken::Sym>& unique);
+    // nodes by id of EbnfSyntax::getFlat
+    void writeNode(QTextStream& out, int node, int level);
+    void writeNode2(QTextStream& out, int node, QSet<EbnfToken::Sym>& unique);
     void handlePredicate(QTextStream& out, const Ast::Node* pred);
     void handlePredicateExact(QTextStream& out, const Ast::Node* pred);
-    QList<const Ast::Node*> findFirstsOf(Ast::Node*, bool checkFollowSet = false) const;
+    QList<const Ast::Node*> findFirstsOf(int node, bool checkFollowSet = false) const;
     void writeCond( QTextStream& out, bool loop, const QList<const Ast::Node*>& firsts );
 private:
     FirstFollowSet* d_tbl;
+    FirstKCache* d_llk; // valid during generate()
     EbnfSyntax* d_syn;
+    const FlatSyntax* d_flat;
     bool d_pseudoKeywords;
     bool d_genSynTree;
 };
@@ -20,6 +20,7 @@
 #include "EbnfAnalyzer.h"
 #include "EbnfErrors.h"
 #include "FirstFollowSet.h"
+#include "Tracer.h"
 #include <QtDebug>
 
 // https://stackoverflow.com/questions/19529560/left-recursive-grammar-identification
@@ -91,28 +92,21 @@ static QByteArray ws( int level )
 
 struct _SubNodeBin
 {
-    const Ast::Node* d_node;
+    int d_node;
     quint16 d_from, d_to;
-    _SubNodeBin( const Ast::Node* n, int from, int to ):d_node(n),d_from(from),d_to(to){}
+    _SubNodeBin( int n, int from, int to ):d_node(n),d_from(from),d_to(to){}
 };
 
-quint16 EbnfAnalyzer::calcLlkFirstSetImp(quint16 k, quint16 curBin, LlkNodes& res, const Ast::Node* node, FirstFollowSet* tbl, int level)
+quint16 EbnfAnalyzer::calcLlkFirstSetImp(quint16 k, quint16 curBin, LlkNodes& res, int node, const FlatSyntax& f, int level)
 {
     // Gehe entlang der Blätter des Baums und sammle alle Terminals ein gruppiert in Distanzboxen.
     // Wird eigentlich nur mit node=Sequence aufgerufen, da ja Predicates nur dort vorkommen
 
     // returns maximum number of symbols covered by this node
 
-    if( node == 0 || node->doIgnore() )
+    if( node == -1 || f.doIgnore(node) )
         return 0;
 
-//#ifdef _DEBUG
-#if 0
-    qDebug() << ws(level).constData() << "visit bin" << curBin << "l/c" <<
-                node->d_tok.d_lineNr << node->d_tok.d_colNr << node->toString()
-             << "level" << level << "k" << k << "reslen" << res.size(); // TEST
-#endif
-
     if( level > k * 10 )
     {
 #ifdef _DEBUG
@@ -121,57 +115,36 @@ quint16 EbnfAnalyzer::calcLlkFirstSetImp(quint16 k, quint16 curBin, LlkNodes& re
         return 0;
     }
 
-    switch( node->d_type )
+    switch( f.getType(node) )
     {
     case Ast::Node::Terminal:
         resize( res, curBin );
-        res[curBin].insert( node ); // hier ist dieser node gemeint, nicht Follow(node)!
-//#ifdef _DEBUG
-#if 0
-        qDebug() << ws(level).constData() << "insert" << curBin <<
-                    node->d_tok.d_val.toBa() << node->d_tok.d_lineNr << node->d_tok.d_colNr; // TEST
-#endif
+        res[curBin].insert( f.getNode(node) ); // hier ist dieser node gemeint, nicht Follow(node)!
         return 1;
 
     case Ast::Node::Nonterminal:
-        if( node->d_def && node->d_def->d_node )
-            return calcLlkFirstSetImp( k, curBin, res, node->d_def->d_node, tbl,level+1 );
+        if( f.getTarget(node) != -1 )
+            return calcLlkFirstSetImp( k, curBin, res, f.getTarget(node), f, level+1 );
         else
         {
             // wie Terinal
             resize( res, curBin );
-            res[curBin].insert( node );
-//#ifdef _DEBUG
-#if 0
-            qDebug() << ws(level).constData() << "insert" << curBin <<
-                        node->d_tok.d_val.toBa() << node->d_tok.d_lineNr << node->d_tok.d_colNr; // TEST
-#endif
+            res[curBin].insert( f.getNode(node) );
             return 1;
         }
 
     case Ast::Node::Sequence:
-#if 0
-        foreach( Ast::Node* sub, node->d_subs )
-        {
-            if( sub->doIgnore() )
-                continue;
-            calcLlkFirstSet( k, curBin++, res, sub, tbl,level+1 );
-            if( res.size() >= k )
-                break;
-        }
-        // TODO: repetitions and options
-#else
         {
             QList<_SubNodeBin> toVisit;
             int i = curBin;
             int nullable = 0;
-            foreach( Ast::Node* sub, node->d_subs )
+            for( int sub = f.getSubBegin(node); sub < f.getSubEnd(node); sub++ )
             {
-                if( !sub->doIgnore() )
+                if( !f.doIgnore(sub) )
                 {
                     toVisit << _SubNodeBin(sub,i-nullable,i);
                     i++;
-                    if( sub->isNullable() )
+                    if( f.isNullable(sub) )
                         nullable++;
                 }
             }
@@ -180,7 +153,7 @@ quint16 EbnfAnalyzer::calcLlkFirstSetImp(quint16 k, quint16 curBin, LlkNodes& re
             {
                 for( int bin = toVisit[i].d_from; bin <= toVisit[i].d_to && bin < k; bin++ )
                 {
-                    const quint16 tmp = calcLlkFirstSetImp( k, bin, res, toVisit[i].d_node, tbl, level+1 );
+                    const quint16 tmp = calcLlkFirstSetImp( k, bin, res, toVisit[i].d_node, f, level+1 );
                     if( tmp > 1 )
                     {
                         for( int j = i+1; j < toVisit.size(); j++ )
@@ -193,16 +166,15 @@ quint16 EbnfAnalyzer::calcLlkFirstSetImp(quint16 k, quint16 curBin, LlkNodes& re
             return max - curBin + 1;
         }
         // TODO: repetition
-#endif
         break;
     case Ast::Node::Alternative:
         {
             quint16 count = 0;
-            foreach( Ast::Node* sub, node->d_subs )
+            for( int sub = f.getSubBegin(node); sub < f.getSubEnd(node); sub++ )
             {
-                if( sub->doIgnore() )
+                if( f.doIgnore(sub) )
                     continue;
-                const quint16 tmp = calcLlkFirstSetImp( k, curBin, res, sub, tbl,level+1 );
+                const quint16 tmp = calcLlkFirstSetImp( k, curBin, res, sub, f, level+1 );
                 if( tmp > count )
                     count = tmp;
             }
@@ -216,116 +188,54 @@ quint16 EbnfAnalyzer::calcLlkFirstSetImp(quint16 k, quint16 curBin, LlkNodes& re
 }
 
 void EbnfAnalyzer::calcLlkFirstSet2Imp(quint16 k, int curBin, int level, LlkNodes& res,
-                                    const Ast::Node* node, FirstFollowSet* tbl, CheckSet& visited)
+                                    int node, const FlatSyntax& f, CheckSet& visited)
 {
-    if( node == 0 || node->doIgnore() )
+    if( node == -1 || f.doIgnore(node) )
         return;
     if( visited.contains(node) )
         return;
     else
         visited.insert(node);
 
-//#ifdef _DEBUG
-#if 0
-    qDebug() << ws(level).constData() << "visit bin" << curBin << "l/c" <<
-                node->d_tok.d_lineNr << node->d_tok.d_colNr << node->toString()
-             << "level" << level << "k" << k << "res len" << res.size(); // TEST
-#endif
-
     // TODO: ev. separate Funktion um von einem Node zum nächsten zu wandern und im Falle von usedBy und Alternative
     // mehrere parallele Nodes zurückzugeben. Offen ist die Ermittlung des curBin.
 
     if( level >= 0 )
     {
         // CheckSet visited; // don't check visited downwards
-        switch( node->d_type )
+        switch( f.getType(node) )
         {
         case Ast::Node::Terminal:
             resize( res, curBin );
-            res[curBin].insert( node ); // hier ist dieser node gemeint, nicht Follow(node)!
-//#ifdef _DEBUG
-#if 0
-            qDebug() << ws(level).constData() << "insert" << curBin <<
-                        node->d_tok.d_val.data() << node->d_tok.d_lineNr << node->d_tok.d_colNr; // TEST
-#endif
+            res[curBin].insert( f.getNode(node) ); // hier ist dieser node gemeint, nicht Follow(node)!
             break;
         case Ast::Node::Nonterminal:
-            if( node->d_def && node->d_def->d_node )
-                calcLlkFirstSet2Imp( k, curBin, level + 1, res, node->d_def->d_node, tbl, visited );
+            if( f.getTarget(node) != -1 )
+                calcLlkFirstSet2Imp( k, curBin, level + 1, res, f.getTarget(node), f, visited );
             else
             {
                 // wie Terinal
                 resize( res, curBin );
-                res[curBin].insert( node );
-//#ifdef _DEBUG
-#if 0
-                qDebug() << ws(level).constData() << "insert" << curBin <<
-                            node->d_tok.d_val.data() << node->d_tok.d_lineNr << node->d_tok.d_colNr; // TEST
-#endif
+                res[curBin].insert( f.getNode(node) );
             }
             break;
         case Ast::Node::Sequence:
-#if 1
-            foreach( Ast::Node* sub, node->d_subs )
+            for( int sub = f.getSubBegin(node); sub < f.getSubEnd(node); sub++ )
             {
-                if( sub->doIgnore() )
+                if( f.doIgnore(sub) )
                     continue;
-                calcLlkFirstSet2Imp( k, curBin++, level + 1, res, sub, tbl, visited );
+                calcLlkFirstSet2Imp( k, curBin++, level + 1, res, sub, f, visited );
                 if( res.size() >= k )
                     break;
             }
             // TODO: repetition, option
-#else
-#if 1       // TODO the following does not work yet
-            {
-                QList<const Ast::Node*> toVisit;
-                foreach( Ast::Node* sub, node->d_subs )
-                {
-                    if( !sub->doIgnore() )
-                        toVisit << sub;
-                }
-                for( int i = curBin; i < k && i < toVisit.size(); i++ )
-                {
-                    for( int j = i; j < toVisit.size(); j++ )
-                    {
-                        visited.clear();
-                        calcLlkFirstSet2Imp( k, i, level + 1, res, toVisit[j], tbl, visited ); // TODO: visited too strong
-                        if( !toVisit[j]->isNullable() )
-                            break;
-                    }
-                    if( res.size() >= k )
-                        break;
-                }
-            }
-            // TODO: repetition
-#else
-            for( int i = curBin; i < k; i++ )
-            {
-                QSet<const Ast::Node*> check = visited;
-                int j = 0;
-                foreach( Ast::Node* sub, node->d_subs )
-                {
-                    if( sub->doIgnore() )
-                        continue;
-                    if( j++ < i )
-                        continue;
-                    calcLlkFirstSet2Imp( k, i, level + 1, res, sub, tbl, check );
-                    if( !sub->isNullable() )
-                        break;
-                }
-                //if( res.size() >= k )
-                //    break;
-            }
-            // TODO: repetition
-#endif
-#endif
             break;
         case Ast::Node::Alternative:
-            foreach( Ast::Node* sub, node->d_subs )
+            for( int sub = f.getSubBegin(node); sub < f.getSubEnd(node); sub++ )
             {
-                if( sub->doIgnore() )
+                if( f.doIgnore(sub) )
                     continue;
-                calcLlkFirstSet2Imp( k, curBin, level + 1, res, sub, tbl, visited );
+                calcLlkFirstSet2Imp( k, curBin, level + 1, res, sub, f, visited );
             }
             // TODO: repetition
             break;
@@ -338,23 +248,26 @@ void EbnfAnalyzer::calcLlkFirstSet2Imp(quint16 k, int curBin, int level, LlkNode
     {
         // Vorsicht, es kann sein dass wir beim Weg nach oben wieder dort vorbeikommen, wo man angefangen haben
         curBin = res.size() - 1;
-        if( const Ast::Node* next = node->getNext(&curBin) )
+        const int next = f.getNext(node, &curBin);
+        if( next != -1 )
         {
             // finde nächsten nach node
-            calcLlkFirstSet2Imp(k,curBin,0,res,next,tbl, visited);
+            calcLlkFirstSet2Imp(k,curBin,0,res,next,f, visited);
             if( res.size() >= k )
                 return;
         }else
         {
             // gehe entlang node->d_owner->d_usedBy
-            foreach( const Ast::Node* use, node->d_owner->d_usedBy )
+            const int owner = f.getOwner(node);
+            for( int i = f.getUserBegin(owner); i < f.getUserEnd(owner); i++ )
             {
+                const int use = f.getUser(i);
                 int index = curBin;
-                const Ast::Node* next = use->getNext(&index);
-                if( next )
-                    calcLlkFirstSet2Imp( k, index, 0, res, next, tbl, visited );
+                const int next = f.getNext(use, &index);
+                if( next != -1 )
+                    calcLlkFirstSet2Imp( k, index, 0, res, next, f, visited );
                 else // obsolet wegen visited: if( level > -10 ) // begrenze die Tiefe, da es hier ab und zu unendlich weitergeht TODO
-                    calcLlkFirstSet2Imp( k,index,level - 1 , res, use, tbl, visited );
+                    calcLlkFirstSet2Imp( k,index,level - 1 , res, use, f, visited );
             }
         }
     }
@@ -469,43 +382,44 @@ Ast::NodeRefSet EbnfAnalyzer::intersectAll(const EbnfAnalyzer::LlkNodes& lhs, co
 
 void EbnfAnalyzer::calcLlkFirstSet(quint16 k, EbnfAnalyzer::LlkNodes& res, const Ast::Node* node, FirstFollowSet* tbl)
 {
-    calcLlkFirstSetImp( k, 0, res, node, tbl, 0 );
+    if( tbl->getFlat() )
+        calcLlkFirstSetImp( k, 0, res, tbl->getFlat()->indexOf(node), *tbl->getFlat(), 0 );
 }
 
 void EbnfAnalyzer::calcLlkFirstTree(quint16 k, Ast::NodeTree* nt, const Ast::Node* node, FirstFollowSet* tbl)
+{
+    if( tbl->getFlat() )
+        calcLlkFirstTreeImp( k, nt, tbl->getFlat()->indexOf(node), *tbl->getFlat() );
+}
+
+void EbnfAnalyzer::calcLlkFirstTreeImp(quint16 k, Ast::NodeTree* nt, int node, const FlatSyntax& f)
 {
     // TODO: this is unfinished work; the goal is to have a reliable LL(k) algorithm which works better than
     // the current \LL:k\, which is only a primitive approximation
 
-    if( nt == 0 || node == 0 || node->doIgnore() || nt->d_k >= k )
+    if( nt == 0 || node == -1 || f.doIgnore(node) || nt->d_k >= k )
         return;
 
-    switch( node->d_type )
+    switch( f.getType(node) )
     {
     case Ast::Node::Terminal:
-        nt->addLeaf(node);
+        nt->addLeaf(f.getNode(node));
         return;
 
     case Ast::Node::Nonterminal:
-        if( node->d_def && node->d_def->d_node )
+        if( f.getTarget(node) != -1 )
         {
-            calcLlkFirstTree(k, nt, node->d_def->d_node, tbl );
+            calcLlkFirstTreeImp(k, nt, f.getTarget(node), f );
         }else
             // wie Terinal
-            nt->addLeaf(node);
+            nt->addLeaf(f.getNode(node));
         return;
 
     case Ast::Node::Sequence:
-        for( int i = 0; i < node->d_subs.size(); i++ )
-        {
-            calcLlkFirstTree(k, nt, node->d_subs[i], tbl);
-        }
-        return;
-
     case Ast::Node::Alternative:
-        for( int i = 0; i < node->d_subs.size(); i++ )
+        for( int sub = f.getSubBegin(node); sub < f.getSubEnd(node); sub++ )
         {
-            calcLlkFirstTree(k, nt, node->d_subs[i], tbl);
+            calcLlkFirstTreeImp(k, nt, sub, f);
         }
         return;
 
@@ -516,22 +430,27 @@ void EbnfAnalyzer::calcLlkFirstTree(quint16 k, Ast::NodeTree* nt, const Ast::Nod
 
 void EbnfAnalyzer::calcLlkFirstSet2(quint16 k, EbnfAnalyzer::LlkNodes& res, const Ast::Node* node, FirstFollowSet* tbl)
 {
-    QSet<const Ast::Node*> visited;
-    calcLlkFirstSet2Imp( k, 0, 0,res, node, tbl, visited );
+    if( tbl->getFlat() == 0 )
+        return;
+    CheckSet visited;
+    calcLlkFirstSet2Imp( k, 0, 0,res, tbl->getFlat()->indexOf(node), *tbl->getFlat(), visited );
 }
 
 void EbnfAnalyzer::checkForAmbiguity(FirstFollowSet* set, EbnfErrors* err)
 {
-    EbnfSyntax* syn = set->getSyntax();
-    for( int i = 0; i < syn->getOrderedDefs().size(); i++ )
+    TraceSpan span("checkForAmbiguity");
+    const FlatSyntax* f = set->getFlat();
+    if( f == 0 )
+        return;
+    for( int i = 0; i < f->getDefCount(); i++ )
     {
-        const Ast::Definition* d = syn->getOrderedDefs()[i];
-        if( d->doIgnore() || ( i != 0 && d->d_usedBy.isEmpty() ) || d->d_node == 0 )
+        const Ast::Definition* d = f->getDef(i);
+        if( d->doIgnore() || ( i != 0 && f->getUserBegin(i) == f->getUserEnd(i) ) || f->getBody(i) == -1 )
             continue;
 
         try
         {
-            checkForAmbiguity( d->d_node, set, err );
+            checkForAmbiguityImp( f->getBody(i), set, err, true );
         }catch(...)
         {
             qCritical() << "EbnfAnalyzer::checkForAmbiguity exception";
@@ -541,7 +460,14 @@ void EbnfAnalyzer::checkForAmbiguity(FirstFollowSet* set, EbnfErrors* err)
 
 void EbnfAnalyzer::checkForAmbiguity(Ast::Node* node, FirstFollowSet* set, EbnfErrors* errs , bool recursive)
 {
-    if( node == 0 || node->doIgnore() )
+    if( set->getFlat() )
+        checkForAmbiguityImp( set->getFlat()->indexOf(node), set, errs, recursive );
+}
+
+void EbnfAnalyzer::checkForAmbiguityImp(int node, FirstFollowSet* set, EbnfErrors* errs , bool recursive)
+{
+    const FlatSyntax& f = *set->getFlat();
+    if( node == -1 || f.doIgnore(node) )
         return;
 
     findAmbiguousAlternatives(node,set,errs);
@@ -550,13 +476,13 @@ void EbnfAnalyzer::checkForAmbiguity(Ast::Node* node, FirstFollowSet* set, EbnfE
     if( !recursive )
         return;
 
-    switch( node->d_type )
+    switch( f.getType(node) )
     {
     case Ast::Node::Sequence:
     case Ast::Node::Alternative:
-        foreach( Ast::Node* sub, node->d_subs )
+        for( int sub = f.getSubBegin(node); sub < f.getSubEnd(node); sub++ )
         {
-            checkForAmbiguity( sub, set, errs, recursive );
+            checkForAmbiguityImp( sub, set, errs, recursive );
         }
         break;
     default:
@@ -575,27 +501,29 @@ Ast::ConstNodeList EbnfAnalyzer::findPath(const Ast::Node* from, const Ast::Node
     return res;
 }
 
-void EbnfAnalyzer::findAmbiguousAlternatives(Ast::Node* node, FirstFollowSet* set, EbnfErrors* errs)
+void EbnfAnalyzer::findAmbiguousAlternatives(int node, FirstFollowSet* set, EbnfErrors* errs)
 {
-    if( node->d_type != Ast::Node::Alternative )
+    const FlatSyntax& f = *set->getFlat();
+    if( f.getType(node) != Ast::Node::Alternative )
         return;
 
     // Check each pair of alternatives
-    for(int i = 0; i < node->d_subs.size(); i++)
+    const int begin = f.getSubBegin(node);
+    for(int a = begin; a < f.getSubEnd(node); a++)
     {
-        for(int j = i + 1; j < node->d_subs.size(); j++)
+        for(int b = a + 1; b < f.getSubEnd(node); b++)
         {
-            const Ast::Node* a = node->d_subs[i];
-            const Ast::Node* b = node->d_subs[j];
-            if( a->doIgnore() || b->doIgnore() )
+            if( f.doIgnore(a) || f.doIgnore(b) )
                 continue;
             // TODO: wenn eine Alternative Nullable ist, müsste auch noch ihre Follow mitberücksichtigt werden!
-            const Ast::NodeRefSet diff = set->getFirstSet(a) & set->getFirstSet(b);
-            if( diff.isEmpty() )
+            const TermSet firstA = set->getFirstBits(a);
+            const TermSet firstB = set->getFirstBits(b);
+            if( !firstA.intersects(firstB) )
                 continue;
+            const Ast::NodeRefSet diff = set->toRefSet( firstA & firstB );
 
-            const Ast::Node* predA = EbnfSyntax::firstPredicateOf(a);
-            const Ast::Node* predB = EbnfSyntax::firstPredicateOf(b);
+            const Ast::Node* predA = EbnfSyntax::firstPredicateOf(f.getNode(a));
+            const Ast::Node* predB = EbnfSyntax::firstPredicateOf(f.getNode(b));
             int ll = 0;
             if( predA != 0 )
                 ll = predA->getLlk();
@@ -610,19 +538,21 @@ void EbnfAnalyzer::findAmbiguousAlternatives(Ast::Node* node, FirstFollowSet* se
             if( ll > 0 )
             {
                 EbnfAnalyzer::LlkNodes llkA;
-                calcLlkFirstSet2( ll,  llkA, a, set );
+                CheckSet visitedA;
+                calcLlkFirstSet2Imp( ll, 0, 0, llkA, a, f, visitedA );
                 EbnfAnalyzer::LlkNodes llkB;
-                calcLlkFirstSet2( ll, llkB, b, set );
+                CheckSet visitedB;
+                calcLlkFirstSet2Imp( ll, 0, 0, llkB, b, f, visitedB );
 
                 const Ast::NodeRefSet diff = intersectAll( llkA, llkB );
                 if( llkA.size() == llkB.size() && llkA.size() == ll && diff.isEmpty() )
                     continue;
 
                 const Ast::Node* pred = predA != 0 ? predA : predB;
-                const Ast::Node* other = predA != 0 ? b : a;
+                const Ast::Node* other = predA != 0 ? f.getNode(b) : f.getNode(a);
                 if( pred )
                     errs->warning(EbnfErrors::Analysis, pred->d_tok.d_lineNr, pred->d_tok.d_colNr,
-                            QString("predicate not effective for LL(%1)").arg(ll),
+                            EbnfErrors::Msg("predicate not effective for LL(%1)").arg(ll),
                                   QVariant::fromValue(EbnfSyntax::IssueData(EbnfSyntax::IssueData::BadPred,
                                                                             pred,other)));
 
@@ -630,60 +560,61 @@ void EbnfAnalyzer::findAmbiguousAlternatives(Ast::Node* node, FirstFollowSet* se
 
             if( !diff.isEmpty() )
             {
-                const Ast::Node* aa = EbnfSyntax::firstVisibleElementOf(a);
+                const Ast::Node* aa = EbnfSyntax::firstVisibleElementOf(f.getNode(a));
                 Ast::NodeSet diff2 = EbnfSyntax::collectNodes( diff, set->getFirstNodeSet(a) );
                 diff2 += EbnfSyntax::collectNodes( diff, set->getFirstNodeSet(b) );
                 errs->error(EbnfErrors::Analysis, aa->d_tok.d_lineNr, aa->d_tok.d_colNr,
-                            QString("alternatives %1 and %2 are LL(1) ambiguous because of %3")
-                            .arg(i+1).arg(j+1).arg(EbnfSyntax::pretty(diff)),
+                            EbnfErrors::Msg("alternatives %1 and %2 are LL(1) ambiguous because of %3")
+                            .arg(a-begin+1).arg(b-begin+1).arg(EbnfSyntax::pretty(diff)),
                             QVariant::fromValue(EbnfSyntax::IssueData(
-                                                    EbnfSyntax::IssueData::AmbigAlt,a,b,diff2.toList())));
+                                                    EbnfSyntax::IssueData::AmbigAlt,f.getNode(a),f.getNode(b),
+                                                    diff2.toList())));
             }
         }
     }
 }
 
-void EbnfAnalyzer::findAmbiguousOptionals(Ast::Node* seq, FirstFollowSet* set, EbnfErrors* errs)
+void EbnfAnalyzer::findAmbiguousOptionals(int seq, FirstFollowSet* set, EbnfErrors* errs)
 {
     // ZeroOrOne and ZeroOrMore haben genau dieselben Mehrdeutigkeitskriterien. Es ist egal, ob
     // a nur ein oder mehrmals wiederholt wird; in jedem Fall ist die Schnittmenge zwischen First(a) und Follow(a)
     // massgebend!
 
-    if( seq->d_type != Ast::Node::Sequence )
+    const FlatSyntax& f = *set->getFlat();
+    if( f.getType(seq) != Ast::Node::Sequence )
         return;
 
-    Ast::NodeRefSet upperFollow = set->getFollowSet(seq);
-    for(int i = 0; i < seq->d_subs.size(); i++)
+    const TermSet upperFollow = set->getFollowBits(seq);
+    for(int a = f.getSubBegin(seq); a < f.getSubEnd(seq); a++)
     {
-        const Ast::Node* a = seq->d_subs[i];
-        if( a->doIgnore() || !a->isNullable() )
+        if( f.doIgnore(a) || !f.isNullable(a) )
             continue;
-        Ast::NodeRefSet follow; // = set->getFollowSet(1,a);
+        TermSet follow; // = set->getFollowSet(1,a);
         bool nonNullableFound = false;
-        const Ast::Node* b = 0;
-        for( int j = i + 1; j < seq->d_subs.size(); j++ )
+        int b = -1;
+        for( int n = a + 1; n < f.getSubEnd(seq); n++ )
         {
-            const Ast::Node* n = seq->d_subs[j];
-            if( n->doIgnore() )
+            if( f.doIgnore(n) )
                 continue;
-            if( b == 0 )
+            if( b == -1 )
                 b = n;
-            follow += set->getFirstSet(n);
-            if( !n->isNullable() )
+            follow |= set->getFirstBits(n);
+            if( !f.isNullable(n) )
             {
                 nonNullableFound = true;
                 break;
             }
         }
         if( !nonNullableFound )
-            follow += upperFollow;
+            follow |= upperFollow;
 
-        const Ast::NodeRefSet diff = set->getFirstSet(a) & follow;
-        if( diff.isEmpty() )
+        const TermSet firstA = set->getFirstBits(a);
+        if( !firstA.intersects(follow) )
             continue;
+        const Ast::NodeRefSet diff = set->toRefSet( firstA & follow );
 
         // else
-        const Ast::Node* pred = EbnfSyntax::firstPredicateOf(a);
+        const Ast::Node* pred = EbnfSyntax::firstPredicateOf(f.getNode(a));
         int ll = 0;
         if( pred != 0 )
         {
@@ -695,53 +626,53 @@ void EbnfAnalyzer::findAmbiguousOptionals(Ast::Node* seq, FirstFollowSet* set, E
             if( ll > 0 )
             {
                 EbnfAnalyzer::LlkNodes llkA;
-                calcLlkFirstSet2( ll,  llkA, a, set );
+                CheckSet visitedA;
+                calcLlkFirstSet2Imp( ll, 0, 0, llkA, a, f, visitedA );
 
                 EbnfAnalyzer::LlkNodes llkB;
-                if( b == 0 )
-                {
-                    QSet<const Ast::Node*> visited;
-                    calcLlkFirstSet2Imp(ll,0,-1,llkB, seq, set, visited );
-                }else
-                    calcLlkFirstSet2( ll, llkB, b, set );
+                CheckSet visitedB;
+                if( b == -1 )
+                    calcLlkFirstSet2Imp(ll,0,-1,llkB, seq, f, visitedB );
+                else
+                    calcLlkFirstSet2Imp( ll, 0, 0, llkB, b, f, visitedB );
 
                 const Ast::NodeRefSet diff = intersectAll( llkA, llkB );
                 if( llkA.size() == llkB.size() && llkA.size() == ll && diff.isEmpty() )
                     continue;
                 errs->warning(EbnfErrors::Analysis, pred->d_tok.d_lineNr, pred->d_tok.d_colNr,
-                            QString("predicate not effective for LL(%1)").arg(ll),
+                            EbnfErrors::Msg("predicate not effective for LL(%1)").arg(ll),
                               QVariant::fromValue(EbnfSyntax::IssueData(
-                                EbnfSyntax::IssueData::BadPred,pred, b ? b : seq)) );
+                                EbnfSyntax::IssueData::BadPred,pred, f.getNode( b != -1 ? b : seq ))) );
             }
         }
         Ast::NodeSet diff2 = EbnfSyntax::collectNodes( diff, set->getFirstNodeSet(a) );
-        if( b != 0 )
+        if( b != -1 )
             diff2 += EbnfSyntax::collectNodes( diff, set->getFirstNodeSet(b) );
-//        if( diff.size() != diff2.size() )
-//            qDebug() << "findAmbigOptions different diff size";
-        reportAmbig( seq, i, diff, diff2, set, errs );
+        reportAmbig( seq, a, diff, diff2, set, errs );
     }
 }
 
-void EbnfAnalyzer::reportAmbig(Ast::Node* sequence, int ambigIdx, const Ast::NodeRefSet& ambigSet,
+void EbnfAnalyzer::reportAmbig(int sequence, int a, const Ast::NodeRefSet& ambigSet,
                                const Ast::NodeSet& ambigSet2, FirstFollowSet* set, EbnfErrors* errs)
 {
-    Ast::Node* a = sequence->d_subs[ambigIdx];
-    const Ast::Node* start = EbnfSyntax::firstVisibleElementOf(sequence);
+    const FlatSyntax& f = *set->getFlat();
+    const Ast::Node* aNode = f.getNode(a);
+    const Ast::Node* start = EbnfSyntax::firstVisibleElementOf(f.getNode(sequence));
     QString ofSeq;
-    if( start && start != a )
+    if( start && start != aNode )
         ofSeq = QString("start. w. '%1' ").arg(start->d_tok.d_val.toStr());
 
+    const TermSet ambigBits = FirstFollowSet::toBits(ambigSet);
     const Ast::Node* next = 0;
     bool fullAmbig = false;
-    for( int j = ambigIdx + 1; j < sequence->d_subs.size(); j++ )
+    for( int j = a + 1; j < f.getSubEnd(sequence); j++ )
     {
-        const Ast::NodeRefSet diffDiff = ambigSet & set->getFirstSet(sequence->d_subs[j]);
+        const TermSet diffDiff = ambigBits & set->getFirstBits(j);
         if( !diffDiff.isEmpty() )
         {
-            if( diffDiff == ambigSet )
+            if( diffDiff == ambigBits )
                 fullAmbig = true;
-            next = EbnfSyntax::firstVisibleElementOf(sequence->d_subs[j]);
+            next = EbnfSyntax::firstVisibleElementOf(f.getNode(j));
             break;
         }
     }
@@ -753,12 +684,11 @@ void EbnfAnalyzer::reportAmbig(Ast::Node* sequence, int ambigIdx, const Ast::Nod
             dots = "...";
         ambig = QString("w. '%1'%2 ").arg(next->d_tok.d_val.toStr()).arg(dots);
     }else
-        next = sequence;
+        next = f.getNode(sequence);
 
-    errs->warning(EbnfErrors::Analysis, a->d_tok.d_lineNr, a->d_tok.d_colNr,
-                QString("opt. elem. %1 of seq. %2is LL(1) ambig. %3 because of %4")
-                .arg(ambigIdx+1).arg(ofSeq).arg(ambig).arg(EbnfSyntax::pretty(ambigSet)),
+    errs->warning(EbnfErrors::Analysis, aNode->d_tok.d_lineNr, aNode->d_tok.d_colNr,
+                EbnfErrors::Msg("opt. elem. %1 of seq. %2is LL(1) ambig. %3 because of %4")
+                .arg(f.getIndexInParent(a)+1).arg(ofSeq).arg(ambig).arg(EbnfSyntax::pretty(ambigSet)),
                   QVariant::fromValue(EbnfSyntax::IssueData(
-                                          EbnfSyntax::IssueData::AmbigOpt,a,next,ambigSet2.toList())));
+                                          EbnfSyntax::IssueData::AmbigOpt,aNode,next,ambigSet2.toList())));
 }
-
@@ -47,15 +47,18 @@ public:
 
     static Ast::ConstNodeList findPath( const Ast::Node* from, const Ast::Node* to );
 protected:
+    // the analysis walks EbnfSyntax::getFlat; nodes are given by id
     static QSet<QString> collectAllTerminalStrings( Ast::Node* );
-    static void findAmbiguousAlternatives( Ast::Node*, FirstFollowSet*, EbnfErrors* );
-    static void findAmbiguousOptionals( Ast::Node*, FirstFollowSet*, EbnfErrors* );
-    static void reportAmbig(Ast::Node* seq, int ambigIdx, const Ast::NodeRefSet& diff, const Ast::NodeSet& ambigSet2, FirstFollowSet*, EbnfErrors* );
-    typedef QSet<const Ast::Node*> CheckSet;
-    static void calcLlkFirstSet2Imp(quint16 k, int curBin, int level, LlkNodes&, const Ast::Node* node,
-                                    FirstFollowSet*, CheckSet& visited );
+    static void checkForAmbiguityImp( int node, FirstFollowSet*, EbnfErrors*, bool recursive );
+    static void findAmbiguousAlternatives( int node, FirstFollowSet*, EbnfErrors* );
+    static void findAmbiguousOptionals( int seq, FirstFollowSet*, EbnfErrors* );
+    static void reportAmbig( int seq, int ambig, const Ast::NodeRefSet& diff, const Ast::NodeSet& ambigSet2, FirstFollowSet*, EbnfErrors* );
+    typedef QSet<int> CheckSet;
+    static void calcLlkFirstSet2Imp(quint16 k, int curBin, int level, LlkNodes&, int node,
+                                    const FlatSyntax&, CheckSet& visited );
     static quint16 calcLlkFirstSetImp(quint16 k, quint16 curBin, LlkNodes&,
-                                const Ast::Node* node, FirstFollowSet*, int level );
+                                int node, const FlatSyntax&, int level );
+    static void calcLlkFirstTreeImp(quint16 k, Ast::NodeTree*, int node, const FlatSyntax& );
     static bool findPath( Ast::ConstNodeList& path, const Ast::Node* to );
 };
 
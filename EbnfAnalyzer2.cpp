@@ -28,8 +28,13 @@
 #include "EbnfErrors.h"
 #include "FirstFollowSet.h"
 #include "LaParser.h"
+#include "Tracer.h"
 #include <QtDebug>
 #include <QRegExp>
+#include <QThreadPool>
+#include <QRunnable>
+#include <QAtomicInt>
+#include <algorithm>
 
 EbnfAnalyzer2::EbnfAnalyzer2()
 {
@@ -78,7 +83,8 @@ LlkSequenceSet EbnfAnalyzer2::concatK(const LlkSequenceSet& left, const LlkSeque
     {
         if( l_seq.size() >= k )
         {
-            LlkSequence truncated = l_seq.mid(0, k);
+            LlkSequence truncated = l_seq;
+            truncated.truncate(k);
             result.insert(truncated);
         }else if( l_seq.isEmpty() )
             result += right;
@@ -91,8 +97,7 @@ LlkSequenceSet EbnfAnalyzer2::concatK(const LlkSequenceSet& left, const LlkSeque
                 foreach( const LlkSequence& r_seq, right )
                 {
                     LlkSequence combined = l_seq;
-                    for( int i = 0; i < r_seq.size() && combined.size() < k; ++i )
-                        combined.append(r_seq[i]);
+                    combined.append(r_seq, k);
                     result.insert(combined);
                 }
             }
@@ -101,52 +106,79 @@ LlkSequenceSet EbnfAnalyzer2::concatK(const LlkSequenceSet& left, const LlkSeque
     return result;
 }
 
-LlkSequenceSet EbnfAnalyzer2::evaluateNode(const Ast::Node* node, quint16 k, const FirstKMap& currentMap)
+LlkSequenceSet EbnfAnalyzer2::concatK(const LlkSequenceSet& left, const LlkSequenceSet& right,
+                                      const LlkSequenceSet& rightShorter, quint16 k)
+{
+    // like concatK(left,right,k), but the non-empty prefixes of left are continued by rightShorter,
+    // i.e. First_k-1 of the same node, which is final while First_k is still iterated
+    LlkSequenceSet result;
+    foreach( const LlkSequence& l_seq, left )
+    {
+        if( l_seq.size() >= k )
+        {
+            LlkSequence truncated = l_seq;
+            truncated.truncate(k);
+            result.insert(truncated);
+        }else if( l_seq.isEmpty() )
+            result += right;
+        else if( rightShorter.isEmpty() )
+            result.insert(l_seq);
+        else
+        {
+            foreach( const LlkSequence& r_seq, rightShorter )
+            {
+                LlkSequence combined = l_seq;
+                combined.append(r_seq, k);
+                result.insert(combined);
+            }
+        }
+    }
+    return result;
+}
+
+LlkSequenceSet EbnfAnalyzer2::evaluateNode(int node, quint16 k, const FlatSyntax& f, const FirstKMap& currentMap,
+                                           const FirstKMap* shorter)
 {
     LlkSequenceSet resultSet;
-    if( node->doIgnore() )
+    if( f.doIgnore(node) )
     {
         resultSet.insert(LlkSequence());
         return resultSet;
     }
 
-    switch( node->d_type )
+    switch( f.getType(node) )
     {
     case Ast::Node::Terminal:
-        {
-            LlkSequence seq;
-            seq.append(Ast::NodeRef(node));
-            resultSet.insert(seq);
-        }
+        resultSet.insert(LlkSequence(f.getTermId(node)));
         break;
 
     case Ast::Node::Nonterminal:
-        if( node->d_def && node->d_def->d_node )
+        if( f.getTarget(node) != -1 )
         {
-            resultSet = currentMap.value(node->d_def->d_node);
+            resultSet = currentMap[f.getTarget(node)];
         }else
-        {
-            LlkSequence seq;
-            seq.append(Ast::NodeRef(node));
-            resultSet.insert(seq);
-        }
+            resultSet.insert(LlkSequence(f.getTermId(node)));
         break;
 
     case Ast::Node::Alternative:
-        foreach( Ast::Node* sub, node->d_subs )
+        for( int sub = f.getSubBegin(node); sub < f.getSubEnd(node); sub++ )
         {
-            if( !sub->doIgnore() )
-                resultSet += currentMap.value(sub);
+            if( !f.doIgnore(sub) )
+                resultSet += currentMap[sub];
         }
         break;
 
     case Ast::Node::Sequence:
         {
             resultSet.insert(LlkSequence());
-            foreach( Ast::Node* sub, node->d_subs )
+            for( int sub = f.getSubBegin(node); sub < f.getSubEnd(node); sub++ )
             {
-                if( !sub->doIgnore() )
-                    resultSet = concatK(resultSet, currentMap.value(sub), k);
+                if( f.doIgnore(sub) )
+                    continue;
+                if( shorter )
+                    resultSet = concatK(resultSet, currentMap[sub], (*shorter)[sub], k);
+                else
+                    resultSet = concatK(resultSet, currentMap[sub], k);
             }
         }
         break;
@@ -155,9 +187,9 @@ LlkSequenceSet EbnfAnalyzer2::evaluateNode(const Ast::Node* node, quint16 k, con
         break;
     }
 
-    if( node->d_quant == Ast::Node::ZeroOrOne )
+    if( f.getQuant(node) == Ast::Node::ZeroOrOne )
         resultSet.insert(LlkSequence());
-    else if( node->d_quant == Ast::Node::ZeroOrMore )
+    else if( f.getQuant(node) == Ast::Node::ZeroOrMore )
     {
         LlkSequenceSet closureSet;
         closureSet.insert(LlkSequence());
@@ -174,75 +206,227 @@ LlkSequenceSet EbnfAnalyzer2::evaluateNode(const Ast::Node* node, quint16 k, con
     return resultSet;
 }
 
-void EbnfAnalyzer2::calculateAllFirstK(quint16 k, EbnfSyntax* syn, FirstKMap& outFirstK)
+void EbnfAnalyzer2::collectAllNodes(const FlatSyntax& f, QVector<int>& allNodes)
 {
-    outFirstK.clear();
-    QList<const Ast::Node*> allNodes;
+    for( int def = 0; def < f.getDefCount(); def++ )
+    {
+        if( f.getBody(def) == -1 || f.getDef(def)->doIgnore() )
+            continue;
+        for( int id = f.getBody(def); id < f.getBodyEnd(def); id++ )
+            allNodes.append(id);
+    }
+}
 
-    struct Collector
+void EbnfAnalyzer2::addFirstKDependencies(const QVector<int>& allNodes, const FlatSyntax& f, FixpointSolver& solver)
+{
+    // evaluateNode reads the subs of sequences and alternatives and the body of referenced productions
+    QVector<int> index(f.getNodeCount(), -1);
+    for( int i = 0; i < allNodes.size(); i++ )
+        index[allNodes[i]] = i;
+    for( int i = 0; i < allNodes.size(); i++ )
     {
-        static void collect(const Ast::Node* n, QList<const Ast::Node*>& list)
+        const int node = allNodes[i];
+        if( f.doIgnore(node) )
+            continue;
+        if( f.getType(node) == Ast::Node::Nonterminal )
         {
-            if( !n )
-                return;
-            list.append(n);
-            foreach( Ast::Node* sub, n->d_subs )
-                collect(sub, list);
+            if( f.getTarget(node) != -1 && index[f.getTarget(node)] != -1 )
+                solver.addDependency(i, index[f.getTarget(node)]);
+        }else if( f.getType(node) == Ast::Node::Sequence || f.getType(node) == Ast::Node::Alternative )
+        {
+            for( int sub = f.getSubBegin(node); sub < f.getSubEnd(node); sub++ )
+            {
+                if( !f.doIgnore(sub) )
+                    solver.addDependency(i, index[sub]);
+            }
         }
-    };
+    }
+}
 
-    foreach( const Ast::Definition* def, syn->getOrderedDefs() )
+struct EbnfAnalyzer2::FirstKSetEquations : public FixpointSolver::Equations
+{
+    const QVector<int>& d_nodes;
+    const FlatSyntax& d_flat;
+    FirstKMap& d_map;
+    const FirstKMap* d_shorter;
+    quint16 d_k;
+    FirstKSetEquations(const QVector<int>& nodes, const FlatSyntax& f, FirstKMap& map, const FirstKMap* shorter,
+                       quint16 k):d_nodes(nodes),d_flat(f),d_map(map),d_shorter(shorter),d_k(k){}
+    bool update(int var)
     {
-        if( def->d_node && !def->doIgnore() )
-            Collector::collect(def->d_node, allNodes);
+        const int node = d_nodes[var];
+        LlkSequenceSet newSet = EbnfAnalyzer2::evaluateNode(node, d_k, d_flat, d_map, d_shorter);
+        LlkSequenceSet& cur = d_map[node];
+        if( cur == newSet )
+            return false;
+        cur = newSet;
+        return true;
     }
+};
+
+struct EbnfAnalyzer2::FirstKTrieEquations : public FixpointSolver::Equations
+{
+    const QVector<int>& d_nodes;
+    const FlatSyntax& d_flat;
+    FirstKTrieMap& d_map;
+    const FirstKTrieMap* d_shorter;
+    LlkTrie& d_trie;
+    quint16 d_k;
+    FirstKTrieEquations(const QVector<int>& nodes, const FlatSyntax& f, FirstKTrieMap& map,
+                        const FirstKTrieMap* shorter, LlkTrie& trie, quint16 k):
+        d_nodes(nodes),d_flat(f),d_map(map),d_shorter(shorter),d_trie(trie),d_k(k){}
+    bool update(int var)
+    {
+        // tries are hash-consed, so comparing refs is comparing sets
+        const int node = d_nodes[var];
+        const LlkTrie::Ref newSet = EbnfAnalyzer2::evaluateNode(node, d_k, d_flat, d_map, d_trie, d_shorter);
+        LlkTrie::Ref& cur = d_map[node];
+        if( cur == newSet )
+            return false;
+        cur = newSet;
+        return true;
+    }
+};
+
+void EbnfAnalyzer2::calculateAllFirstK(quint16 k, EbnfSyntax* syn, FirstKMap& outFirstK,
+                                       const FirstKMap* shorter, FixpointSolver::Stats* stats)
+{
+    // A non-empty prefix is continued by First_k-1 of the following node, not by its First_k which is
+    // still growing. Otherwise a prefix would be kept as complete as long as the following node is
+    // still empty, and depending on the order of evaluation it survived in recursive rules.
+    FirstKMap local;
+    if( k > 1 && shorter == 0 )
+    {
+        calculateAllFirstK(k - 1, syn, local, 0, stats);
+        shorter = &local;
+    }
+    TraceSpan span("calculateAllFirstK");
+    span.addArg("k", k);
+    const FlatSyntax& f = syn->getFlat();
+    outFirstK.clear();
+    outFirstK.resize(f.getNodeCount()); // empty for the nodes not analyzed
+    QVector<int> allNodes;
+    collectAllNodes(f, allNodes);
+
+    FixpointSolver solver(allNodes.size());
+    addFirstKDependencies(allNodes, f, solver);
+    FirstKSetEquations eq(allNodes, f, outFirstK, k > 1 ? shorter : 0, k);
+    solver.solve(&eq);
+    if( stats )
+        *stats += solver.getStats();
+}
+
+LlkTrie::Ref EbnfAnalyzer2::evaluateNode(int node, quint16 k, const FlatSyntax& f, const FirstKTrieMap& currentMap,
+                                         LlkTrie& trie, const FirstKTrieMap* shorter)
+{
+    // same as the LlkSequenceSet version, step by step
+    if( f.doIgnore(node) )
+        return LlkTrie::Epsilon;
+
+    LlkTrie::Ref res = LlkTrie::Empty;
+    switch( f.getType(node) )
+    {
+    case Ast::Node::Terminal:
+        res = trie.single(f.getTermId(node));
+        break;
 
-    foreach( const Ast::Node* node, allNodes )
-        outFirstK.insert(node, LlkSequenceSet());
+    case Ast::Node::Nonterminal:
+        if( f.getTarget(node) != -1 )
+            res = currentMap[f.getTarget(node)];
+        else
+            res = trie.single(f.getTermId(node));
+        break;
+
+    case Ast::Node::Alternative:
+        for( int sub = f.getSubBegin(node); sub < f.getSubEnd(node); sub++ )
+        {
+            if( !f.doIgnore(sub) )
+                res = trie.unite(res, currentMap[sub]);
+        }
+        break;
+
+    case Ast::Node::Sequence:
+        res = LlkTrie::Epsilon;
+        for( int sub = f.getSubBegin(node); sub < f.getSubEnd(node); sub++ )
+        {
+            if( f.doIgnore(sub) )
+                continue;
+            if( shorter )
+                res = trie.unite( trie.concatK(trie.withoutEpsilon(res), (*shorter)[sub], k),
+                                  trie.hasEpsilon(res) ? currentMap[sub] : LlkTrie::Empty );
+            else
+                res = trie.concatK(res, currentMap[sub], k);
+        }
+        break;
 
-    bool changed;
-    do
+    default:
+        break;
+    }
+
+    if( f.getQuant(node) == Ast::Node::ZeroOrOne )
+        res = trie.withEpsilon(res);
+    else if( f.getQuant(node) == Ast::Node::ZeroOrMore )
     {
-        changed = false;
-        foreach( const Ast::Node* node, allNodes )
+        LlkTrie::Ref closure = LlkTrie::Epsilon;
+        LlkTrie::Ref acc = res;
+        for( int i = 1; i <= k; ++i )
         {
-            LlkSequenceSet oldSet = outFirstK.value(node);
-            LlkSequenceSet newSet = evaluateNode(node, k, outFirstK);
-            if( oldSet != newSet )
-            {
-                outFirstK[node] = newSet;
-                changed = true;
-            }
+            closure = trie.unite(closure, acc);
+            acc = trie.concatK(acc, res, k);
         }
-    } while( changed );
+        res = closure;
+    }
+    return res;
+}
+
+void EbnfAnalyzer2::calculateAllFirstK(quint16 k, EbnfSyntax* syn, FirstKTrieMap& outFirstK, LlkTrie& trie,
+                                       const FirstKTrieMap* shorter, FixpointSolver::Stats* stats)
+{
+    // see the LlkSequenceSet version
+    FirstKTrieMap local;
+    if( k > 1 && shorter == 0 )
+    {
+        calculateAllFirstK(k - 1, syn, local, trie, 0, stats);
+        shorter = &local;
+    }
+    TraceSpan span("calculateAllFirstK");
+    span.addArg("k", k);
+    const FlatSyntax& f = syn->getFlat();
+    outFirstK.fill(LlkTrie::Empty, f.getNodeCount());
+    QVector<int> allNodes;
+    collectAllNodes(f, allNodes);
+
+    FixpointSolver solver(allNodes.size());
+    addFirstKDependencies(allNodes, f, solver);
+    FirstKTrieEquations eq(allNodes, f, outFirstK, k > 1 ? shorter : 0, trie, k);
+    solver.solve(&eq);
+    if( stats )
+        *stats += solver.getStats();
 }
 
 LlkSequenceSet EbnfAnalyzer2::computeFirstKForNode(quint16 k, const Ast::Node* node, EbnfSyntax* syn)
 {
+    // NOTE: recalculates the whole table; use a FirstKCache if more than one node is of interest
     FirstKMap firstKMap;
     calculateAllFirstK(k, syn, firstKMap);
-    return firstKMap.value(node);
+    const int id = syn->getFlat().indexOf(node);
+    return id != -1 ? firstKMap[id] : LlkSequenceSet();
 }
 
-LlkSequenceSet EbnfAnalyzer2::computeFollowK(quint16 k, Ast::Node* seq, int fromIdx,
+LlkSequenceSet EbnfAnalyzer2::computeFollowK(quint16 k, int from, int end,
                                                const Ast::NodeRefSet& upperFollow,
-                                               EbnfSyntax* syn)
+                                               FirstKCache* cache)
 {
-    FirstKMap firstKMap;
-    calculateAllFirstK(k, syn, firstKMap);
-
+    Q_ASSERT( cache != 0 );
+    const FlatSyntax& f = cache->getSyntax()->getFlat();
     LlkSequenceSet followSet;
     followSet.insert(LlkSequence());
 
-    for( int j = fromIdx; j < seq->d_subs.size(); j++ )
+    for( int n = from; n < end; n++ )
     {
-        Ast::Node* n = seq->d_subs[j];
-        if( n->doIgnore() )
+        if( f.doIgnore(n) )
             continue;
-        LlkSequenceSet subSet = firstKMap.value(n);
-        if( subSet.isEmpty() )
-            subSet = evaluateNode(n, k, firstKMap);
-        followSet = concatK(followSet, subSet, k);
+        followSet = concatK(followSet, cache->getFirstK(k, n), k);
     }
 
     bool allCapped = true;
@@ -258,10 +442,8 @@ LlkSequenceSet EbnfAnalyzer2::computeFollowK(quint16 k, Ast::Node* seq, int from
     {
         foreach( const Ast::NodeRef& ref, upperFollow )
         {
-            LlkSequence seq;
-            seq.append(ref);
             LlkSequenceSet singleSet;
-            singleSet.insert(seq);
+            singleSet.insert(LlkSequence(ref.d_node->d_termId));
             followSet = concatK(followSet, singleSet, k);
         }
     }
@@ -291,63 +473,150 @@ Ast::NodeRefSet EbnfAnalyzer2::intersectAll(const EbnfAnalyzer2::LlkNodes& lhs,
         return Ast::NodeRefSet();
 }
 
-void EbnfAnalyzer2::calcLlkFirstSet(quint16 k, LlkNodes& res, const Ast::Node* node, FirstFollowSet* tbl)
+void EbnfAnalyzer2::calcLlkFirstSet(quint16 k, LlkNodes& res, const Ast::Node* node, FirstFollowSet* tbl,
+                                    FirstKCache* cache)
 {
-    EbnfSyntax* syn = tbl->getSyntax();
-    FirstKMap firstKMap;
-    calculateAllFirstK(k, syn, firstKMap);
-    LlkSequenceSet seqs = firstKMap.value(node);
-    if( seqs.isEmpty() )
-        seqs = evaluateNode(node, k, firstKMap);
+    FirstKCache local(tbl->getSyntax());
+    if( cache == 0 )
+        cache = &local;
+    const LlkSequenceSet seqs = cache->getFirstK(k, node);
 
     res.clear();
     for( int i = 0; i < k; i++ )
         res.append(Ast::NodeRefSet());
 
+    const EbnfSyntax* syn = cache->getSyntax();
     foreach( const LlkSequence& seq, seqs )
     {
         for( int i = 0; i < seq.size() && i < k; i++ )
-            res[i].insert(seq[i]);
+            res[i].insert(Ast::NodeRef(syn->getTerminal(seq[i])));
     }
 }
 
-void EbnfAnalyzer2::checkForAmbiguity(FirstFollowSet* set, EbnfErrors* err)
+class EbnfAnalyzer2::AmbiguityWorker : public QRunnable
 {
+public:
+    // all workers pull the next definition from the shared cursor, so a thread which got a cheap
+    // definition takes over the remaining work instead of waiting for the others
+    const QList<int>& d_defs; // bodies
+    FirstFollowSet* d_set;
+    FirstKCache* d_cache;
+    QAtomicInt* d_next;
+    const QAtomicInt* d_cancel;
+    QList<EbnfErrors::Entry>* d_results; // one slot per definition
+    AmbiguityWorker(const QList<int>& defs, FirstFollowSet* set, FirstKCache* cache,
+                    QAtomicInt* next, const QAtomicInt* cancel, QList<EbnfErrors::Entry>* results):
+        d_defs(defs),d_set(set),d_cache(cache),d_next(next),d_cancel(cancel),d_results(results){}
+    void run()
+    {
+        int i;
+        while( ( i = d_next->fetchAndAddOrdered(1) ) < d_defs.size() )
+        {
+            if( d_cancel && d_cancel->load() )
+                return;
+            EbnfErrors errs;
+            errs.setBuffered(true);
+            try
+            {
+                checkForAmbiguityImp( d_defs[i], d_set, &errs, true, d_cache );
+            }catch(...)
+            {
+                qCritical() << "EbnfAnalyzer2::checkForAmbiguity exception";
+            }
+            d_results[i] = errs.getBuffer();
+        }
+    }
+};
+
+void EbnfAnalyzer2::checkForAmbiguity(FirstFollowSet* set, EbnfErrors* err, FirstKCache* cache, int threads,
+                                      const QAtomicInt* cancel)
+{
+    TraceSpan span("checkForAmbiguity");
     EbnfSyntax* syn = set->getSyntax();
-    for( int i = 0; i < syn->getOrderedDefs().size(); i++ )
+    const FlatSyntax* f = set->getFlat();
+    if( f == 0 )
+        return;
+    FirstKCache local(syn);
+    if( cache == 0 || cache->getSyntax() != syn )
+        cache = &local;
+    QList<int> defs;
+    for( int i = 0; i < f->getDefCount(); i++ )
     {
-        const Ast::Definition* d = syn->getOrderedDefs()[i];
-        if( d->doIgnore() || ( i != 0 && d->d_usedBy.isEmpty() ) || d->d_node == 0 )
+        const Ast::Definition* d = f->getDef(i);
+        if( d->doIgnore() || ( i != 0 && f->getUserBegin(i) == f->getUserEnd(i) ) || f->getBody(i) == -1 )
             continue;
+        defs.append(f->getBody(i));
+    }
 
-        try
-        {
-            checkForAmbiguity( d->d_node, set, err );
-        }catch(...)
+    if( threads <= 1 || defs.size() <= 1 )
+    {
+        foreach( int body, defs )
         {
-            qCritical() << "EbnfAnalyzer2::checkForAmbiguity exception";
+            if( cancel && cancel->load() )
+                return;
+            try
+            {
+                checkForAmbiguityImp( body, set, err, true, cache );
+            }catch(...)
+            {
+                qCritical() << "EbnfAnalyzer2::checkForAmbiguity exception";
+            }
         }
+        return;
     }
+
+    // the workers only read the syntax and the tables; FirstKCache locks itself, the caches of
+    // FirstFollowSet are completely filled by setSyntax
+    QVector< QList<EbnfErrors::Entry> > results(defs.size());
+    QAtomicInt next(0);
+    QThreadPool pool;
+    threads = qMin(threads, defs.size());
+    pool.setMaxThreadCount(threads);
+    for( int t = 0; t < threads; t++ )
+        pool.start( new AmbiguityWorker(defs, set, cache, &next, cancel, results.data()) );
+    pool.waitForDone();
+    if( cancel && cancel->load() )
+        return;
+
+    // merge in definition order, so the result doesn't depend on the scheduling
+    for( int i = 0; i < results.size(); i++ )
+    {
+        foreach( const EbnfErrors::Entry& e, results[i] )
+            err->add(e);
+    }
+}
+
+void EbnfAnalyzer2::checkForAmbiguity(Ast::Node* node, FirstFollowSet* set, EbnfErrors* errs, bool recursive,
+                                      FirstKCache* cache)
+{
+    if( set->getFlat() == 0 )
+        return;
+    FirstKCache local(set->getSyntax());
+    if( cache == 0 )
+        cache = &local;
+    checkForAmbiguityImp( set->getFlat()->indexOf(node), set, errs, recursive, cache );
 }
 
-void EbnfAnalyzer2::checkForAmbiguity(Ast::Node* node, FirstFollowSet* set, EbnfErrors* errs, bool recursive)
+void EbnfAnalyzer2::checkForAmbiguityImp(int node, FirstFollowSet* set, EbnfErrors* errs, bool recursive,
+                                      FirstKCache* cache)
 {
-    if( node == 0 || node->doIgnore() )
+    const FlatSyntax& f = *set->getFlat();
+    if( node == -1 || f.doIgnore(node) )
         return;
 
-    findAmbiguousAlternatives(node, set, errs);
-    findAmbiguousOptionals(node, set, errs);
+    findAmbiguousAlternatives(node, set, errs, cache);
+    findAmbiguousOptionals(node, set, errs, cache);
 
     if( !recursive )
         return;
 
-    switch( node->d_type )
+    switch( f.getType(node) )
     {
     case Ast::Node::Sequence:
     case Ast::Node::Alternative:
-        foreach( Ast::Node* sub, node->d_subs )
+        for( int sub = f.getSubBegin(node); sub < f.getSubEnd(node); sub++ )
         {
-            checkForAmbiguity( sub, set, errs, recursive );
+            checkForAmbiguityImp( sub, set, errs, recursive, cache );
         }
         break;
     default:
@@ -366,26 +635,32 @@ Ast::ConstNodeList EbnfAnalyzer2::findPath(const Ast::Node* from, const Ast::Nod
     return res;
 }
 
-void EbnfAnalyzer2::findAmbiguousAlternatives(Ast::Node* node, FirstFollowSet* set, EbnfErrors* errs)
+void EbnfAnalyzer2::findAmbiguousAlternatives(int node, FirstFollowSet* set, EbnfErrors* errs,
+                                              FirstKCache* cache)
 {
-    if( node->d_type != Ast::Node::Alternative )
+    const FlatSyntax& f = *set->getFlat();
+    if( f.getType(node) != Ast::Node::Alternative )
         return;
+    TraceSpan span("findAmbiguousAlternatives");
+    if( span.isActive() )
+        span.addArg("def", f.getNode(node)->d_owner->d_tok.d_val.toBa());
 
-    for( int i = 0; i < node->d_subs.size(); i++ )
+    const int begin = f.getSubBegin(node);
+    for( int a = begin; a < f.getSubEnd(node); a++ )
     {
-        for( int j = i + 1; j < node->d_subs.size(); j++ )
+        for( int b = a + 1; b < f.getSubEnd(node); b++ )
         {
-            const Ast::Node* a = node->d_subs[i];
-            const Ast::Node* b = node->d_subs[j];
-            if( a->doIgnore() || b->doIgnore() )
+            if( f.doIgnore(a) || f.doIgnore(b) )
                 continue;
 
-            const Ast::NodeRefSet diff = set->getFirstSet(a) & set->getFirstSet(b);
-            if( diff.isEmpty() )
+            const TermSet firstA = set->getFirstBits(a);
+            const TermSet firstB = set->getFirstBits(b);
+            if( !firstA.intersects(firstB) )
                 continue;
+            const Ast::NodeRefSet diff = set->toRefSet( firstA & firstB );
 
-            const Ast::Node* predA = EbnfSyntax::firstPredicateOf(a);
-            const Ast::Node* predB = EbnfSyntax::firstPredicateOf(b);
+            const Ast::Node* predA = EbnfSyntax::firstPredicateOf(f.getNode(a));
+            const Ast::Node* predB = EbnfSyntax::firstPredicateOf(f.getNode(b));
             int ll = 0;
             if( predA != 0 )
                 ll = predA->getLlk();
@@ -400,26 +675,29 @@ void EbnfAnalyzer2::findAmbiguousAlternatives(Ast::Node* node, FirstFollowSet* s
 
             if( ll > 0 )
             {
-                FirstKMap firstKMap;
-                calculateAllFirstK(ll, set->getSyntax(), firstKMap);
-
-                LlkSequenceSet llkA = firstKMap.value(a);
-                if( llkA.isEmpty() )
-                    llkA = evaluateNode(a, ll, firstKMap);
-                LlkSequenceSet llkB = firstKMap.value(b);
-                if( llkB.isEmpty() )
-                    llkB = evaluateNode(b, ll, firstKMap);
+                if( cache->getBackend() == FirstKCache::Tries )
+                {
+                    const LlkTrie::Ref trieA = cache->getFirstKTrie(ll, a);
+                    const LlkTrie::Ref trieB = cache->getFirstKTrie(ll, b);
+                    QReadLocker lock(cache->getLock());
+                    if( !cache->getTrie().intersects( trieA, trieB ) )
+                        continue;
+                }else
+                {
+                    const LlkSequenceSet llkA = cache->getFirstK(ll, a);
+                    const LlkSequenceSet llkB = cache->getFirstK(ll, b);
 
-                LlkSequenceSet intersect = llkA & llkB;
+                    LlkSequenceSet intersect = llkA & llkB;
 
-                if( intersect.isEmpty() )
-                    continue;
+                    if( intersect.isEmpty() )
+                        continue;
+                }
 
                 const Ast::Node* pred = predA != 0 ? predA : predB;
-                const Ast::Node* other = predA != 0 ? b : a;
+                const Ast::Node* other = predA != 0 ? f.getNode(b) : f.getNode(a);
                 if( pred )
                     errs->warning(EbnfErrors::Analysis, pred->d_tok.d_lineNr, pred->d_tok.d_colNr,
-                            QString("predicate not effective for LL(%1)").arg(ll),
+                            EbnfErrors::Msg("predicate not effective for LL(%1)").arg(ll),
                                   QVariant::fromValue(EbnfSyntax::IssueData(EbnfSyntax::IssueData::BadPred,
                                                                             pred,other)));
             }
@@ -429,55 +707,60 @@ void EbnfAnalyzer2::findAmbiguousAlternatives(Ast::Node* node, FirstFollowSet* s
 
             if( !diff.isEmpty() )
             {
-                const Ast::Node* aa = EbnfSyntax::firstVisibleElementOf(a);
+                const Ast::Node* aa = EbnfSyntax::firstVisibleElementOf(f.getNode(a));
                 Ast::NodeSet diff2 = EbnfSyntax::collectNodes( diff, set->getFirstNodeSet(a) );
                 diff2 += EbnfSyntax::collectNodes( diff, set->getFirstNodeSet(b) );
                 errs->error(EbnfErrors::Analysis, aa->d_tok.d_lineNr, aa->d_tok.d_colNr,
-                            QString("alternatives %1 and %2 are LL(1) ambiguous because of %3")
-                            .arg(i+1).arg(j+1).arg(EbnfSyntax::pretty(diff)),
+                            EbnfErrors::Msg("alternatives %1 and %2 are LL(1) ambiguous because of %3")
+                            .arg(a-begin+1).arg(b-begin+1).arg(EbnfSyntax::pretty(diff)),
                             QVariant::fromValue(EbnfSyntax::IssueData(
-                                                    EbnfSyntax::IssueData::AmbigAlt,a,b,diff2.toList())));
+                                                    EbnfSyntax::IssueData::AmbigAlt,f.getNode(a),f.getNode(b),
+                                                    diff2.toList())));
             }
         }
     }
 }
 
-void EbnfAnalyzer2::findAmbiguousOptionals(Ast::Node* seq, FirstFollowSet* set, EbnfErrors* errs)
+void EbnfAnalyzer2::findAmbiguousOptionals(int seq, FirstFollowSet* set, EbnfErrors* errs,
+                                           FirstKCache* cache)
 {
-    if( seq->d_type != Ast::Node::Sequence )
+    const FlatSyntax& f = *set->getFlat();
+    if( f.getType(seq) != Ast::Node::Sequence )
         return;
+    TraceSpan span("findAmbiguousOptionals");
+    if( span.isActive() )
+        span.addArg("def", f.getNode(seq)->d_owner->d_tok.d_val.toBa());
 
-    Ast::NodeRefSet upperFollow = set->getFollowSet(seq);
-    for( int i = 0; i < seq->d_subs.size(); i++ )
+    const TermSet upperFollow = set->getFollowBits(seq);
+    for( int a = f.getSubBegin(seq); a < f.getSubEnd(seq); a++ )
     {
-        const Ast::Node* a = seq->d_subs[i];
-        if( a->doIgnore() || !a->isNullable() )
+        if( f.doIgnore(a) || !f.isNullable(a) )
             continue;
-        Ast::NodeRefSet follow;
+        TermSet follow;
         bool nonNullableFound = false;
-        const Ast::Node* b = 0;
-        for( int j = i + 1; j < seq->d_subs.size(); j++ )
+        int b = -1;
+        for( int n = a + 1; n < f.getSubEnd(seq); n++ )
         {
-            const Ast::Node* n = seq->d_subs[j];
-            if( n->doIgnore() )
+            if( f.doIgnore(n) )
                 continue;
-            if( b == 0 )
+            if( b == -1 )
                 b = n;
-            follow += set->getFirstSet(n);
-            if( !n->isNullable() )
+            follow |= set->getFirstBits(n);
+            if( !f.isNullable(n) )
             {
                 nonNullableFound = true;
                 break;
             }
         }
         if( !nonNullableFound )
-            follow += upperFollow;
+            follow |= upperFollow;
 
-        const Ast::NodeRefSet diff = set->getFirstSet(a) & follow;
-        if( diff.isEmpty() )
+        const TermSet firstA = set->getFirstBits(a);
+        if( !firstA.intersects(follow) )
             continue;
+        const Ast::NodeRefSet diff = set->toRefSet( firstA & follow );
 
-        const Ast::Node* pred = EbnfSyntax::firstPredicateOf(a);
+        const Ast::Node* pred = EbnfSyntax::firstPredicateOf(f.getNode(a));
         int ll = 0;
         if( pred != 0 )
         {
@@ -492,69 +775,96 @@ void EbnfAnalyzer2::findAmbiguousOptionals(Ast::Node* seq, FirstFollowSet* set,
             ll = pred->getLlk();
             if( ll > 0 )
             {
-                FirstKMap firstKMap;
-                calculateAllFirstK(ll, set->getSyntax(), firstKMap);
+                if( cache->getBackend() == FirstKCache::Tries )
+                {
+                    if( !optionalIsAmbiguous(seq, a, ll, cache) )
+                        continue;
+                }else
+                {
+                    LlkSequenceSet pathTake = cache->getFirstK(ll, a);
 
-                LlkSequenceSet pathTake = firstKMap.value(a);
-                if( pathTake.isEmpty() )
-                    pathTake = evaluateNode(a, ll, firstKMap);
+                    // remove epsilon: we only want the "take" sequences, not the "skip" (epsilon) path
+                    pathTake.remove(LlkSequence());
+                    if( pathTake.isEmpty() )
+                        continue;
 
-                // remove epsilon: we only want the "take" sequences, not the "skip" (epsilon) path
-                pathTake.remove(LlkSequence());
-                if( pathTake.isEmpty() )
-                    continue;
+                    LlkSequenceSet pathSkip;
+                    pathSkip.insert(LlkSequence());
 
-                LlkSequenceSet pathSkip;
-                pathSkip.insert(LlkSequence());
+                    for( int sub = a + 1; sub < f.getSubEnd(seq); sub++ )
+                    {
+                        if( f.doIgnore(sub) )
+                            continue;
+                        const LlkSequenceSet nextSet = cache->getFirstK(ll, sub);
+                        pathTake = concatK(pathTake, nextSet, ll);
+                        pathSkip = concatK(pathSkip, nextSet, ll);
+                    }
 
-                for( int j = i + 1; j < seq->d_subs.size(); j++ )
-                {
-                    Ast::Node* sub = seq->d_subs[j];
-                    if( sub->doIgnore() )
+                    LlkSequenceSet intersect = pathTake & pathSkip;
+                    if( intersect.isEmpty() )
                         continue;
-                    LlkSequenceSet nextSet = firstKMap.value(sub);
-                    if( nextSet.isEmpty() )
-                        nextSet = evaluateNode(sub, ll, firstKMap);
-                    pathTake = concatK(pathTake, nextSet, ll);
-                    pathSkip = concatK(pathSkip, nextSet, ll);
                 }
 
-                LlkSequenceSet intersect = pathTake & pathSkip;
-                if( intersect.isEmpty() )
-                    continue;
-
                 errs->warning(EbnfErrors::Analysis, pred->d_tok.d_lineNr, pred->d_tok.d_colNr,
-                            QString("predicate not effective for LL(%1)").arg(ll),
+                            EbnfErrors::Msg("predicate not effective for LL(%1)").arg(ll),
                               QVariant::fromValue(EbnfSyntax::IssueData(
-                                EbnfSyntax::IssueData::BadPred,pred, b ? b : seq)) );
+                                EbnfSyntax::IssueData::BadPred,pred, f.getNode( b != -1 ? b : seq ))) );
             }
         }
         Ast::NodeSet diff2 = EbnfSyntax::collectNodes( diff, set->getFirstNodeSet(a) );
-        if( b != 0 )
+        if( b != -1 )
             diff2 += EbnfSyntax::collectNodes( diff, set->getFirstNodeSet(b) );
-        reportAmbig( seq, i, diff, diff2, set, errs );
+        reportAmbig( seq, a, diff, diff2, set, errs );
     }
 }
 
-void EbnfAnalyzer2::reportAmbig(Ast::Node* sequence, int ambigIdx, const Ast::NodeRefSet& ambigSet,
+bool EbnfAnalyzer2::optionalIsAmbiguous(int seq, int opt, quint16 k, FirstKCache* cache)
+{
+    // trie version of the take/skip check in findAmbiguousOptionals
+    const FlatSyntax& f = cache->getSyntax()->getFlat();
+    // the lock is not recursive, so the tables are consulted before it is taken
+    const LlkTrie::Ref optSet = cache->getFirstKTrie(k, opt);
+    QList<LlkTrie::Ref> nextSets;
+    for( int sub = opt + 1; sub < f.getSubEnd(seq); sub++ )
+    {
+        if( !f.doIgnore(sub) )
+            nextSets.append( cache->getFirstKTrie(k, sub) );
+    }
+    QWriteLocker lock(cache->getLock()); // concatK adds nodes to the trie
+    LlkTrie& trie = cache->getTrie();
+    LlkTrie::Ref pathTake = trie.withoutEpsilon( optSet );
+    if( pathTake == LlkTrie::Empty )
+        return false;
+    LlkTrie::Ref pathSkip = LlkTrie::Epsilon;
+    foreach( LlkTrie::Ref nextSet, nextSets )
+    {
+        pathTake = trie.concatK(pathTake, nextSet, k);
+        pathSkip = trie.concatK(pathSkip, nextSet, k);
+    }
+    return trie.intersects(pathTake, pathSkip);
+}
+
+void EbnfAnalyzer2::reportAmbig(int sequence, int a, const Ast::NodeRefSet& ambigSet,
                                 const Ast::NodeSet& ambigSet2, FirstFollowSet* set, EbnfErrors* errs)
 {
-    Ast::Node* a = sequence->d_subs[ambigIdx];
-    const Ast::Node* start = EbnfSyntax::firstVisibleElementOf(sequence);
+    const FlatSyntax& f = *set->getFlat();
+    const Ast::Node* aNode = f.getNode(a);
+    const Ast::Node* start = EbnfSyntax::firstVisibleElementOf(f.getNode(sequence));
     QString ofSeq;
-    if( start && start != a )
+    if( start && start != aNode )
         ofSeq = QString("start. w. '%1' ").arg(start->d_tok.d_val.toStr());
 
+    const TermSet ambigBits = FirstFollowSet::toBits(ambigSet);
     const Ast::Node* next = 0;
     bool fullAmbig = false;
-    for( int j = ambigIdx + 1; j < sequence->d_subs.size(); j++ )
+    for( int j = a + 1; j < f.getSubEnd(sequence); j++ )
     {
-        const Ast::NodeRefSet diffDiff = ambigSet & set->getFirstSet(sequence->d_subs[j]);
+        const TermSet diffDiff = ambigBits & set->getFirstBits(j);
         if( !diffDiff.isEmpty() )
         {
-            if( diffDiff == ambigSet )
+            if( diffDiff == ambigBits )
                 fullAmbig = true;
-            next = EbnfSyntax::firstVisibleElementOf(sequence->d_subs[j]);
+            next = EbnfSyntax::firstVisibleElementOf(f.getNode(j));
             break;
         }
     }
@@ -566,13 +876,13 @@ void EbnfAnalyzer2::reportAmbig(Ast::Node* sequence, int ambigIdx, const Ast::No
             dots = "...";
         ambig = QString("w. '%1'%2 ").arg(next->d_tok.d_val.toStr()).arg(dots);
     }else
-        next = sequence;
+        next = f.getNode(sequence);
 
-    errs->warning(EbnfErrors::Analysis, a->d_tok.d_lineNr, a->d_tok.d_colNr,
-                QString("opt. elem. %1 of seq. %2is LL(1) ambig. %3 because of %4")
-                .arg(ambigIdx+1).arg(ofSeq).arg(ambig).arg(EbnfSyntax::pretty(ambigSet)),
+    errs->warning(EbnfErrors::Analysis, aNode->d_tok.d_lineNr, aNode->d_tok.d_colNr,
+                EbnfErrors::Msg("opt. elem. %1 of seq. %2is LL(1) ambig. %3 because of %4")
+                .arg(f.getIndexInParent(a)+1).arg(ofSeq).arg(ambig).arg(EbnfSyntax::pretty(ambigSet)),
                   QVariant::fromValue(EbnfSyntax::IssueData(
-                                          EbnfSyntax::IssueData::AmbigOpt,a,next,ambigSet2.toList())));
+                                          EbnfSyntax::IssueData::AmbigOpt,aNode,next,ambigSet2.toList())));
 }
 
 bool EbnfAnalyzer2::findPathImp(Ast::ConstNodeList& path, const Ast::Node* to)
@@ -700,3 +1010,234 @@ bool EbnfAnalyzer2::checkLaPredicate(const Ast::Node* pred, quint16 k,
     LlkSequenceSet intersect = pathA & pathB;
     return intersect.isEmpty();
 }
+
+void LlkSequence::append(quint16 id)
+{
+    Q_ASSERT( id != 0 );
+    if( d_len < Packed )
+        d_head |= quint64(id) << ( d_len * 16 );
+    else
+        d_tail.append(id);
+    d_len++;
+}
+
+void LlkSequence::append(const LlkSequence& rhs, int max)
+{
+    const int n = qMin( int(rhs.d_len), max - d_len );
+    if( n <= 0 )
+        return;
+    if( d_len + n <= Packed )
+    {
+        // the usual case: a few shifts, no allocation
+        quint64 bits = rhs.d_head;
+        if( n < Packed )
+            bits &= ( quint64(1) << ( n * 16 ) ) - 1;
+        d_head |= bits << ( d_len * 16 );
+        d_len += n;
+    }else
+        for( int i = 0; i < n; i++ )
+            append( rhs.at(i) );
+}
+
+void LlkSequence::truncate(int len)
+{
+    if( len >= d_len )
+        return;
+    if( len < 0 )
+        len = 0;
+    if( len <= Packed )
+    {
+        if( len < Packed )
+            d_head &= ( quint64(1) << ( len * 16 ) ) - 1;
+        d_tail.clear();
+    }else
+        d_tail.resize( len - Packed );
+    d_len = len;
+}
+
+void FirstKCache::setSyntax(EbnfSyntax* syn)
+{
+    if( syn == d_syn )
+        return;
+    clear();
+    d_syn = syn;
+}
+
+void FirstKCache::setBackend(FirstKCache::Backend b)
+{
+    if( b == d_backend )
+        return;
+    clear();
+    d_backend = b;
+}
+
+void FirstKCache::clear()
+{
+    foreach( FirstKMap* m, d_tables )
+        delete m;
+    d_tables.clear();
+    foreach( FirstKTrieMap* m, d_trieTables )
+        delete m;
+    d_trieTables.clear();
+    d_trie.clear();
+    d_stats = FixpointSolver::Stats();
+}
+
+QList<quint16> FirstKCache::getCalculatedK() const
+{
+    QReadLocker lock(&d_lock);
+    QList<quint16> res = d_tables.keys() + d_trieTables.keys();
+    std::sort( res.begin(), res.end() );
+    return res;
+}
+
+static quint64 countSequences( const LlkTrie& trie, LlkTrie::Ref r, QHash<LlkTrie::Ref,quint64>& counts )
+{
+    // the nodes are shared, so each one is only counted once
+    QHash<LlkTrie::Ref,quint64>::const_iterator i = counts.find( r );
+    if( i != counts.end() )
+        return i.value();
+    quint64 res = trie.hasEpsilon( r ) ? 1 : 0;
+    for( int e = 0; e < trie.edgeCount( r ); e++ )
+        res += countSequences( trie, trie.edgeTarget( r, e ), counts );
+    counts.insert( r, res );
+    return res;
+}
+
+quint64 FirstKCache::getSequenceCount(quint16 k) const
+{
+    QReadLocker lock(&d_lock);
+    quint64 res = 0;
+    if( const FirstKMap* m = d_tables.value(k) )
+    {
+        for( int i = 0; i < m->size(); i++ )
+            res += (*m)[i].size();
+    }
+    if( const FirstKTrieMap* m = d_trieTables.value(k) )
+    {
+        QHash<LlkTrie::Ref,quint64> counts;
+        for( int i = 0; i < m->size(); i++ )
+            res += countSequences( d_trie, (*m)[i], counts );
+    }
+    return res;
+}
+
+const FirstKMap& FirstKCache::getTable(quint16 k)
+{
+    Q_ASSERT( d_syn != 0 );
+    {
+        // tables don't change once calculated, so the workers only contend when one is missing
+        QReadLocker lock(&d_lock);
+        if( const FirstKMap* m = d_tables.value(k) )
+            return *m;
+    }
+    QWriteLocker lock(&d_lock);
+    return getTableImp(k);
+}
+
+const FirstKMap& FirstKCache::getTableImp(quint16 k)
+{
+    FirstKMap* m = d_tables.value(k); // another thread might have calculated it meanwhile
+    if( m == 0 )
+    {
+        // the shorter table is needed first; it is inserted by the recursion
+        const FirstKMap* shorter = k > 1 ? &getTableImp(k - 1) : 0;
+        m = new FirstKMap();
+        EbnfAnalyzer2::calculateAllFirstK(k, d_syn, *m, shorter, &d_stats);
+        d_tables.insert(k, m);
+    }
+    return *m;
+}
+
+const FirstKTrieMap& FirstKCache::getTrieTable(quint16 k)
+{
+    Q_ASSERT( d_syn != 0 );
+    {
+        QReadLocker lock(&d_lock);
+        if( const FirstKTrieMap* m = d_trieTables.value(k) )
+            return *m;
+    }
+    QWriteLocker lock(&d_lock);
+    return getTrieTableImp(k);
+}
+
+const FirstKTrieMap& FirstKCache::getTrieTableImp(quint16 k)
+{
+    FirstKTrieMap* m = d_trieTables.value(k);
+    if( m == 0 )
+    {
+        const FirstKTrieMap* shorter = k > 1 ? &getTrieTableImp(k - 1) : 0;
+        m = new FirstKTrieMap();
+        EbnfAnalyzer2::calculateAllFirstK(k, d_syn, *m, d_trie, shorter, &d_stats);
+        d_trieTables.insert(k, m);
+    }
+    return *m;
+}
+
+LlkSequenceSet FirstKCache::getFirstK(quint16 k, const Ast::Node* node)
+{
+    Q_ASSERT( d_syn != 0 );
+    const int id = d_syn->getFlat().indexOf(node);
+    if( id == -1 )
+        return LlkSequenceSet();
+    return getFirstK( k, id );
+}
+
+LlkSequenceSet FirstKCache::getFirstK(quint16 k, int node)
+{
+    if( d_backend == Tries )
+    {
+        const LlkTrie::Ref r = getFirstKTrie(k, node);
+        QReadLocker lock(&d_lock);
+        return toSet( r );
+    }
+    const FirstKMap& m = getTable(k); // tables don't change once calculated
+    LlkSequenceSet res = m[node];
+    if( res.isEmpty() )
+        res = EbnfAnalyzer2::evaluateNode(node, k, d_syn->getFlat(), m);
+    return res;
+}
+
+LlkTrie::Ref FirstKCache::getFirstKTrie(quint16 k, const Ast::Node* node)
+{
+    Q_ASSERT( d_syn != 0 );
+    const int id = d_syn->getFlat().indexOf(node);
+    if( id == -1 )
+        return LlkTrie::Empty;
+    return getFirstKTrie( k, id );
+}
+
+LlkTrie::Ref FirstKCache::getFirstKTrie(quint16 k, int node)
+{
+    Q_ASSERT( d_backend == Tries );
+    const FirstKTrieMap& m = getTrieTable(k);
+    LlkTrie::Ref res = m[node];
+    if( res == LlkTrie::Empty )
+    {
+        // evaluateNode adds nodes to the trie
+        QWriteLocker lock(&d_lock);
+        res = EbnfAnalyzer2::evaluateNode(node, k, d_syn->getFlat(), m, d_trie);
+    }
+    return res;
+}
+
+LlkSequenceSet FirstKCache::toSet(LlkTrie::Ref r) const
+{
+    LlkSequenceSet res;
+    LlkSequence prefix;
+    toSet( r, prefix, res );
+    return res;
+}
+
+void FirstKCache::toSet(LlkTrie::Ref r, LlkSequence& prefix, LlkSequenceSet& res) const
+{
+    if( d_trie.hasEpsilon(r) )
+        res.insert(prefix);
+    const int len = prefix.size();
+    for( int i = 0; i < d_trie.edgeCount(r); i++ )
+    {
+        prefix.append( d_trie.edgeId(r,i) );
+        toSet( d_trie.edgeTarget(r,i), prefix, res );
+        prefix.truncate(len);
+    }
+}
@@ -21,23 +21,109 @@
 */
 
 #include "EbnfSyntax.h"
+#include "LlkTrie.h"
+#include "FixpointSolver.h"
 #include <QList>
 #include <QSet>
 #include <QHash>
+#include <QVector>
+#include <QReadWriteLock>
+#include <QAtomicInt>
 
 class FirstFollowSet;
 
-typedef QList<Ast::NodeRef> LlkSequence;
+// A First_k sequence of terminal ids (see Ast::Node::d_termId and EbnfSyntax::getTerminal).
+// The first four ids are packed into one word, so for k <= 4 sequences neither allocate
+// nor need pointer chasing to compare and hash.
+class LlkSequence
+{
+public:
+    enum { Packed = 4 };
+    LlkSequence():d_head(0),d_len(0) {}
+    explicit LlkSequence( quint16 id ):d_head(id),d_len(1) { Q_ASSERT( id != 0 ); }
+
+    int size() const { return d_len; }
+    bool isEmpty() const { return d_len == 0; }
+    quint16 at( int i ) const
+    {
+        Q_ASSERT( i >= 0 && i < d_len );
+        if( i < Packed )
+            return quint16( d_head >> ( i * 16 ) );
+        else
+            return d_tail[i - Packed];
+    }
+    quint16 operator[]( int i ) const { return at(i); }
+
+    void append( quint16 id );
+    void append( const LlkSequence& rhs, int max ); // appends rhs until size() reaches max
+    void truncate( int len );
+
+    quint64 head() const { return d_head; }
+    bool operator==( const LlkSequence& rhs ) const
+    {
+        return d_head == rhs.d_head && d_len == rhs.d_len && ( d_len <= Packed || d_tail == rhs.d_tail );
+    }
+    bool operator!=( const LlkSequence& rhs ) const { return !( *this == rhs ); }
+private:
+    quint64 d_head;
+    QVector<quint16> d_tail; // ids from Packed on, empty for short sequences
+    quint16 d_len;
+};
 
 inline uint qHash(const LlkSequence& key, uint seed = 0)
 {
-    uint hash = seed;
-    for( int i = 0; i < key.size(); ++i )
-        hash ^= Ast::qHash(key.at(i)) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+    uint hash = ::qHash(key.head(), seed) ^ key.size();
+    for( int i = LlkSequence::Packed; i < key.size(); ++i )
+        hash ^= key.at(i) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
     return hash;
 }
 
 typedef QSet<LlkSequence> LlkSequenceSet;
+typedef QVector<LlkSequenceSet> FirstKMap; // by node id of EbnfSyntax::getFlat
+typedef QVector<LlkTrie::Ref> FirstKTrieMap;
+
+// Owns the First_k tables of one analysis run; each table is calculated once per k on first use
+// and then shared by all checks and the generator, instead of redoing the fixpoint per predicate.
+// With the Tries backend the tables hold LlkTrie refs and sets are only materialized on request.
+class FirstKCache
+{
+public:
+    enum Backend { SequenceSets, Tries };
+    explicit FirstKCache( EbnfSyntax* syn = 0, Backend b = SequenceSets ):
+        d_syn(syn),d_backend(b) {}
+    ~FirstKCache() { clear(); }
+
+    void setSyntax( EbnfSyntax* );
+    EbnfSyntax* getSyntax() const { return d_syn; }
+    void setBackend( Backend );
+    Backend getBackend() const { return d_backend; }
+    void clear();
+
+    LlkSequenceSet getFirstK( quint16 k, const Ast::Node* );
+    LlkSequenceSet getFirstK( quint16 k, int node ); // by node id of EbnfSyntax::getFlat
+    LlkTrie::Ref getFirstKTrie( quint16 k, const Ast::Node* ); // Tries backend only
+    LlkTrie::Ref getFirstKTrie( quint16 k, int node );
+    LlkTrie& getTrie() { return d_trie; } // if shared by threads: read lock to query, write lock to add nodes
+    LlkSequenceSet toSet( LlkTrie::Ref ) const;
+    const FixpointSolver::Stats& getStats() const { return d_stats; } // summed over all tables
+    QList<quint16> getCalculatedK() const; // the tables calculated so far, ascending
+    quint64 getSequenceCount( quint16 k ) const; // summed over all nodes of the table for k
+    QReadWriteLock* getLock() { return &d_lock; } // guards the tables and the trie, not recursive
+private:
+    Q_DISABLE_COPY(FirstKCache)
+    const FirstKMap& getTable( quint16 k );
+    const FirstKTrieMap& getTrieTable( quint16 k );
+    const FirstKMap& getTableImp( quint16 k ); // the caller holds the write lock
+    const FirstKTrieMap& getTrieTableImp( quint16 k );
+    void toSet( LlkTrie::Ref, LlkSequence&, LlkSequenceSet& ) const;
+    QHash<quint16,FirstKMap*> d_tables; // pointers so references handed out stay valid
+    QHash<quint16,FirstKTrieMap*> d_trieTables;
+    LlkTrie d_trie;
+    FixpointSolver::Stats d_stats;
+    mutable QReadWriteLock d_lock;
+    EbnfSyntax* d_syn;
+    Backend d_backend;
+};
 
 class EbnfAnalyzer2
 {
@@ -50,29 +136,51 @@ public:
     typedef QList<Ast::NodeRefSet> LlkNodes;
     static Ast::NodeRefSet intersectAll( const LlkNodes& lhs, const LlkNodes& rhs ); // identical
 
-    static void calcLlkFirstSet(quint16 k, LlkNodes&, const Ast::Node* node, FirstFollowSet* ); // improved over EbnfAnalyzer
+    static void calcLlkFirstSet(quint16 k, LlkNodes&, const Ast::Node* node, FirstFollowSet*,
+                                FirstKCache* = 0 ); // improved over EbnfAnalyzer
 
-    static void checkForAmbiguity( FirstFollowSet*, EbnfErrors*); // improved
-    static void checkForAmbiguity( Ast::Node*, FirstFollowSet*, EbnfErrors*, bool recursive = true ); // improved
+    // threads > 1 checks the definitions in parallel; the issues are the same and in the same order
+    // improved; if cancel is set and becomes non-zero the check stops after the current definition
+    static void checkForAmbiguity( FirstFollowSet*, EbnfErrors*, FirstKCache* = 0, int threads = 1,
+                                   const QAtomicInt* cancel = 0 );
+    static void checkForAmbiguity( Ast::Node*, FirstFollowSet*, EbnfErrors*, bool recursive = true,
+                                   FirstKCache* = 0 ); // improved
 
     static Ast::ConstNodeList findPath( const Ast::Node* from, const Ast::Node* to ); // identicals
 
     static LlkSequenceSet computeFirstKForNode(quint16 k, const Ast::Node* node, EbnfSyntax* syn);
 
 protected:
-    typedef QHash<const Ast::Node*, LlkSequenceSet> FirstKMap;
-
-    static void calculateAllFirstK(quint16 k, EbnfSyntax* syn, FirstKMap& outFirstK);
-    static LlkSequenceSet evaluateNode(const Ast::Node* node, quint16 k, const FirstKMap& currentMap);
+    friend class FirstKCache;
+    struct FirstKSetEquations;
+    struct FirstKTrieEquations;
+    friend struct FirstKSetEquations;
+    friend struct FirstKTrieEquations;
+    class AmbiguityWorker;
+    // the analysis walks EbnfSyntax::getFlat; nodes are given by id
+    // shorter is the table for k-1; it is calculated if not given
+    static void calculateAllFirstK(quint16 k, EbnfSyntax* syn, FirstKMap& outFirstK,
+                                   const FirstKMap* shorter = 0, FixpointSolver::Stats* = 0);
+    static LlkSequenceSet evaluateNode(int node, quint16 k, const FlatSyntax&, const FirstKMap& currentMap,
+                                       const FirstKMap* shorter = 0);
+    static void calculateAllFirstK(quint16 k, EbnfSyntax* syn, FirstKTrieMap& outFirstK, LlkTrie&,
+                                   const FirstKTrieMap* shorter = 0, FixpointSolver::Stats* = 0);
+    static LlkTrie::Ref evaluateNode(int node, quint16 k, const FlatSyntax&, const FirstKTrieMap& currentMap, LlkTrie&,
+                                     const FirstKTrieMap* shorter = 0 );
+    static void collectAllNodes(const FlatSyntax&, QVector<int>& );
+    static void addFirstKDependencies(const QVector<int>&, const FlatSyntax&, FixpointSolver& );
     static LlkSequenceSet concatK(const LlkSequenceSet& left, const LlkSequenceSet& right, quint16 k);
-    static LlkSequenceSet computeFollowK(quint16 k, Ast::Node* seq, int fromIdx,
-                                          const Ast::NodeRefSet& upperFollow,
-                                          EbnfSyntax* syn);
+    static LlkSequenceSet concatK(const LlkSequenceSet& left, const LlkSequenceSet& right,
+                                  const LlkSequenceSet& rightShorter, quint16 k);
+    static LlkSequenceSet computeFollowK(quint16 k, int from, int end, const Ast::NodeRefSet& upperFollow,
+                                          FirstKCache* cache);
 
     static QSet<QString> collectAllTerminalStrings( Ast::Node* );
-    static void findAmbiguousAlternatives( Ast::Node*, FirstFollowSet*, EbnfErrors* );
-    static void findAmbiguousOptionals( Ast::Node*, FirstFollowSet*, EbnfErrors* );
-    static void reportAmbig(Ast::Node* seq, int ambigIdx, const Ast::NodeRefSet& diff,
+    static void checkForAmbiguityImp( int node, FirstFollowSet*, EbnfErrors*, bool recursive, FirstKCache* );
+    static void findAmbiguousAlternatives( int node, FirstFollowSet*, EbnfErrors*, FirstKCache* );
+    static void findAmbiguousOptionals( int seq, FirstFollowSet*, EbnfErrors*, FirstKCache* );
+    static bool optionalIsAmbiguous( int seq, int opt, quint16 k, FirstKCache* );
+    static void reportAmbig( int seq, int ambig, const Ast::NodeRefSet& diff,
                             const Ast::NodeSet& ambigSet2, FirstFollowSet*, EbnfErrors* );
     static bool findPathImp( Ast::ConstNodeList& path, const Ast::Node* to );
     static int getMaxLaIndex( const Ast::Node* pred );
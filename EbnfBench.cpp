@@ -0,0 +1,325 @@
+/*
+* Copyright 2026 Rochus Keller <mailto:me@rochus-keller.ch>
+*
+* This file is part of the EbnfStudio application.
+*
+* The following is the license that applies to this copy of the
+* application. For a license to use the application under conditions
+* other than those described here, please email to me@rochus-keller.ch.
+*
+* GNU General Public License Usage
+* This file may be used under the terms of the GNU General Public
+* License (GPL) versions 2.0 or 3.0 as published by the Free Software
+* Foundation and appearing in the file LICENSE.GPL included in
+* the packaging of this file. Please review the following information
+* to ensure GNU General Public Licensing requirements will be met:
+* http://www.fsf.org/licensing/licenses/info/GPLv2.html and
+* http://www.gnu.org/copyleft/gpl.html.
+*/
+
+// ebnfbench runs the phases of ebnfc repeatedly over a corpus of grammars and reports the median
+// and 95th percentile per phase; the medians can be saved as a baseline and later runs fail if a
+// phase got slower than the baseline by more than a threshold.
+
+#include "CppGen.h"
+#include "EbnfAnalyzer.h"
+#include "EbnfAnalyzer2.h"
+#include "EbnfErrors.h"
+#include "EbnfLexer.h"
+#include "EbnfParser.h"
+#include "EbnfVersion.h"
+#include "FirstFollowSet.h"
+#include "PhaseStats.h"
+#include "ToolUtils.h"
+#include <QCoreApplication>
+#include <QFileInfo>
+#include <QDir>
+#include <QFile>
+#include <QHash>
+#include <QSet>
+#include <QtDebug>
+#include <QTextStream>
+#include <algorithm>
+
+struct BenchOptions
+{
+    int d_repeat;
+    int d_warmup;
+    int d_threads; // of the exact analyzer
+    bool d_useTries;
+    QSet<QByteArray> d_skip; // phases
+    double d_threshold; // percent
+    double d_minMs; // smaller differences are noise
+    QString d_baseline;
+    QString d_saveBaseline;
+    BenchOptions():d_repeat(5),d_warmup(1),d_threads(1),d_useTries(false),d_threshold(10.0),d_minMs(1.0){}
+};
+
+// in execution order; lex to follow always run because the later phases depend on them
+static const char* s_phases[] = { "lex", "parse", "finishSyntax", "first", "follow",
+                                  "approximate", "exact", "CppGen", 0 };
+
+// one repetition of all phases on a fresh syntax; false if the grammar cannot be analyzed
+static bool runOnce( const QString& path, const BenchOptions& o, PhaseStats& stats )
+{
+    QFile file(path);
+    if( !file.open(QIODevice::ReadOnly ) )
+        return false;
+    EbnfErrors errs;
+    errs.setBuffered(true);
+    EbnfLexer lex;
+    QFileInfo info(path);
+    lex.readKeywordsFromFile( info.absoluteDir().absoluteFilePath( info.completeBaseName() + ".keywords" ) );
+
+    stats.startSeparate("lex");
+    ToolUtils::lexOnly( path, lex.getKeywords() );
+    stats.start("parse");
+    EbnfParser p;
+    p.setErrors(&errs);
+    lex.setStream( &file );
+    const bool parsed = p.parse( &lex );
+    stats.stop();
+    if( !parsed )
+        return false;
+
+    EbnfSyntaxRef syn(p.getSyntax());
+    stats.start("finishSyntax");
+    const bool finished = syn->finishSyntax();
+    stats.stop();
+    if( !finished )
+        return false;
+
+    FirstFollowSet tbl;
+    tbl.setSyntax(syn.data());
+    stats.addTime("first", tbl.getFirstTime());
+    stats.addTime("follow", tbl.getFollowTime());
+
+    FirstKCache firstK(syn.data(), o.d_useTries ? FirstKCache::Tries : FirstKCache::SequenceSets);
+    if( !o.d_skip.contains("approximate") )
+    {
+        stats.start("approximate");
+        EbnfAnalyzer::checkForAmbiguity( &tbl, &errs );
+        stats.stop();
+    }
+    if( !o.d_skip.contains("exact") )
+    {
+        stats.start("exact");
+        EbnfAnalyzer2::checkForAmbiguity( &tbl, &errs, &firstK, o.d_threads );
+        stats.stop();
+    }
+    if( !o.d_skip.contains("CppGen") )
+    {
+        // the generated files go to the temp directory, not next to the grammar
+        stats.start("CppGen");
+        CppGen gen;
+        gen.d_firstK = &firstK;
+        gen.generate( QDir( QDir::tempPath() ).absoluteFilePath( info.fileName() ), syn.data(), &tbl );
+        stats.stop();
+    }
+    return true;
+}
+
+struct PhaseResult
+{
+    QByteArray d_phase;
+    qint64 d_median; // nanoseconds
+    qint64 d_p95;
+    qint64 d_min;
+};
+
+static PhaseResult summarize( const QByteArray& phase, QList<qint64> samples )
+{
+    std::sort( samples.begin(), samples.end() );
+    const int n = samples.size();
+    PhaseResult r;
+    r.d_phase = phase;
+    r.d_median = ( n % 2 ) ? samples[n/2] : ( samples[n/2-1] + samples[n/2] ) / 2;
+    r.d_p95 = samples[ qMax( 0, int( ( n * 95 + 99 ) / 100 ) - 1 ) ]; // nearest rank
+    r.d_min = samples.first();
+    return r;
+}
+
+static bool benchGrammar( const QString& path, const BenchOptions& o, QList<PhaseResult>& out )
+{
+    QHash<QByteArray, QList<qint64> > samples;
+    for( int i = 0; i < o.d_warmup + o.d_repeat; i++ )
+    {
+        PhaseStats stats;
+        if( !runOnce( path, o, stats ) )
+            return false;
+        if( i < o.d_warmup )
+            continue;
+        for( int p = 0; s_phases[p] != 0; p++ )
+            samples[s_phases[p]].append( stats.getTime( s_phases[p] ) );
+    }
+    for( int p = 0; s_phases[p] != 0; p++ )
+    {
+        if( !o.d_skip.contains( s_phases[p] ) )
+            out.append( summarize( s_phases[p], samples.value( s_phases[p] ) ) );
+    }
+    return true;
+}
+
+// one line per grammar and phase: "<grammar>\t<phase>\t<median ns>"; '#' starts a comment
+static bool readBaseline( const QString& path, QHash<QByteArray,qint64>& baseline )
+{
+    QFile in(path);
+    if( !in.open(QIODevice::ReadOnly) )
+        return false;
+    while( !in.atEnd() )
+    {
+        const QByteArray line = in.readLine().trimmed();
+        if( line.isEmpty() || line.startsWith('#') )
+            continue;
+        const QList<QByteArray> parts = line.split('\t');
+        if( parts.size() != 3 )
+            continue;
+        baseline[ parts[0] + '\t' + parts[1] ] = parts[2].toLongLong();
+    }
+    return true;
+}
+
+static QByteArray toMs( qint64 nsecs )
+{
+    return QString::number( nsecs / 1000000.0, 'f', 3 ).toUtf8();
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+    a.setOrganizationName("Rochus Keller");
+    a.setOrganizationDomain("github.com/rochus-keller/EbnfStudio");
+    a.setApplicationName("ebnfbench");
+    a.setApplicationVersion(EBNF_VERSION);
+
+    QStringList paths;
+    BenchOptions o;
+    QStringList args = a.arguments();
+    for( int i = 1; i < args.size(); i++ )
+    {
+        QString arg = args[ i ];
+        if( ( arg == "-r" || arg == "--repeat" ) && i + 1 < args.size() )
+        {
+            o.d_repeat = qMax( 1, args[ ++i ].toInt() );
+        }else if( ( arg == "-w" || arg == "--warmup" ) && i + 1 < args.size() )
+        {
+            o.d_warmup = qMax( 0, args[ ++i ].toInt() );
+        }else if( ( arg == "-j" || arg == "--jobs" ) && i + 1 < args.size() )
+        {
+            o.d_threads = qMax( 1, args[ ++i ].toInt() );
+        }else if( arg == "-t" || arg == "--trie" )
+        {
+            o.d_useTries = true;
+        }else if( arg == "--skip" && i + 1 < args.size() )
+        {
+            foreach( const QString& phase, args[ ++i ].split(',') )
+                o.d_skip << phase.trimmed().toUtf8();
+        }else if( arg == "--baseline" && i + 1 < args.size() )
+        {
+            o.d_baseline = args[ ++i ];
+        }else if( arg == "--save-baseline" && i + 1 < args.size() )
+        {
+            o.d_saveBaseline = args[ ++i ];
+        }else if( arg == "--threshold" && i + 1 < args.size() )
+        {
+            o.d_threshold = args[ ++i ].toDouble();
+        }else if( arg == "--min-ms" && i + 1 < args.size() )
+        {
+            o.d_minMs = args[ ++i ].toDouble();
+        }else if( arg[ 0 ] != '-' )
+        {
+            ToolUtils::addGrammars( arg, paths );
+        }
+    }
+
+    if( paths.isEmpty() )
+    {
+        qCritical() << "expecting EBNF file paths";
+        qCritical() << "usage: ebnfbench [options] <file.ebnf | directory>...";
+        qCritical() << "  -r, --repeat N          measured repetitions per grammar (default 5)";
+        qCritical() << "  -w, --warmup N          unmeasured repetitions before (default 1)";
+        qCritical() << "  -j, --jobs N            threads of the exact analyzer (default 1)";
+        qCritical() << "  -t, --trie              keep the exact First_k sets as shared tries";
+        qCritical() << "      --skip LIST         don't run the comma separated phases approximate, exact, CppGen";
+        qCritical() << "      --save-baseline FILE  write the medians to FILE";
+        qCritical() << "      --baseline FILE     compare the medians with FILE and fail on regressions";
+        qCritical() << "      --threshold PCT     tolerated slowdown in percent (default 10)";
+        qCritical() << "      --min-ms MS         tolerated slowdown in milliseconds (default 1)";
+        return 1;
+    }
+
+    QHash<QByteArray,qint64> baseline;
+    if( !o.d_baseline.isEmpty() && !readBaseline( o.d_baseline, baseline ) )
+    {
+        qCritical() << "cannot read baseline" << o.d_baseline;
+        return 1;
+    }
+
+    int width = QByteArray("grammar").size();
+    foreach( const QString& path, paths )
+        width = qMax( width, QFileInfo(path).fileName().size() );
+
+    QTextStream out(stdout);
+    out << QString("%1 %2 %3 %4 %5").arg("grammar",-width).arg("phase",-12).arg("median ms",10).
+           arg("p95 ms",10).arg("min ms",10);
+    if( !o.d_baseline.isEmpty() )
+        out << QString(" %1 %2").arg("base ms",10).arg("change",8);
+    out << "\n";
+
+    // grammars are identified by their file name, so the baseline doesn't depend on the location
+    QByteArray saved = "# ebnfbench baseline: grammar, phase, median ns\n";
+    int res = 0, regressions = 0;
+    foreach( const QString& path, paths )
+    {
+        const QByteArray name = QFileInfo(path).fileName().toUtf8();
+        QList<PhaseResult> results;
+        if( !benchGrammar( path, o, results ) )
+        {
+            out << QString("%1 failed").arg(QString::fromUtf8(name),-width) << "\n";
+            res = 1;
+            continue;
+        }
+        foreach( const PhaseResult& r, results )
+        {
+            out << QString("%1 %2 %3 %4 %5").arg(QString::fromUtf8(name),-width).arg(QString::fromUtf8(r.d_phase),-12).
+                   arg(QString::fromUtf8(toMs(r.d_median)),10).arg(QString::fromUtf8(toMs(r.d_p95)),10).
+                   arg(QString::fromUtf8(toMs(r.d_min)),10);
+            saved += name + '\t' + r.d_phase + '\t' + QByteArray::number( r.d_median ) + '\n';
+            const QByteArray key = name + '\t' + r.d_phase;
+            if( !o.d_baseline.isEmpty() && baseline.contains( key ) )
+            {
+                const qint64 base = baseline.value( key );
+                const double change = base > 0 ? ( r.d_median - base ) * 100.0 / base : 0.0;
+                out << QString(" %1 %2%").arg(QString::fromUtf8(toMs(base)),10).
+                       arg(QString::number(change,'f',1),7);
+                if( r.d_median > base * ( 1.0 + o.d_threshold / 100.0 ) &&
+                        ( r.d_median - base ) >= o.d_minMs * 1000000.0 )
+                {
+                    out << " REGRESSION";
+                    regressions++;
+                }
+            }else if( !o.d_baseline.isEmpty() )
+                out << QString(" %1").arg("new",10);
+            out << "\n";
+        }
+        out.flush();
+    }
+
+    if( !o.d_saveBaseline.isEmpty() )
+    {
+        QFile f( o.d_saveBaseline );
+        if( !f.open(QIODevice::WriteOnly) )
+        {
+            qCritical() << "cannot write baseline" << o.d_saveBaseline;
+            return 1;
+        }
+        f.write( saved );
+    }
+    if( regressions )
+    {
+        out << regressions << " phases slower than the baseline by more than " << o.d_threshold << "% and "
+            << o.d_minMs << " ms\n";
+        res = 1;
+    }
+    return res;
+}
@@ -0,0 +1,74 @@
+QT       += core
+QT       -= gui
+
+TARGET = ebnfbench
+CONFIG   += console
+CONFIG   -= app_bundle
+
+TEMPLATE = app
+
+INCLUDEPATH += ..
+
+CONFIG(debug, debug|release) {
+    DEFINES += _DEBUG
+}
+
+
+
+!win32 {
+    QMAKE_CXXFLAGS += -Wno-reorder -Wno-unused-parameter -Wno-unused-function -Wno-unused-variable -Wno-switch \
+        -Wno-deprecated-declarations -Wno-sign-compare -Wno-parentheses -Wno-unused-parameter -Werror=return-type
+}
+
+win32: LIBS += -lpsapi # GetProcessMemoryInfo in PhaseStats
+
+SOURCES += \
+    CppGen.cpp \
+    EbnfAnalyzer.cpp \
+    EbnfAnalyzer2.cpp \
+    LlkTrie.cpp \
+    FixpointSolver.cpp \
+    PhaseStats.cpp \
+    SccGraph.cpp \
+    Tracer.cpp \
+    ToolUtils.cpp \
+    TermSet.cpp \
+    AstArena.cpp \
+    FlatSyntax.cpp \
+    SymbolTable.cpp \
+    EbnfBench.cpp \
+    EbnfErrors.cpp \
+    EbnfLexer.cpp \
+    EbnfParser.cpp \
+    EbnfSyntax.cpp \
+    EbnfToken.cpp \
+    FirstFollowSet.cpp \
+    GenUtils.cpp \
+    LaParser.cpp
+
+HEADERS += \
+    CppGen.h \
+    EbnfAnalyzer.h \
+    EbnfAnalyzer2.h \
+    LlkTrie.h \
+    FixpointSolver.h \
+    PhaseStats.h \
+    SccGraph.h \
+    Tracer.h \
+    ToolUtils.h \
+    TermSet.h \
+    AstArena.h \
+    FlatSyntax.h \
+    SymbolTable.h \
+    EbnfErrors.h \
+    EbnfLexer.h \
+    EbnfParser.h \
+    EbnfSyntax.h \
+    EbnfToken.h \
+    EbnfVersion.h \
+    FirstFollowSet.h \
+    GenUtils.h \
+    LaParser.h
+
+
+
@@ -26,21 +26,322 @@
 #include "EbnfToken.h"
 #include "EbnfVersion.h"
 #include "FirstFollowSet.h"
+#include "PhaseStats.h"
+#include "ToolUtils.h"
+#include "Tracer.h"
 #include <QCoreApplication>
 #include <QFileInfo>
 #include <QDir>
 #include <QtDebug>
 #include <QElapsedTimer>
+#include <QThreadPool>
+#include <QRunnable>
+#include <QThread>
+#include <QTextStream>
 
-static void printErrors( const EbnfErrors& errs )
+struct Options
 {
-    foreach( const EbnfErrors::Entry& e, errs.getErrors())
+    bool d_useAnalyzer2;
+    bool d_compareBoth;
+    bool d_doGenerate;
+    bool d_useTries;
+    int d_threads; // per grammar
+    enum Stats { NoStats, TextStats, JsonStats } d_stats;
+    Options():d_useAnalyzer2(false),d_compareBoth(false),d_doGenerate(false),d_useTries(false),d_threads(1),
+        d_stats(NoStats){}
+};
+
+static void printErrors( const EbnfErrors& errs, const QString& path = QString() )
+{
+    // in batch mode each line starts with the grammar
+    const QByteArray prefix = path.toUtf8();
+    foreach( const EbnfErrors::Entry& e, errs.getSorted() )
     {
         if( e.d_isErr )
-            qCritical() << "ERR" << e.d_line << ":" << e.d_col << ":" << e.d_msg.toUtf8().constData();
-        else
-            qWarning() << "WRN" << e.d_line << ":" << e.d_col << ":" << e.d_msg.toUtf8().constData();
+        {
+            if( prefix.isEmpty() )
+                qCritical() << "ERR" << e.d_line << ":" << e.d_col << ":" << e.d_msg.toString().toUtf8().constData();
+            else
+                qCritical() << prefix.constData() << "ERR" << e.d_line << ":" << e.d_col << ":" <<
+                               e.d_msg.toString().toUtf8().constData();
+        }else
+        {
+            if( prefix.isEmpty() )
+                qWarning() << "WRN" << e.d_line << ":" << e.d_col << ":" << e.d_msg.toString().toUtf8().constData();
+            else
+                qWarning() << prefix.constData() << "WRN" << e.d_line << ":" << e.d_col << ":" <<
+                              e.d_msg.toString().toUtf8().constData();
+        }
+    }
+}
+
+static void printStats(const char* what, const FixpointSolver::Stats& s)
+{
+    qDebug() << "   " << what << s.d_updates << "updates of" << s.d_vars << "variables in"
+             << s.d_components << "components";
+}
+
+static void addCounters( PhaseStats* stats, EbnfSyntax* syn, FirstFollowSet* tbl, FirstKCache* firstK )
+{
+    const FlatSyntax* f = tbl->getFlat();
+    stats->addCounter( "productions", f ? f->getDefCount() : 0 );
+    stats->addCounter( "nodes", f ? f->getNodeCount() : 0 );
+    stats->addCounter( "terminals", syn->getTerminalCount() );
+    stats->addFixpoint( "first", tbl->getFirstStats() );
+    stats->addFixpoint( "follow", tbl->getFollowStats() );
+    qint64 first = 0, follow = 0;
+    for( int id = 0; f && id < f->getNodeCount(); id++ )
+    {
+        first += tbl->getFirstBits(id).count();
+        follow += tbl->getFollowBits(id).count();
     }
+    stats->addCounter( "first.entries", first );
+    stats->addCounter( "follow.entries", follow );
+    stats->addFixpoint( "firstK", firstK->getStats() );
+    foreach( quint16 k, firstK->getCalculatedK() )
+        stats->addCounter( "firstK.sequences.k" + QByteArray::number(k), firstK->getSequenceCount(k) );
+}
+
+// parses, analyzes and optionally generates one grammar; the issues go to errs, which the caller
+// prints; the comparison prints its own results and leaves errs empty. Returns the exit status.
+static int checkGrammar( const QString& path, const Options& o, EbnfErrors& errs, PhaseStats* stats = 0 )
+{
+    TraceSpan span("checkGrammar");
+    if( span.isActive() )
+        span.addArg("grammar", path.toUtf8());
+    QFile file(path);
+    if( !file.open(QIODevice::ReadOnly ) )
+    {
+        errs.error( EbnfErrors::Syntax, 0, 0, EbnfErrors::Msg("cannot open file") );
+        return 1;
+    }
+
+    EbnfLexer lex;
+    QFileInfo info(path);
+    lex.readKeywordsFromFile( info.absoluteDir().absoluteFilePath( info.completeBaseName() + ".keywords" ) );
+
+    if( stats )
+    {
+        // the parser pulls the tokens, so the lexer is timed by a separate pass
+        stats->startSeparate("lex");
+        ToolUtils::lexOnly( path, lex.getKeywords() );
+        stats->start("parse");
+    }
+    EbnfParser p;
+    p.setErrors(&errs);
+    lex.setStream( &file );
+    bool parsed;
+    {
+        TraceSpan parse("parse");
+        parsed = p.parse( &lex );
+    }
+    if( stats )
+        stats->stop();
+    if( !parsed )
+        return 1;
+
+    EbnfSyntaxRef syn(p.getSyntax());
+    if( stats )
+        stats->start("finishSyntax");
+    const bool finished = syn->finishSyntax();
+    if( stats )
+        stats->stop();
+    if( !finished )
+        return 1;
+
+    FirstFollowSet tbl;
+    tbl.setSyntax(syn.data());
+    if( stats )
+    {
+        stats->addTime("first", tbl.getFirstTime());
+        stats->addTime("follow", tbl.getFollowTime());
+    }
+    // shared by the exact analyzer and the generator
+    FirstKCache firstK(syn.data(), o.d_useTries ? FirstKCache::Tries : FirstKCache::SequenceSets);
+
+    if( o.d_compareBoth )
+    {
+        errs.clear(); // as before, only the results of the two analyzers are printed
+        EbnfErrors errs1;
+        EbnfErrors errs2;
+        QElapsedTimer t;
+
+        qDebug() << "*** Running original EbnfAnalyzer:";
+        t.start();
+        EbnfAnalyzer::checkForAmbiguity( &tbl, &errs1 );
+        qDebug() << "   " << t.elapsed() << "ms";
+
+        qDebug() << "*** Running exact EbnfAnalyzer2:";
+        t.start();
+        EbnfAnalyzer2::checkForAmbiguity( &tbl, &errs2, &firstK, o.d_threads );
+        qDebug() << "   " << t.elapsed() << "ms";
+
+        qDebug() << "";
+        qDebug() << "*** EbnfAnalyzer results:" << errs1.getCount() << "issues";
+        printErrors(errs1);
+
+        qDebug() << "";
+        qDebug() << "*** EbnfAnalyzer2 results:" << errs2.getCount() << "issues";
+        printErrors(errs2);
+
+        qDebug() << "";
+        qDebug() << "*** Fixpoint iterations:";
+        printStats("First:  ", tbl.getFirstStats());
+        printStats("Follow: ", tbl.getFollowStats());
+        printStats("First_k:", firstK.getStats());
+
+        qDebug() << "";
+        if( errs1.getCount() != errs2.getCount() )
+        {
+            qDebug() << "*** Difference detected:"
+                     << errs1.getCount() << "vs" << errs2.getCount() << "issues ***";
+        }else
+            qDebug() << "*** Both analyzers report the same number of issues.";
+
+        return ( errs1.isEmpty() && errs2.isEmpty() ) ? 0 : 1;
+    }
+
+    if( stats )
+        stats->start("ambiguity");
+    if( o.d_useAnalyzer2 )
+        EbnfAnalyzer2::checkForAmbiguity( &tbl, &errs, &firstK, o.d_threads );
+    else
+        EbnfAnalyzer::checkForAmbiguity( &tbl, &errs );
+
+    if( o.d_doGenerate )
+    {
+        if( stats )
+            stats->start("CppGen");
+        CppGen gen;
+        gen.d_exact = o.d_useAnalyzer2;
+        gen.d_firstK = &firstK;
+        gen.generate(path, syn.data(), &tbl);
+    }
+    if( stats )
+    {
+        stats->stop();
+        addCounters( stats, syn.data(), &tbl, &firstK );
+    }
+
+    return errs.isEmpty() ? 0 : 1;
+}
+
+struct GrammarResult
+{
+    QList<EbnfErrors::Entry> d_issues; // in report order
+    PhaseStats d_stats;
+    int d_status;
+    qint64 d_ms;
+    GrammarResult():d_status(0),d_ms(0){}
+};
+
+class GrammarWorker : public QRunnable
+{
+public:
+    // like EbnfAnalyzer2::AmbiguityWorker all workers pull the next grammar from a shared cursor;
+    // each grammar has its own lexer, symbol table, syntax and error sink
+    const QStringList& d_paths;
+    const Options& d_options;
+    QAtomicInt* d_next;
+    GrammarResult* d_results; // one slot per grammar
+    GrammarWorker(const QStringList& paths, const Options& o, QAtomicInt* next, GrammarResult* results):
+        d_paths(paths),d_options(o),d_next(next),d_results(results){}
+    void run()
+    {
+        int i;
+        while( ( i = d_next->fetchAndAddOrdered(1) ) < d_paths.size() )
+        {
+            GrammarResult& r = d_results[i];
+            EbnfErrors errs;
+            errs.setBuffered(true);
+            QElapsedTimer t;
+            t.start();
+            try
+            {
+                r.d_stats = PhaseStats( d_paths[i].toUtf8() );
+                r.d_status = checkGrammar( d_paths[i], d_options, errs,
+                                           d_options.d_stats != Options::NoStats ? &r.d_stats : 0 );
+            }catch(...)
+            {
+                qCritical() << "ebnfc exception checking" << d_paths[i];
+                r.d_status = 1;
+            }
+            r.d_ms = t.elapsed();
+            r.d_issues = errs.getBuffer();
+        }
+    }
+};
+
+static QByteArray formatRow( const QString& name, int width, int errs, int warns, qint64 ms, int status )
+{
+    return QString("%1 %2 %3 %4 %5").arg(name,-width).arg(errs,6).arg(warns,8).arg(ms,8).arg(status,6).toUtf8();
+}
+
+static int checkGrammars( const QStringList& paths, const Options& o )
+{
+    QVector<GrammarResult> results(paths.size());
+    QElapsedTimer total;
+    total.start();
+    QAtomicInt next(0);
+    QThreadPool pool;
+    const int threads = qMin( QThread::idealThreadCount(), paths.size() );
+    pool.setMaxThreadCount(threads);
+    for( int t = 0; t < threads; t++ )
+        pool.start( new GrammarWorker(paths, o, &next, results.data()) );
+    pool.waitForDone();
+    const qint64 ms = total.elapsed();
+
+    // report in the order of the arguments, so the output doesn't depend on the scheduling
+    QList<int> errCounts;
+    for( int i = 0; i < paths.size(); i++ )
+    {
+        EbnfErrors errs;
+        errs.setBuffered(true);
+        foreach( const EbnfErrors::Entry& e, results[i].d_issues )
+            errs.add(e);
+        printErrors( errs, paths[i] );
+        errCounts.append( errs.getErrCount() );
+        results[i].d_issues = errs.getBuffer(); // without duplicates
+    }
+
+    int width = QByteArray("grammar").size();
+    foreach( const QString& path, paths )
+        width = qMax( width, path.size() );
+    int res = 0, errors = 0, warnings = 0;
+    qDebug() << QString("%1 %2 %3 %4 %5").arg("grammar",-width).arg("errors",6).arg("warnings",8).
+                arg("ms",8).arg("status",6).toUtf8().constData();
+    for( int i = 0; i < paths.size(); i++ )
+    {
+        const GrammarResult& r = results[i];
+        const int warns = r.d_issues.size() - errCounts[i];
+        qDebug() << formatRow( paths[i], width, errCounts[i], warns, r.d_ms, r.d_status ).constData();
+        errors += errCounts[i];
+        warnings += warns;
+        if( r.d_status != 0 )
+            res = 1;
+    }
+    qDebug() << formatRow( QString("%1 grammars").arg(paths.size()), width, errors, warnings, ms, res ).constData();
+
+    if( o.d_stats != Options::NoStats )
+    {
+        // the peak memory is the one of the process, so it is only reported for the whole batch
+        const qint64 peak = PhaseStats::getPeakMemory();
+        QTextStream out(stdout);
+        if( o.d_stats == Options::JsonStats )
+            out << "{\"grammars\":[";
+        for( int i = 0; i < paths.size(); i++ )
+        {
+            if( o.d_stats == Options::JsonStats )
+                out << ( i == 0 ? "" : ",\n" ) << results[i].d_stats.toJson();
+            else
+                out << results[i].d_stats.toText();
+        }
+        if( o.d_stats == Options::JsonStats )
+            out << "],\"peakMemoryKB\":" << peak << "}\n";
+        else if( peak > 0 )
+            out << "peak memory " << peak << " KB\n";
+    }
+    return res;
 }
 
 int main(int argc, char *argv[])
@@ -52,127 +353,92 @@ int main(int argc, char *argv[])
     a.setApplicationVersion(EBNF_VERSION);
 
 
-    QString path;
-    bool useAnalyzer2 = false;
-    bool compareBoth = false;
-    bool doGenerate = false;
+    QStringList paths;
+    Options o;
+    QString tracePath;
     QStringList args = a.arguments();
     for( int i = 1; i < args.size(); i++ ) // arg 0 enthält Anwendungspfad
     {
         QString arg = args[ i ];
         if( arg == "-e" || arg == "--exact" )
         {
-            useAnalyzer2 = true;
+            o.d_useAnalyzer2 = true;
         }else if( arg == "-cmp" || arg == "--compare" )
         {
-            compareBoth = true;
+            o.d_compareBoth = true;
         }else if( arg == "-gen" || arg == "--generate" )
         {
-            doGenerate = true;
+            o.d_doGenerate = true;
+        }else if( arg == "-t" || arg == "--trie" )
+        {
+            o.d_useTries = true;
+        }else if( arg == "--stats" )
+        {
+            o.d_stats = Options::TextStats;
+        }else if( arg == "--stats=json" )
+        {
+            o.d_stats = Options::JsonStats;
+        }else if( arg == "--trace" && i + 1 < args.size() )
+        {
+            tracePath = args[ ++i ];
+        }else if( ( arg == "-j" || arg == "--jobs" ) && i + 1 < args.size() )
+        {
+            o.d_threads = qMax( 1, args[ ++i ].toInt() );
         }else if( arg[ 0 ] != '-' )
         {
-            QFileInfo info( arg );
-            const QByteArray suffix = info.suffix().toLower().toUtf8();
-
-            if( suffix == "ebnf" )
-            {
-                path = arg;
-            }
+            ToolUtils::addGrammars( arg, paths );
         }
     }
 
-    if( path.isEmpty() )
+    if( paths.isEmpty() || ( o.d_compareBoth && paths.size() > 1 ) )
     {
         qCritical() << "expecting an EBNF file path";
-        qCritical() << "usage: ebnfc [options] <file.ebnf>";
+        qCritical() << "usage: ebnfc [options] <file.ebnf | directory>...";
         qCritical() << "  -e,   --exact      use the exact LL(k) analyzer (EbnfAnalyzer2)";
-        qCritical() << "  -cmp, --compare    run both analyzers and compare results";
+        qCritical() << "  -cmp, --compare    run both analyzers and compare results (one grammar only)";
         qCritical() << "  -gen, --generate   generate C++ parser code (uses exact sequences with -e)";
+        qCritical() << "  -t,   --trie       keep the exact First_k sets as shared tries";
+        qCritical() << "  -j,   --jobs N     check the definitions with N threads (exact analyzer)";
+        qCritical() << "        --stats      print the time of each phase and the analysis counters";
+        qCritical() << "        --stats=json the same as JSON on stdout";
+        qCritical() << "        --trace FILE write the analyzer and generator spans as Chrome trace events";
+        qCritical() << "with more than one grammar they are checked concurrently on all cores and";
+        qCritical() << "a summary of the issues, timings and exit status per grammar is printed";
         return 1;
     }
 
-    EbnfErrors errs;
-
-    QFile file(path);
-    if( !file.open(QIODevice::ReadOnly ) )
-        return false;
-
-    EbnfToken::resetSymTbl();
-
-    EbnfLexer lex;
-    QFileInfo info(path);
-    lex.readKeywordsFromFile( info.absoluteDir().absoluteFilePath( info.completeBaseName() + ".keywords" ) );
+    Tracer tracer;
+    if( !tracePath.isEmpty() )
+        tracer.activate();
 
-    EbnfParser p;
-    p.setErrors(&errs);
-    lex.setStream( &file );
-    if( !p.parse( &lex ) )
+    int res;
+    if( paths.size() > 1 )
+        res = checkGrammars( paths, o );
+    else
     {
+        EbnfErrors errs;
+        PhaseStats stats( paths.first().toUtf8() );
+        res = checkGrammar( paths.first(), o, errs, o.d_stats != Options::NoStats ? &stats : 0 );
+        stats.setPeakMemory();
         printErrors(errs);
-        return 1;
-    }else
-    {
-        EbnfSyntaxRef syn(p.getSyntax());
-        if( !syn->finishSyntax() )
+        if( o.d_stats != Options::NoStats )
         {
-            printErrors(errs);
-            return 1;
-        }
-
-        FirstFollowSet tbl;
-        tbl.setSyntax(syn.data());
-
-        if( compareBoth )
-        {
-            EbnfErrors errs1;
-            EbnfErrors errs2;
-            QElapsedTimer t;
-
-            qDebug() << "*** Running original EbnfAnalyzer:";
-            t.start();
-            EbnfAnalyzer::checkForAmbiguity( &tbl, &errs1 );
-            qDebug() << "   " << t.elapsed() << "ms";
-
-            qDebug() << "*** Running exact EbnfAnalyzer2:";
-            t.start();
-            EbnfAnalyzer2::checkForAmbiguity( &tbl, &errs2 );
-            qDebug() << "   " << t.elapsed() << "ms";
-
-            qDebug() << "";
-            qDebug() << "*** EbnfAnalyzer results:" << errs1.getErrors().size() << "issues";
-            printErrors(errs1);
-
-            qDebug() << "";
-            qDebug() << "*** EbnfAnalyzer2 results:" << errs2.getErrors().size() << "issues";
-            printErrors(errs2);
-
-            qDebug() << "";
-            if( errs1.getErrors().size() != errs2.getErrors().size() )
-            {
-                qDebug() << "*** Difference detected:"
-                         << errs1.getErrors().size() << "vs" << errs2.getErrors().size() << "issues ***";
-            }else
-                qDebug() << "*** Both analyzers report the same number of issues.";
-
-            return ( errs1.getErrors().isEmpty() && errs2.getErrors().isEmpty() ) ? 0 : 1;
-        }else if( useAnalyzer2 )
-            EbnfAnalyzer2::checkForAmbiguity( &tbl, &errs );
-        else
-            EbnfAnalyzer::checkForAmbiguity( &tbl, &errs );
-
-        if( doGenerate )
-        {
-            CppGen gen;
-            gen.d_exact = useAnalyzer2;
-            gen.generate(path, syn.data(), &tbl);
+            QTextStream out(stdout);
+            if( o.d_stats == Options::JsonStats )
+                out << stats.toJson() << "\n";
+            else
+                out << stats.toText();
         }
+    }
 
-        if( !errs.getErrors().isEmpty() )
+    if( !tracePath.isEmpty() )
+    {
+        tracer.deactivate();
+        if( !tracer.write( tracePath ) )
         {
-            printErrors(errs);
+            qCritical() << "cannot write trace file" << tracePath;
             return 1;
         }
     }
-
-    return 0;
+    return res;
 }
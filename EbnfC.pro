@@ -20,10 +20,22 @@ CONFIG(debug, debug|release) {
         -Wno-deprecated-declarations -Wno-sign-compare -Wno-parentheses -Wno-unused-parameter -Werror=return-type
 }
 
+win32: LIBS += -lpsapi # GetProcessMemoryInfo in PhaseStats
+
 SOURCES += \
     CppGen.cpp \
     EbnfAnalyzer.cpp \
     EbnfAnalyzer2.cpp \
+    LlkTrie.cpp \
+    FixpointSolver.cpp \
+    PhaseStats.cpp \
+    SccGraph.cpp \
+    Tracer.cpp \
+    ToolUtils.cpp \
+    TermSet.cpp \
+    AstArena.cpp \
+    FlatSyntax.cpp \
+    SymbolTable.cpp \
     EbnfC.cpp \
     EbnfErrors.cpp \
     EbnfLexer.cpp \
@@ -38,6 +50,16 @@ HEADERS += \
     CppGen.h \
     EbnfAnalyzer.h \
     EbnfAnalyzer2.h \
+    LlkTrie.h \
+    FixpointSolver.h \
+    PhaseStats.h \
+    SccGraph.h \
+    Tracer.h \
+    ToolUtils.h \
+    TermSet.h \
+    AstArena.h \
+    FlatSyntax.h \
+    SymbolTable.h \
     EbnfErrors.h \
     EbnfLexer.h \
     EbnfParser.h \
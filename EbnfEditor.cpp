@@ -43,6 +43,9 @@ EbnfEditor::EbnfEditor(QWidget *parent) :
     CodeEditor(parent)
 {
     d_errs = new EbnfErrors(this);
+    d_service = new AnalysisService(this);
+    d_service->setErrs( d_errs );
+    connect( d_service, SIGNAL(sigFinished()), this, SLOT(onAnalysisDone()) );
     d_hl = new EbnfHighlighter( document() );
 	updateTabWidth();
 
@@ -107,13 +110,14 @@ void EbnfEditor::updateExtraSelections()
 
     sum << d_nonTerms;
 
-    if( !d_errs->getErrors().isEmpty() )
+    if( !d_errs->isEmpty() )
     {
         QTextCharFormat errorFormat;
         errorFormat.setUnderlineStyle(QTextCharFormat::WaveUnderline);
         errorFormat.setUnderlineColor(Qt::magenta);
+        const EbnfErrors::EntryList& errs = d_errs->getSorted();
         EbnfErrors::EntryList::const_iterator i;
-        for( i = d_errs->getErrors().begin(); i != d_errs->getErrors().end(); ++i )
+        for( i = errs.begin(); i != errs.end(); ++i )
         {
             QTextCursor c( document()->findBlockByNumber((*i).d_line - 1) );
 
@@ -123,7 +127,7 @@ void EbnfEditor::updateExtraSelections()
             QTextEdit::ExtraSelection sel;
             sel.format = errorFormat;
             sel.cursor = c;
-            sel.format.setToolTip((*i).d_msg);
+            sel.format.setToolTip((*i).d_msg.toString());
 
             sum << sel;
         }
@@ -202,47 +206,31 @@ void EbnfEditor::mouseMoveEvent(QMouseEvent* e)
 
 void EbnfEditor::onUpdateModel()
 {
-    parseText( toPlainText().toUtf8() );
+    // the current syntax stays valid until the worker publishes the new one
+    d_service->post( toPlainText().toUtf8(), d_origKeyWords );
 }
 
-void EbnfEditor::parseText(QByteArray ba)
+void EbnfEditor::analyze(AnalysisService::Mode mode, int threads)
 {
-    QBuffer buf(&ba);
-    buf.open(QIODevice::ReadOnly );
-    EbnfLexer l;
-    l.setKeywords( d_origKeyWords );
-    EbnfParser p;
-    p.setErrors(d_errs);
+    d_service->post( toPlainText().toUtf8(), d_origKeyWords, mode, threads );
+}
+
+void EbnfEditor::onAnalysisDone()
+{
+    const AnalysisService::Result& res = d_service->getResult();
+    d_errs->beginBatch();
     d_errs->clear();
+    foreach( const EbnfErrors::Entry& e, res.d_issues )
+        d_errs->add(e);
+    d_errs->endBatch();
     d_nonTerms.clear();
-    d_syn = 0;
-    l.setStream( &buf );
-    if( !p.parse( &l ) )
-    {
-        //qDebug() << "parsing" << d_path << "not successful," << d_errs->getErrCount() << "errors";
-        // qDebug() << p.getErrors();
-    }else
-    {
-        d_syn = p.getSyntax();
-        if( d_syn->finishSyntax() )
-        {
-            //qDebug() << "parsing" << d_path << "successful, no errors";
-        }else
-        {
-            //qDebug() << "parsing" << d_path << "not successful," << d_errs->getErrCount() << "errors";
-            // qDebug() << p.getSyntax()->getErrors();
-        }
-        if( l.getKeywords().size() != d_hl->getKeywords().size() )
-        {
-            d_hl->setKeywords( l.getKeywords() );
-            //d_rehighlightLock = true;
-            d_hl->rehighlight(); // triggert onTextChanged
-            //d_rehighlightLock = false;
-        }
-    }
+    d_syn = res.d_syn;
+    if( d_syn.constData() )
+        d_hl->updateKeywords( res.d_keywords ); // triggert onTextChanged
     emit sigSyntaxUpdated();
+    if( res.d_mode != AnalysisService::ParseOnly )
+        emit sigAnalyzed();
     updateExtraSelections();
-    //p.getSyntax()->dump();
 }
 
 bool EbnfEditor::loadFromFile(const QString &path)
@@ -250,7 +238,6 @@ bool EbnfEditor::loadFromFile(const QString &path)
     QFile file(path);
     if( !file.open(QIODevice::ReadOnly ) )
         return false;
-    EbnfToken::resetSymTbl();
     loadKeywords(path);
     setPlainText( QString::fromUtf8( file.readAll() ) );
     d_path = path;
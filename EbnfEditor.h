@@ -25,6 +25,7 @@
 #include <QTimer>
 #include <GuiTools/CodeEditor.h>
 #include "EbnfSyntax.h"
+#include "AnalysisService.h"
 
 // adaptiert aus AdaViewer::AdaEditor
 
@@ -43,6 +44,8 @@ public:
     bool saveToFile( const QString& path );
     EbnfSyntax* getSyntax() const { return d_syn.data(); }
     EbnfErrors* getErrs() const { return d_errs; }
+    void analyze( AnalysisService::Mode, int threads = 1 );
+    FirstFollowSet* takeAnalysisTable() { return d_service->takeTable(); }
 
     bool hasSelection() const;
     QString selectedText() const;
@@ -53,19 +56,23 @@ public:
 
 signals:
     void sigSyntaxUpdated();
+    void sigAnalyzed();
 
 public slots:
 
+protected slots:
+    void onAnalysisDone();
+
 protected:
     void mousePressEvent(QMouseEvent* e);
     void mouseMoveEvent(QMouseEvent* e);
     void onUpdateModel();
-    void parseText(QByteArray ba);
 private:
     EbnfHighlighter* d_hl;
     EbnfErrors* d_errs;
+    AnalysisService* d_service;
     EbnfSyntaxRef d_syn;
-    typedef QSet<EbnfToken::Sym> Keywords;
+    typedef QSet<QByteArray> Keywords;
     Keywords d_origKeyWords;
 };
 
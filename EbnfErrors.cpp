@@ -18,75 +18,213 @@
 */
 
 #include "EbnfErrors.h"
+#include <QReadWriteLock>
+#include <QHash>
+#include <QVector>
 #include <QtDebug>
+#include <algorithm>
+#include <string.h>
 
-EbnfErrors::EbnfErrors(QObject *parent) : QObject(parent),d_reportToConsole(false),d_errCounter(0)
+// The templates of all messages ever reported, looked up by content. Only literals are passed to
+// Msg(const char*), so the pool doesn't grow beyond the templates in the source.
+struct MsgPool
 {
-    d_eventLatency.setSingleShot(true);
-    connect(&d_eventLatency, SIGNAL(timeout()), this, SIGNAL(sigChanged()));
-}
-
-void EbnfErrors::error(EbnfErrors::Source src, int line, int col, const QString& msg, const QVariant& data)
-{
-    bool inserted = true;
-    if( true ) // d_record )
+    QReadWriteLock d_lock;
+    QHash<QByteArray,quint32> d_ids; // the keys are deep copies
+    QVector<QString> d_texts;
+    MsgPool()
+    {
+        d_texts.append( QString() ); // id 0 is no template
+    }
+    quint32 intern( const char* tmpl )
     {
-        Entry e;
-        e.d_col = col;
-        e.d_line = line;
-        e.d_msg = msg;
-        e.d_source = src;
-        e.d_isErr = true;
-        e.d_data = data;
-        const int count = d_errs.size();
-        d_errs.insert(e);
-        inserted = count != d_errs.size();
-        if( inserted )
+        if( tmpl == 0 || *tmpl == 0 )
+            return 0;
+        const QByteArray key = QByteArray::fromRawData( tmpl, int(::strlen(tmpl)) );
         {
-            notify();
-            d_errCounter++;
+            QReadLocker lock( &d_lock );
+            QHash<QByteArray,quint32>::const_iterator i = d_ids.find( key );
+            if( i != d_ids.end() )
+                return i.value();
         }
+        QWriteLocker lock( &d_lock );
+        QHash<QByteArray,quint32>::const_iterator i = d_ids.find( key );
+        if( i != d_ids.end() )
+            return i.value();
+        const quint32 id = d_texts.size();
+        d_texts.append( QString::fromUtf8( tmpl ) );
+        d_ids.insert( QByteArray( tmpl ), id );
+        return id;
     }
-    if( d_reportToConsole && inserted )
+    QString text( quint32 id )
     {
-        qCritical() << line << ":" << col << ": error:" << msg;
+        QReadLocker lock( &d_lock );
+        return d_texts.value( id );
     }
+};
+
+static MsgPool s_pool;
+
+EbnfErrors::Msg::Msg(const char* tmpl):d_argCount(0)
+{
+    d_tmpl = s_pool.intern( tmpl );
+}
+
+EbnfErrors::Msg::Msg(const QString& text):d_tmpl(0),d_argCount(0),d_text(text)
+{
+}
+
+EbnfErrors::Msg& EbnfErrors::Msg::arg(const QString& a)
+{
+    Q_ASSERT( d_tmpl != 0 && d_argCount < MaxArgs );
+    if( d_argCount < MaxArgs )
+        d_args[d_argCount++] = a;
+    return *this;
+}
+
+EbnfErrors::Msg& EbnfErrors::Msg::arg(int a)
+{
+    return arg( QString::number(a) );
 }
 
-void EbnfErrors::warning(EbnfErrors::Source src, int line, int col, const QString& msg, const QVariant& data)
+QString EbnfErrors::Msg::toString() const
 {
-    bool inserted = true;
-    if( true ) // d_showWarnings )
+    if( d_tmpl == 0 )
+        return d_text;
+    QString res = s_pool.text( d_tmpl );
+    for( int i = 0; i < d_argCount; i++ )
+        res = res.arg( d_args[i] );
+    return res;
+}
+
+bool EbnfErrors::Msg::operator==(const EbnfErrors::Msg& rhs) const
+{
+    if( d_tmpl != rhs.d_tmpl || d_argCount != rhs.d_argCount || d_text != rhs.d_text )
+        return false;
+    for( int i = 0; i < d_argCount; i++ )
     {
-        if( true ) // d_record )
-        {
-            Entry e;
-            e.d_col = col;
-            e.d_line = line;
-            e.d_msg = msg;
-            e.d_source = src;
-            e.d_isErr = false;
-            e.d_data = data;
-            const int count = d_errs.size();
-            d_errs.insert(e);
-            inserted = count != d_errs.size();
-            if( inserted )
-                notify();
-        }
-        if( d_reportToConsole && inserted )
-            qWarning() << line << ":" << col << ": warning:" << msg;
+        if( d_args[i] != rhs.d_args[i] )
+            return false;
     }
+    return true;
+}
+
+uint EbnfErrors::Msg::hash() const
+{
+    uint res = d_tmpl ? d_tmpl : qHash( d_text );
+    for( int i = 0; i < d_argCount; i++ )
+        res = res * 31 + qHash( d_args[i] );
+    return res;
+}
+
+EbnfErrors::EbnfErrors(QObject *parent) : QObject(parent),d_reportToConsole(false),d_errCounter(0),
+    d_buffered(false),d_batch(0),d_changed(false),d_sortedValid(true)
+{
+    d_eventLatency.setSingleShot(true);
+    connect(&d_eventLatency, SIGNAL(timeout()), this, SIGNAL(sigChanged()));
+}
+
+bool EbnfErrors::insert(const EbnfErrors::Entry& e)
+{
+    const int count = d_errs.size();
+    d_errs.insert(e);
+    if( count == d_errs.size() )
+        return false;
+    d_sortedValid = false;
+    if( d_buffered )
+        d_buffer.append(e);
+    else
+        notify();
+    return true;
+}
+
+void EbnfErrors::error(EbnfErrors::Source src, int line, int col, const Msg& msg, const QVariant& data)
+{
+    Entry e;
+    e.d_col = col;
+    e.d_line = line;
+    e.d_msg = msg;
+    e.d_source = src;
+    e.d_isErr = true;
+    e.d_data = data;
+    const bool inserted = insert(e);
+    if( inserted )
+        d_errCounter++;
+    if( d_reportToConsole && inserted )
+    {
+        qCritical() << line << ":" << col << ": error:" << msg.toString();
+    }
+}
+
+void EbnfErrors::warning(EbnfErrors::Source src, int line, int col, const Msg& msg, const QVariant& data)
+{
+    Entry e;
+    e.d_col = col;
+    e.d_line = line;
+    e.d_msg = msg;
+    e.d_source = src;
+    e.d_isErr = false;
+    e.d_data = data;
+    const bool inserted = insert(e);
+    if( d_reportToConsole && inserted )
+        qWarning() << line << ":" << col << ": warning:" << msg.toString();
+}
+
+void EbnfErrors::add(const EbnfErrors::Entry& e)
+{
+    if( e.d_isErr )
+        error( Source(e.d_source), e.d_line, e.d_col, e.d_msg, e.d_data );
+    else
+        warning( Source(e.d_source), e.d_line, e.d_col, e.d_msg, e.d_data );
 }
 
 void EbnfErrors::clear()
 {
     d_errs.clear();
+    d_sorted.clear();
+    d_sortedValid = true;
+    d_buffer.clear();
     d_errCounter = 0;
     notify();
 }
 
-void EbnfErrors::notify()
+void EbnfErrors::endBatch()
+{
+    Q_ASSERT( d_batch > 0 );
+    if( --d_batch == 0 && d_changed )
+    {
+        d_changed = false;
+        notify();
+    }
+}
+
+bool EbnfErrors::lessThan( const EbnfErrors::Entry& lhs, const EbnfErrors::Entry& rhs )
 {
-    d_eventLatency.start(400);
+    if( lhs < rhs )
+        return true;
+    if( rhs < lhs )
+        return false;
+    // the order of the set is arbitrary
+    if( lhs.d_isErr != rhs.d_isErr )
+        return lhs.d_isErr;
+    return lhs.d_msg.toString() < rhs.d_msg.toString();
 }
 
+const EbnfErrors::EntryList& EbnfErrors::getSorted() const
+{
+    if( !d_sortedValid )
+    {
+        d_sorted = d_errs.toList();
+        std::sort( d_sorted.begin(), d_sorted.end(), lessThan );
+        d_sortedValid = true;
+    }
+    return d_sorted;
+}
+
+void EbnfErrors::notify()
+{
+    if( d_batch > 0 )
+        d_changed = true;
+    else
+        d_eventLatency.start(400);
+}
@@ -30,30 +30,72 @@ class EbnfErrors : public QObject
     Q_OBJECT
 public:
     enum Source { Syntax, Semantics, Analysis };
+
+    // A message template with up to MaxArgs arguments. Only the templates, which are string
+    // literals, are interned in a process wide pool, so their number is bounded by the source; the
+    // arguments and ready-made texts are kept by value. The text is only composed by toString().
+    class Msg
+    {
+    public:
+        enum { MaxArgs = 4 };
+        Msg():d_tmpl(0),d_argCount(0){} // empty
+        explicit Msg( const char* tmpl ); // pass string literals only
+        explicit Msg( const QString& text ); // a complete text without arguments
+        Msg& arg( const QString& );
+        Msg& arg( int );
+        QString toString() const; // same as applying arg() to the template in order
+        bool operator==( const Msg& rhs ) const;
+        uint hash() const;
+    private:
+        quint32 d_tmpl; // 0..d_text
+        quint8 d_argCount;
+        QString d_text;
+        QString d_args[MaxArgs];
+    };
+
     struct Entry
     {
         quint32 d_line;
         quint16 d_col;
         quint8 d_source;
         bool d_isErr;
-        QString d_msg;
+        Msg d_msg;
         QVariant d_data;
-        Entry():d_source(0),d_isErr(true){}
+        Entry():d_line(0),d_col(0),d_source(0),d_isErr(true){}
         bool operator==( const Entry& rhs )const
         {
             return d_line == rhs.d_line && d_col == rhs.d_col && d_msg == rhs.d_msg &&
                     d_isErr == rhs.d_isErr && d_source == rhs.d_source;
         }
+        bool operator<( const Entry& rhs ) const // line and column order
+        {
+            return d_line < rhs.d_line || ( d_line == rhs.d_line && d_col < rhs.d_col );
+        }
     };
-    typedef QSet<Entry> EntryList;
+    typedef QList<Entry> EntryList;
 
     explicit EbnfErrors(QObject *parent = 0);
 
-    void error( Source, int line, int col, const QString& msg, const QVariant& = QVariant() );
-    void warning( Source, int line, int col, const QString& msg, const QVariant& = QVariant() );
+    void error( Source, int line, int col, const Msg& msg, const QVariant& = QVariant() );
+    void warning( Source, int line, int col, const Msg& msg, const QVariant& = QVariant() );
+    void add( const Entry& ); // error() or warning() depending on d_isErr
     void clear();
 
-    const EntryList& getErrors() const { return d_errs; }
+    // Between beginBatch and endBatch no sigChanged is scheduled; endBatch schedules one if
+    // entries were added or cleared meanwhile. Batches can be nested.
+    void beginBatch() { d_batch++; }
+    void endBatch();
+
+    // Buffered mode is for worker threads: new entries are also kept in report order and
+    // sigChanged is not emitted; the owner merges the buffer with add().
+    void setBuffered( bool on ) { d_buffered = on; }
+    const QList<Entry>& getBuffer() const { return d_buffer; }
+
+    // all entries ordered by line and column, rebuilt on demand after changes
+    const EntryList& getSorted() const;
+    static bool lessThan( const Entry&, const Entry& ); // the total order of getSorted
+    int getCount() const { return d_errs.size(); }
+    bool isEmpty() const { return d_errs.isEmpty(); }
     void resetErrCount() { d_errCounter = 0; }
     quint16 getErrCount() const { return d_errCounter; }
 
@@ -61,17 +103,24 @@ signals:
     void sigChanged();
 
 protected:
+    bool insert( const Entry& );
     void notify();
 
 private:
     QTimer d_eventLatency;
-    EntryList d_errs;
+    QSet<Entry> d_errs;
+    mutable EntryList d_sorted;
+    QList<Entry> d_buffer;
+    int d_batch;
     quint16 d_errCounter;
     bool d_reportToConsole;
+    bool d_buffered;
+    bool d_changed; // within the batch
+    mutable bool d_sortedValid;
 };
 
 inline uint qHash(const EbnfErrors::Entry & e, uint seed = 0) {
-    return ::qHash(e.d_msg,seed) ^ ::qHash(e.d_line,seed) ^ ::qHash(e.d_col,seed);
+    return e.d_msg.hash() ^ ::qHash(e.d_line,seed) ^ ::qHash(e.d_col,seed);
 }
 
 #endif // EBNFERRORS_H
@@ -18,9 +18,13 @@
 */
 
 #include "EbnfHighlighter.h"
-#include "EbnfLexer.h"
+#include <QTextDocument>
+#include <QTextBlock>
 #include <QtDebug>
 
+// the table of the lexer only keeps the identifiers typed so far, so it is simply restarted
+static const int s_maxSymbols = 10000;
+
 EbnfHighlighter::EbnfHighlighter(QTextDocument* doc):QSyntaxHighlighter(doc)
 {
     for( int i = 0; i < C_Max; i++ )
@@ -57,13 +61,60 @@ EbnfHighlighter::EbnfHighlighter(QTextDocument* doc):QSyntaxHighlighter(doc)
 
 }
 
+void EbnfHighlighter::setKeywords(const Keywords& kw)
+{
+    d_lex.setKeywords( kw );
+}
+
+void EbnfHighlighter::updateKeywords(const Keywords& kw)
+{
+    const Keywords old = d_lex.getKeywords();
+    if( old == kw )
+        return;
+    d_lex.setKeywords( kw );
+    if( d_lex.getSymbols()->getCount() > s_maxSymbols )
+        d_lex.setSymbols( new SymbolTable() );
+
+    QSet<EbnfToken::Sym> changed;
+    foreach( const QByteArray& k, old )
+    {
+        if( !kw.contains( k ) )
+            changed.insert( d_lex.getSymbols()->intern( k ) );
+    }
+    foreach( const QByteArray& k, kw )
+    {
+        if( !old.contains( k ) )
+            changed.insert( d_lex.getSymbols()->intern( k ) );
+    }
+
+    // collect first, since rehighlightBlock uses the lexer too
+    QList<QTextBlock> affected;
+    for( QTextBlock b = document()->begin(); b.isValid(); b = b.next() )
+    {
+        d_lex.setBuffer( b.text().toUtf8() );
+        EbnfToken t = d_lex.nextToken();
+        while( t.isValid() )
+        {
+            if( ( t.d_type == EbnfToken::NonTerm || t.d_type == EbnfToken::Keyword ) &&
+                    changed.contains( t.d_val ) )
+            {
+                affected.append( b );
+                break;
+            }
+            t = d_lex.nextToken();
+        }
+    }
+    foreach( const QTextBlock& b, affected )
+        rehighlightBlock( b );
+}
+
 void EbnfHighlighter::highlightBlock(const QString& text)
 {
-    EbnfLexer lex;
-    lex.setKeywords(d_kw);
-    QList<EbnfToken> toks = lex.tokens(text);
+    if( d_lex.getSymbols()->getCount() > s_maxSymbols )
+        d_lex.setSymbols( new SymbolTable() );
+    d_lex.setBuffer( text.toUtf8() );
 
-    foreach( const EbnfToken& t, toks )
+    for( EbnfToken t = d_lex.nextToken(); t.isValid(); t = d_lex.nextToken() )
     {
         if( EbnfToken::isPpType(t.d_type) )
         {
@@ -120,7 +171,6 @@ void EbnfHighlighter::highlightBlock(const QString& text)
         }
         if( f.isValid() )
         {
-            const QString s = t.d_val.toStr();
             if( t.d_type == EbnfToken::Literal )
             {
                 setFormat( t.d_colNr - 1, 1, d_format[C_Gray] );
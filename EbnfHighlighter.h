@@ -21,23 +21,25 @@
 */
 
 #include <QSyntaxHighlighter>
-#include "EbnfToken.h"
+#include "EbnfLexer.h"
 
 class EbnfHighlighter : public QSyntaxHighlighter
 {
 public:
     enum { NonTermProp = QTextFormat::UserProperty };
-    typedef QSet<EbnfToken::Sym> Keywords;
+    typedef QSet<QByteArray> Keywords;
     EbnfHighlighter(QTextDocument* doc);
-    void setKeywords( const Keywords& kw ) { d_kw = kw; }
-    const Keywords& getKeywords() const { return d_kw; }
+    void setKeywords( const Keywords& kw );
+    const Keywords& getKeywords() const { return d_lex.getKeywords(); }
+    // like setKeywords, but rehighlights the blocks using one of the added or removed keywords
+    void updateKeywords( const Keywords& kw );
 protected:
     // Override
     void highlightBlock( const QString & text );
 private:
     enum Category { C_Ebnf, C_Cmt, C_Kw, C_Lit, C_Prod, C_Nt, C_Pred, C_Gray, C_Pragma, C_Pp, C_Max };
     QTextCharFormat d_format[C_Max];
-    Keywords d_kw;
+    EbnfLexer d_lex; // reused for all blocks
 };
 
 #endif // EBNFHIGHLIGHTER_H
@@ -22,26 +22,63 @@
 #include <QBuffer>
 #include <QFile>
 #include <QtDebug>
+#include <string.h>
+
+static inline bool isAsciiAlnum( char ch )
+{
+    return ( ch >= 'a' && ch <= 'z' ) || ( ch >= 'A' && ch <= 'Z' ) || ( ch >= '0' && ch <= '9' );
+}
+
+static inline bool isAsciiSpace( char ch )
+{
+    return ch == ' ' || ( ch >= '\t' && ch <= '\r' );
+}
 
 EbnfLexer::EbnfLexer(QObject *parent) : QObject(parent),
-    d_lastToken(EbnfToken::Invalid),d_lineNr(0),d_colNr(0),d_in(0)
+    d_lastToken(EbnfToken::Invalid),d_lineNr(0),d_colNr(0),d_in(0),d_pos(0),d_off(0),d_syms(new SymbolTable())
 {
 
 }
 
+void EbnfLexer::setSymbols(SymbolTable* syms)
+{
+    Q_ASSERT( syms != 0 );
+    d_syms = syms;
+    d_kwSyms.clear();
+    foreach( const QByteArray& k, d_kw )
+        d_kwSyms.insert( d_syms->intern( k ) );
+}
+
+void EbnfLexer::setKeywords(const Keywords& kw)
+{
+    d_kw.clear();
+    d_kwSyms.clear();
+    addKeywords( kw );
+}
+
+void EbnfLexer::addKeywords(const Keywords& kw)
+{
+    foreach( const QByteArray& k, kw )
+    {
+        d_kw.insert( k );
+        d_kwSyms.insert( d_syms->intern( k ) );
+    }
+}
+
 EbnfToken EbnfLexer::nextTokenImp()
 {
-    if( d_in == 0 )
-        return token(EbnfToken::Eof);
     skipWhiteSpace();
 
     bool potentialProduction = false;
-    while( d_colNr >= d_line.size() )
+    while( d_off >= d_line.size() )
     {
-        if( d_in->atEnd() )
+        if( d_pos >= d_data.size() )
         {
             EbnfToken t = token( EbnfToken::Eof, 0 );
-            if( d_in->parent() == this )
+            d_line.clear();
+            d_data.clear();
+            d_pos = 0;
+            if( d_in && d_in->parent() == this )
             {
                 d_in->deleteLater();
                 d_in = 0;
@@ -52,18 +89,20 @@ EbnfToken EbnfLexer::nextTokenImp()
         potentialProduction = ( skipWhiteSpace() == 0 );
     }
 
-    Q_ASSERT( d_colNr < d_line.size() );
-    while( d_colNr < d_line.size() )
+    Q_ASSERT( d_off < d_line.size() );
+    while( d_off < d_line.size() )
     {
-        const QChar ch = d_line[d_colNr];
+        const char ch = d_line[d_off];
 
         if( ch == '/' && lookAhead(1) == '/' )
-            return token(EbnfToken::Comment, d_line.size() - d_colNr, d_line.mid( d_colNr + 2 ).trimmed().toUtf8() );
+            return token(EbnfToken::Comment, columns( d_off, d_line.size() - d_off ),
+                         raw( d_off + 2, d_line.size() - d_off - 2 ).trimmed(), d_line.size() - d_off );
 
-        if( d_colNr == 0 && ch == '#' )
+        if( d_off == 0 && ch == '#' )
         {
             return ppsym();
-        }else if( ch.isLetterOrNumber() || ch == '$' || ch == '%' )
+        }else if( isAsciiAlnum(ch) || ch == '$' || ch == '%' ||
+                  ( uchar(ch) >= 0x80 && charAt( d_off, 0 ).isLetterOrNumber() ) )
         {
             // Identifier oder Reserved Word
             EbnfToken t = ident();
@@ -78,7 +117,7 @@ EbnfToken EbnfLexer::nextTokenImp()
                 }
             }else
             {
-                if( d_kw.contains(t.d_val) )
+                if( d_kwSyms.contains(t.d_val) )
                     t.d_type = EbnfToken::Keyword;
                 return t;
             }
@@ -90,7 +129,7 @@ EbnfToken EbnfLexer::nextTokenImp()
         if( potentialProduction )
             return token( EbnfToken::Invalid, 0, "production or comment expected" );
 
-        switch( ch.unicode() )
+        switch( ch )
         {
         case ':':
             if( lookAhead(1) == ':' && lookAhead(2) == '=' )
@@ -121,7 +160,8 @@ EbnfToken EbnfLexer::nextTokenImp()
         }else
         {
             // Error
-            return token( EbnfToken::Invalid, 0, QString("unexpected character '%1' %2").arg(ch).arg(ch.unicode()).toUtf8() );
+            const QChar c = charAt( d_off, 0 );
+            return token( EbnfToken::Invalid, 0, QString("unexpected character '%1' %2").arg(c).arg(c.unicode()).toUtf8() );
         }
     }
     Q_ASSERT(false);
@@ -135,10 +175,7 @@ QList<EbnfToken> EbnfLexer::tokens(const QString& code)
 
 QList<EbnfToken> EbnfLexer::tokens(const QByteArray& code)
 {
-    QBuffer in;
-    in.setData( code );
-    in.open(QIODevice::ReadOnly);
-    setStream( &in );
+    setBuffer( code );
 
     QList<EbnfToken> res;
     EbnfToken t = nextToken();
@@ -150,10 +187,39 @@ QList<EbnfToken> EbnfLexer::tokens(const QByteArray& code)
     return res;
 }
 
-void EbnfLexer::setStream(QIODevice* in)
+void EbnfLexer::setStream(QIODevice* in, quint32 lineOffset)
 {
+    QByteArray data;
+    int pos = 0;
+    if( in )
+    {
+        QFile* file = qobject_cast<QFile*>( in );
+        QBuffer* buf = qobject_cast<QBuffer*>( in );
+        uchar* mapped = 0;
+        if( file && file->size() > in->pos() )
+            mapped = file->map( in->pos(), file->size() - in->pos() );
+        if( mapped )
+            data = QByteArray::fromRawData( (const char*)mapped, file->size() - in->pos() );
+        else if( buf )
+        {
+            data = buf->data();
+            pos = buf->pos();
+        }else
+            data = in->readAll();
+    }
+    setBuffer( data, lineOffset );
+    d_pos = pos;
     d_in = in;
-    d_lineNr = 0;
+}
+
+void EbnfLexer::setBuffer(const QByteArray& utf8, quint32 lineOffset)
+{
+    d_in = 0;
+    d_data = utf8;
+    d_pos = 0;
+    d_line.clear();
+    d_off = 0;
+    d_lineNr = lineOffset;
     d_colNr = 0;
     d_lastToken = EbnfToken::Invalid;
 }
@@ -163,12 +229,13 @@ bool EbnfLexer::readKeywordsFromFile(const QString& path)
     QFile in(path);
     if( !in.open(QIODevice::ReadOnly) )
         return false;
-    d_kw.clear();
+    Keywords res;
     QStringList kw = QString::fromUtf8(in.readAll().simplified()).split(' ');
     for( int i = 0; i < kw.size(); i++ )
     {
-        d_kw.insert( EbnfToken::getSym(kw[i].toUtf8()) );
+        res.insert( kw[i].toUtf8() );
     }
+    setKeywords( res );
     return true;
 }
 
@@ -194,92 +261,190 @@ EbnfToken EbnfLexer::peekToken(quint8 lookAhead)
 
 int EbnfLexer::skipWhiteSpace()
 {
-    const int colNr = d_colNr;
-    while( d_colNr < d_line.size() && d_line[d_colNr].isSpace() )
-        d_colNr++;
-    return d_colNr - colNr;
+    const int off = d_off;
+    while( d_off < d_line.size() )
+    {
+        const char ch = d_line[d_off];
+        if( isAsciiSpace(ch) )
+        {
+            d_off++;
+            d_colNr++;
+        }else if( uchar(ch) >= 0x80 )
+        {
+            int bytes;
+            if( !charAt( d_off, &bytes ).isSpace() )
+                break;
+            d_off += bytes;
+            d_colNr++; // the spaces are all in the BMP
+        }else
+            break;
+    }
+    return d_off - off;
 }
 
-EbnfToken EbnfLexer::token(EbnfToken::TokenType tt, int len, const QByteArray& val)
+EbnfToken EbnfLexer::token(EbnfToken::TokenType tt, int len, const QByteArray& val, int bytes)
 {
-    EbnfToken t( tt, d_lineNr, d_colNr + 1, len, val );
+    EbnfToken t( tt, d_lineNr, d_colNr + 1, len, d_syms->intern(val) );
     d_lastToken = t;
     d_colNr += len;
+    d_off += bytes < 0 ? len : bytes;
     return t;
 }
 
 int EbnfLexer::lookAhead(int off) const
 {
-    if( int( d_colNr + off ) < d_line.size() )
+    if( d_off + off < d_line.size() )
     {
-        return d_line[ d_colNr + off ].unicode();
+        return uchar( d_line[ d_off + off ] );
     }else
         return 0;
 }
 
+QChar EbnfLexer::charAt(int off, int* bytes) const
+{
+    // invalid sequences are a replacement character per byte like in QString::fromUtf8
+    const int left = d_line.size() - off;
+    const uchar* s = (const uchar*)d_line.constData() + off;
+    int len = 1;
+    uint ch = s[0];
+    if( ch >= 0x80 )
+    {
+        if( ( ch & 0xe0 ) == 0xc0 )
+        {
+            len = 2;
+            ch &= 0x1f;
+        }else if( ( ch & 0xf0 ) == 0xe0 )
+        {
+            len = 3;
+            ch &= 0x0f;
+        }else if( ( ch & 0xf8 ) == 0xf0 )
+        {
+            len = 4;
+            ch &= 0x07;
+        }else
+            len = 0;
+        for( int i = 1; i < len; i++ )
+        {
+            if( i >= left || ( s[i] & 0xc0 ) != 0x80 )
+            {
+                len = 0;
+                break;
+            }
+            ch = ( ch << 6 ) | ( s[i] & 0x3f );
+        }
+        if( len == 0 )
+        {
+            len = 1;
+            ch = 0xfffd;
+        }
+    }
+    if( bytes )
+        *bytes = len;
+    if( ch > 0xffff )
+        return QChar( ushort( 0xd800 + ( ( ch - 0x10000 ) >> 10 ) ) ); // high surrogate
+    else
+        return QChar( ushort(ch) );
+}
+
+int EbnfLexer::columns(int off, int bytes) const
+{
+    int res = 0;
+    const int end = qMin( off + bytes, d_line.size() );
+    while( off < end )
+    {
+        if( uchar( d_line[off] ) < 0x80 )
+        {
+            off++;
+            res++;
+        }else
+        {
+            int len;
+            charAt( off, &len );
+            off += len;
+            res += len == 4 ? 2 : 1; // surrogate pair
+        }
+    }
+    return res;
+}
+
 void EbnfLexer::nextLine()
 {
     d_colNr = 0;
+    d_off = 0;
     d_lineNr++;
-    d_line = d_in->readLine();
 
-    // see https://de.wikipedia.org/wiki/Zeilenumbruch
-    if( d_line.endsWith("\r\n") )
-        d_line.chop(2);
-    else if( d_line.endsWith('\n') || d_line.endsWith('\r') || d_line.endsWith('\025') )
-        d_line.chop(1);
+    const char* start = d_data.constData() + d_pos;
+    const int left = d_data.size() - d_pos;
+    const char* nl = (const char*)::memchr( start, '\n', left );
+    int len = nl ? int( nl - start ) + 1 : left;
+    d_pos += len;
 
+    // see https://de.wikipedia.org/wiki/Zeilenumbruch
+    if( len >= 2 && start[len-2] == '\r' && start[len-1] == '\n' )
+        len -= 2;
+    else if( len >= 1 && ( start[len-1] == '\n' || start[len-1] == '\r' || start[len-1] == '\025' ) )
+        len -= 1;
+    d_line = QByteArray::fromRawData( start, len );
 }
 
 EbnfToken EbnfLexer::ident()
 {
-    int off = 1; // off == 0 wurde bereits dem ident zugeordnet
-    while( true )
+    int off; // the first char was already assigned to the ident
+    charAt( d_off, &off );
+    int cols = 1;
+    while( d_off + off < d_line.size() )
     {
-        if( (d_colNr+off) >= d_line.size() ||
-                ( !d_line[d_colNr+off].isLetterOrNumber() && d_line[d_colNr+off] != '_' &&
-                  d_line[d_colNr+off] != '$' ) ) // hier darf '-' nicht wie '$' behandelt werden, sonst wird - Teil des Idents!
-            break;
-        else
+        const char ch = d_line[d_off+off];
+        if( isAsciiAlnum(ch) || ch == '_' || ch == '$' ) // hier darf '-' nicht wie '$' behandelt werden, sonst wird - Teil des Idents!
+        {
             off++;
+            cols++;
+        }else if( uchar(ch) >= 0x80 )
+        {
+            int bytes;
+            if( !charAt( d_off + off, &bytes ).isLetterOrNumber() )
+                break;
+            off += bytes;
+            cols++; // a surrogate is no letter
+        }else
+            break;
     }
-    const QByteArray str = d_line.mid(d_colNr, off ).toUtf8();
-    EbnfToken t = token( EbnfToken::NonTerm, off, str ); // ob es sich um ein KeyWord handelt, wird später entschieden
+    EbnfToken t = token( EbnfToken::NonTerm, cols, raw( d_off, off ), off ); // ob es sich um ein KeyWord handelt, wird später entschieden
     t.d_op = readOp();
     return t;
 }
 
 EbnfToken EbnfLexer::attribute()
 {
-    int off = 1;
-    while( true )
-    {
-        if( (d_colNr+off) >= d_line.size() || d_line[d_colNr+off] == '\\' )
-            break;
-        else
-            off++;
-    }
-    const QByteArray str = d_line.mid(d_colNr + 1, off - 1 ).toUtf8();
-    return token( EbnfToken::Predicate, off+1, str );
+    const char* start = d_line.constData() + d_off + 1;
+    const char* end = (const char*)::memchr( start, '\\', d_line.size() - d_off - 1 );
+    const int off = ( end ? int( end - start ) : d_line.size() - d_off - 1 ) + 1;
+    return token( EbnfToken::Predicate, columns( d_off, off ) + 1, raw( d_off + 1, off - 1 ), off + 1 );
 }
 
 EbnfToken EbnfLexer::literal()
 {
     int off = 1; // skip starting '
+    bool escaped = false;
     while( true )
     {
-        if( (d_colNr+off) < d_line.size() && d_line[d_colNr+off] == '\\' )
+        if( (d_off+off) < d_line.size() && d_line[d_off+off] == '\\' )
+        {
             off++;
-        else if( (d_colNr+off) >= d_line.size() || d_line[d_colNr+off] == '\'' )
+            escaped = true;
+        }else if( (d_off+off) >= d_line.size() || d_line[d_off+off] == '\'' )
             break;
         off++;
     }
-    if( d_line[d_colNr+off] != '\'' )
+    if( (d_off+off) >= d_line.size() || d_line[d_off+off] != '\'' )
         return token( EbnfToken::Invalid, 0, "non-terminated literal");
-    QString str = d_line.mid(d_colNr + 1, off - 1 );
-    str.replace("\\'", "'");
-    str.replace("\\\\", "\\");
-    EbnfToken t = token( EbnfToken::Literal, off+1, str.toUtf8() ); // remove enclosing ''
+    QByteArray str = raw( d_off + 1, off - 1 );
+    if( escaped )
+    {
+        str.replace("\\'", "'");
+        str.replace("\\\\", "\\");
+    }
+    EbnfToken t = token( EbnfToken::Literal, columns( d_off, off + 1 ), str, off + 1 ); // remove enclosing ''
     t.d_op = readOp();
     return t;
 }
@@ -287,14 +452,16 @@ EbnfToken EbnfLexer::literal()
 EbnfToken EbnfLexer::ppsym()
 {
     int off = 1; // off == 0 wurde bereits dem ident zugeordnet
-    while( true )
+    while( d_off + off < d_line.size() )
     {
-        if( (d_colNr+off) >= d_line.size() || !d_line[d_colNr+off].isLetterOrNumber() )
-            break;
+        const char ch = d_line[d_off+off];
+        int bytes = 1;
+        if( isAsciiAlnum(ch) || ( uchar(ch) >= 0x80 && charAt( d_off + off, &bytes ).isLetterOrNumber() ) )
+            off += bytes;
         else
-            off++;
+            break;
     }
-    const QByteArray keyword = d_line.mid(d_colNr, off ).toUtf8();
+    const QByteArray keyword = raw( d_off, off );
     EbnfToken::TokenType tt = EbnfToken::Invalid;
     if( keyword == "#define" )
         tt = EbnfToken::PpDefine;
@@ -309,30 +476,31 @@ EbnfToken EbnfLexer::ppsym()
     else if( keyword == "#endif")
         tt = EbnfToken::PpEndif;
     if( tt == EbnfToken::Invalid )
-        return token( EbnfToken::Invalid, 0, QString("invalid preprocessor symbol '%1'").arg(keyword.data()).toUtf8() );
+        return token( EbnfToken::Invalid, 0, QString("invalid preprocessor symbol '%1'").arg(QString::fromUtf8(keyword)).toUtf8() );
     const int cmtPos = d_line.indexOf("//", off);
-    const QString str = ( cmtPos == -1 ? d_line.mid(off) : d_line.mid(off,cmtPos-off) ).trimmed();
-    return token( tt, d_line.size(), str.toUtf8() );
+    const QByteArray str = ( cmtPos == -1 ? raw( off, d_line.size() - off ) : raw( off, cmtPos - off ) ).trimmed();
+    return token( tt, columns( 0, d_line.size() ), str, d_line.size() );
 }
 
 EbnfToken::Handling EbnfLexer::readOp()
 {
-    if( d_colNr < d_line.size() )
+    if( d_off < d_line.size() )
     {
-        switch( d_line[d_colNr].unicode() )
+        switch( d_line[d_off] )
         {
         case '*':
+            d_off++;
             d_colNr++;
             return EbnfToken::Transparent;
         case '!':
+            d_off++;
             d_colNr++;
             return EbnfToken::Keep;
         case '-':
+            d_off++;
             d_colNr++;
             return EbnfToken::Skip;
         }
     }
     return EbnfToken::Normal;
 }
-
-
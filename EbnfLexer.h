@@ -22,20 +22,26 @@
 
 #include <QObject>
 #include <QSet>
-#include "EbnfToken.h"
+#include "SymbolTable.h"
 
 class QIODevice;
 
 class EbnfLexer : public QObject
 {
 public:
-    typedef QSet<EbnfToken::Sym> Keywords;
+    typedef QSet<QByteArray> Keywords;
     explicit EbnfLexer(QObject *parent = 0);
 
-    void setStream( QIODevice* );
+    // files are mapped and buffers shared if possible, otherwise the remaining content is read at once
+    void setStream( QIODevice*, quint32 lineOffset = 0 ); // lineOffset is added to all line numbers
+    void setBuffer( const QByteArray& utf8, quint32 lineOffset = 0 ); // shared, not copied
 
-    void setKeywords( const Keywords& kw ) { d_kw = kw; }
-    void addKeywords( const Keywords& kw ) { d_kw += kw; }
+    // the values of the tokens are interned here; a new lexer starts with an empty table
+    void setSymbols( SymbolTable* );
+    SymbolTable* getSymbols() const { return d_syms.data(); }
+
+    void setKeywords( const Keywords& );
+    void addKeywords( const Keywords& );
     const Keywords& getKeywords() const { return d_kw; }
     bool readKeywordsFromFile( const QString& path );
 
@@ -46,8 +52,12 @@ public:
 protected:
     EbnfToken nextTokenImp();
     int skipWhiteSpace();
-    EbnfToken token(EbnfToken::TokenType tt, int len = 1, const QByteArray &val = QByteArray());
-    int lookAhead(int off = 1) const;
+    // len is in columns, bytes in d_line if different
+    EbnfToken token(EbnfToken::TokenType tt, int len = 1, const QByteArray &val = QByteArray(), int bytes = -1);
+    int lookAhead(int off = 1) const; // the byte at d_off + off
+    QChar charAt( int off, int* bytes ) const; // the first QChar of the UTF-8 sequence at off
+    int columns( int off, int bytes ) const; // QChars of the bytes of d_line
+    QByteArray raw( int off, int bytes ) const { return QByteArray::fromRawData( d_line.constData() + off, bytes ); }
     EbnfToken ident();
     EbnfToken attribute();
     EbnfToken literal();
@@ -57,12 +67,17 @@ protected:
 
 private:
     QIODevice* d_in;
+    QByteArray d_data; // UTF-8, raw data if mapped
+    int d_pos; // start of the next line in d_data
     quint32 d_lineNr; // current line, starting with 1
-    quint16 d_colNr;  // current column (left of char), starting with 0
-    QString d_line;
+    quint16 d_colNr;  // current column (left of char) in QChars as the editor counts, starting with 0
+    int d_off; // d_colNr as byte offset in d_line
+    QByteArray d_line; // raw data in d_data, without line end
     EbnfToken d_lastToken;
     QList<EbnfToken> d_buffer;
     Keywords d_kw;
+    QSet<EbnfToken::Sym> d_kwSyms; // d_kw interned in d_syms
+    SymbolTableRef d_syms;
 };
 
 #endif // EBNFLEXER_H
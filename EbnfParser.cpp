@@ -21,6 +21,7 @@
 #include "EbnfLexer.h"
 #include "EbnfErrors.h"
 #include "LaParser.h"
+#include <ctype.h>
 
 EbnfParser::EbnfParser(QObject *parent) : QObject(parent),d_lex(0),d_def(0),d_errs(0)
 {
@@ -35,6 +36,7 @@ bool EbnfParser::parse(EbnfLexer* lex)
         d_errs->resetErrCount();
 
     d_syn = new EbnfSyntax(d_errs);
+    d_syn->setSymbols( d_lex->getSymbols() );
     d_def = 0;
 
     EbnfToken t = nextToken();
@@ -45,7 +47,7 @@ bool EbnfParser::parse(EbnfLexer* lex)
             EbnfToken op = nextToken();
             if( op.d_type == EbnfToken::Assig )
             {
-                d_def = new Ast::Definition(t);
+                d_def = new( d_syn->getArena() ) Ast::Definition(t);
                 if( !d_syn->addDef( d_def ) )
                 {
                     delete d_def;
@@ -64,7 +66,12 @@ bool EbnfParser::parse(EbnfLexer* lex)
                 {
                     d_syn->addPragma( t, parseExpression() );
                     if( t.d_val.toBa() == "%keywords" )
-                        d_lex->addKeywords( d_syn->getPragma( t.d_val ).toSet() );
+                    {
+                        EbnfLexer::Keywords kw;
+                        foreach( const EbnfToken::Sym& s, d_syn->getPragma( t.d_val ) )
+                            kw.insert( QByteArray( s.data(), s.size() ) ); // a copy, the keywords outlive the syntax
+                        d_lex->addKeywords( kw );
+                    }
                 }
             }else
                return error( t, tr("expecing '::=' or '+='") );
@@ -90,6 +97,127 @@ EbnfSyntax* EbnfParser::getSyntax()
     return d_syn.data();
 }
 
+static QVector<int> lineStarts( const QByteArray& text )
+{
+    // index 0 is line 1; the last entry is text.size() + 1
+    QVector<int> res;
+    res.append(0);
+    for( int i = 0; i < text.size(); i++ )
+    {
+        if( text[i] == '\n' )
+            res.append(i+1);
+    }
+    res.append(text.size()+1);
+    return res;
+}
+
+static inline QByteArray line( const QByteArray& text, const QVector<int>& starts, int nr )
+{
+    return QByteArray::fromRawData( text.constData() + starts[nr-1], starts[nr] - starts[nr-1] - 1 );
+}
+
+static bool startsProduction( const QByteArray& text, const QVector<int>& starts, int nr )
+{
+    const int pos = starts[nr-1];
+    if( pos >= text.size() )
+        return false;
+    const char ch = text[pos];
+    return !::isspace( uchar(ch) ) && ch != '/' && ch != '#';
+}
+
+static bool hasPpOrPragma( const QByteArray& text, const QVector<int>& starts, int from, int to )
+{
+    for( int i = from; i < to; i++ )
+    {
+        const int pos = starts[i-1];
+        if( pos < text.size() && ( text[pos] == '#' || text[pos] == '%' ) )
+            return true;
+    }
+    return false;
+}
+
+bool EbnfParser::reparse(EbnfSyntax* syn, const QByteArray& oldText, const QByteArray& newText)
+{
+    Q_ASSERT( syn != 0 );
+    if( oldText == newText )
+        return true;
+    // the preprocessor state of a line depends on all lines before
+    if( oldText.startsWith('#') || oldText.contains("\n#") ||
+            newText.startsWith('#') || newText.contains("\n#") )
+        return false;
+
+    const QVector<int> oldStarts = lineStarts(oldText);
+    const QVector<int> newStarts = lineStarts(newText);
+    const int oldCount = oldStarts.size() - 1;
+    const int newCount = newStarts.size() - 1;
+    const int minCount = qMin( oldCount, newCount );
+    int prefix = 0;
+    while( prefix < minCount && line( oldText, oldStarts, prefix + 1 ) == line( newText, newStarts, prefix + 1 ) )
+        prefix++;
+    int suffix = 0;
+    while( suffix < minCount - prefix &&
+           line( oldText, oldStarts, oldCount - suffix ) == line( newText, newStarts, newCount - suffix ) )
+        suffix++;
+    const int delta = newCount - oldCount;
+
+    // each production or pragma starts in column 0 and ends before the next one (the lexer rejects
+    // anything else there), so the ones from the last start before the first changed line up to
+    // the first start after the last changed line are parsed again
+    const quint32 firstChanged = prefix + 1;
+    const quint32 afterChanged = oldCount - suffix + 1;
+    quint32 from = 1;
+    quint32 to = oldCount + 1;
+    for( quint32 i = 1; i <= quint32(oldCount); i++ )
+    {
+        if( !startsProduction( oldText, oldStarts, i ) )
+            continue;
+        if( i < firstChanged )
+            from = i;
+        else if( i >= afterChanged )
+        {
+            to = i;
+            break;
+        }
+    }
+    if( hasPpOrPragma( oldText, oldStarts, from, to ) ||
+            hasPpOrPragma( newText, newStarts, from, to + delta ) )
+        return false;
+
+    // the lexer has to see the same keywords as in the full parse, i.e. all of them unless they are
+    // extended after the region; and overwritten pragmas are reported by the parser
+    QSet<QByteArray> pragmas;
+    for( int i = 1; i <= oldCount; i++ )
+    {
+        const QByteArray l = line( oldText, oldStarts, i );
+        if( !l.startsWith('%') )
+            continue;
+        int len = 1;
+        while( len < l.size() && !::isspace( uchar(l[len]) ) && l[len] != ':' && l[len] != '+' )
+            len++;
+        const QByteArray name = l.left(len);
+        const bool addTo = l.mid(len).trimmed().startsWith("+=");
+        if( ( addTo && name == "%keywords" && i >= int(to) ) || ( !addTo && pragmas.contains(name) ) )
+            return false;
+        pragmas.insert(name);
+    }
+
+    QByteArray region = QByteArray::fromRawData( newText.constData() + newStarts[from-1],
+            qMin( newStarts[to + delta - 1], newText.size() ) - newStarts[from-1] );
+    EbnfLexer lex;
+    lex.setSymbols(syn->getSymbols()); // the spliced productions refer to the same Syms
+    lex.setKeywords(syn->getKeywords());
+    lex.setBuffer( region, from - 1 );
+    EbnfErrors errs;
+    errs.setBuffered(true); // the entries are dropped; runs on worker threads
+    EbnfErrors* old = d_errs;
+    d_errs = &errs;
+    const bool ok = parse( &lex );
+    d_errs = old;
+    if( !ok )
+        return false;
+    return syn->splice( from, to, delta, d_syn.data() );
+}
+
 EbnfToken EbnfParser::nextToken()
 {
     Q_ASSERT( d_lex != 0 );
@@ -111,12 +239,12 @@ bool EbnfParser::error(const EbnfToken& t, const QString& msg)
     if( d_errs == 0 )
         return false;
     if( t.d_type == EbnfToken::Invalid )
-        d_errs->error( EbnfErrors::Syntax, t.d_lineNr, t.d_colNr, t.d_val.toStr() );
+        d_errs->error( EbnfErrors::Syntax, t.d_lineNr, t.d_colNr, EbnfErrors::Msg(t.d_val.toStr()) );
     else if( msg.isEmpty() )
         d_errs->error( EbnfErrors::Syntax, t.d_lineNr, t.d_colNr,
-                        QString("unexpected symbol '%1'").arg(t.toString()) );
+                        EbnfErrors::Msg("unexpected symbol '%1'").arg(t.toString()) );
     else
-        d_errs->error( EbnfErrors::Syntax, t.d_lineNr, t.d_colNr, msg );
+        d_errs->error( EbnfErrors::Syntax, t.d_lineNr, t.d_colNr, EbnfErrors::Msg(msg) );
     return false;
 }
 
@@ -130,11 +258,11 @@ Ast::Node*EbnfParser::parseFactor()
     {
     case EbnfToken::Keyword:
     case EbnfToken::Literal:
-        node = new Ast::Node( Ast::Node::Terminal, d_def, d_cur, d_cur.d_type == EbnfToken::Literal );
+        node = new( d_syn->getArena() ) Ast::Node( Ast::Node::Terminal, d_def, d_cur, d_cur.d_type == EbnfToken::Literal );
         nextToken();
         break;
     case EbnfToken::NonTerm:
-        node = new Ast::Node( Ast::Node::Nonterminal, d_def, d_cur );
+        node = new( d_syn->getArena() ) Ast::Node( Ast::Node::Nonterminal, d_def, d_cur );
         nextToken();
         break;
     case EbnfToken::LBrack:
@@ -235,7 +363,7 @@ Ast::Node*EbnfParser::parseExpression()
         nextToken();
         if( alternative == 0 )
         {
-            alternative = new Ast::Node( Ast::Node::Alternative, d_def );
+            alternative = new( d_syn->getArena() ) Ast::Node( Ast::Node::Alternative, d_def );
             alternative->d_tok.d_lineNr = first.d_lineNr;
             alternative->d_tok.d_colNr = first.d_colNr;
             alternative->d_subs.append(node);
@@ -289,10 +417,10 @@ Ast::Node*EbnfParser::parseTerm()
     Ast::Node* sequence = 0;
     if( pred.isValid() )
     {
-        sequence = new Ast::Node( Ast::Node::Sequence, d_def );
+        sequence = new( d_syn->getArena() ) Ast::Node( Ast::Node::Sequence, d_def );
         sequence->d_tok.d_lineNr = first.d_lineNr;
         sequence->d_tok.d_colNr = first.d_colNr;
-        sequence->d_subs.append(new Ast::Node( Ast::Node::Predicate, d_def, pred ));
+        sequence->d_subs.append(new( d_syn->getArena() ) Ast::Node( Ast::Node::Predicate, d_def, pred ));
         sequence->d_subs.back()->d_parent = sequence;
         sequence->d_subs.append(node);
         node->d_parent = sequence;
@@ -308,7 +436,7 @@ Ast::Node*EbnfParser::parseTerm()
     {
         if( sequence == 0 )
         {
-            sequence = new Ast::Node( Ast::Node::Sequence, d_def );
+            sequence = new( d_syn->getArena() ) Ast::Node( Ast::Node::Sequence, d_def );
             sequence->d_tok.d_lineNr = node->d_tok.d_lineNr;
             sequence->d_tok.d_colNr = node->d_tok.d_colNr;
             sequence->d_subs.append(node);
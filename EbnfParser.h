@@ -39,6 +39,11 @@ public:
     bool parse( EbnfLexer* );
     EbnfSyntax* getSyntax();
 
+    // Brings syn, which was parsed from oldText, up to date with newText by parsing only the
+    // productions touched by the edit. Returns false if this is not possible (preprocessor,
+    // pragmas, syntax errors); syn is unchanged then and a full parse is required.
+    bool reparse( EbnfSyntax* syn, const QByteArray& oldText, const QByteArray& newText );
+
 
 protected:
     EbnfToken nextToken();
@@ -32,6 +32,15 @@ QMAKE_CXXFLAGS += -Wno-reorder -Wno-unused-parameter -Wno-unused-function -Wno-u
 
 SOURCES += main.cpp\
     EbnfAnalyzer2.cpp \
+    LlkTrie.cpp \
+    FixpointSolver.cpp \
+    SccGraph.cpp \
+    Tracer.cpp \
+    TermSet.cpp \
+    AstArena.cpp \
+    FlatSyntax.cpp \
+    SymbolTable.cpp \
+    AnalysisService.cpp \
         MainWindow.cpp \
     EbnfEditor.cpp \
     EbnfHighlighter.cpp \
@@ -44,6 +53,7 @@ SOURCES += main.cpp\
     SynTreeGen.cpp \
     HtmlSyntax.cpp \
     SyntaxTreeMdl.cpp \
+    IssueMdl.cpp \
     GenUtils.cpp \
     CocoGen.cpp \
     FirstFollowSet.cpp \
@@ -56,6 +66,15 @@ SOURCES += main.cpp\
 
 HEADERS  += MainWindow.h \
     EbnfAnalyzer2.h \
+    LlkTrie.h \
+    FixpointSolver.h \
+    SccGraph.h \
+    Tracer.h \
+    TermSet.h \
+    AstArena.h \
+    FlatSyntax.h \
+    SymbolTable.h \
+    AnalysisService.h \
     EbnfEditor.h \
     EbnfHighlighter.h \
     EbnfLexer.h \
@@ -68,6 +87,7 @@ HEADERS  += MainWindow.h \
     SynTreeGen.h \
     HtmlSyntax.h \
     SyntaxTreeMdl.h \
+    IssueMdl.h \
     GenUtils.h \
     CocoGen.h \
     FirstFollowSet.h \
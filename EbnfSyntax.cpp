@@ -20,8 +20,12 @@
 #include "EbnfSyntax.h"
 #include "EbnfErrors.h"
 #include "LaParser.h"
+#include "SccGraph.h"
+#include "Tracer.h"
 #include <QTextStream>
 #include <QtDebug>
+#include <algorithm>
+#include <stdlib.h>
 
 // Ursprünglich aus Ada::Syntax adaptiert; stark modifiziert
 
@@ -34,7 +38,7 @@ const char* Ast::Node::s_typeName[] =
     "Predicate",
 };
 
-static bool error( EbnfErrors* errs, EbnfErrors::Source s,const EbnfToken& tok, const QString& msg )
+static bool error( EbnfErrors* errs, EbnfErrors::Source s,const EbnfToken& tok, const EbnfErrors::Msg& msg )
 {
     if( errs == 0 )
         return true;
@@ -89,7 +93,8 @@ Ast::NodeSet EbnfSyntax::collectNodes(const Ast::NodeRefSet& pattern, const Ast:
     return res;
 }
 
-EbnfSyntax::EbnfSyntax(EbnfErrors* errs):d_finished(false),d_errs(errs)
+EbnfSyntax::EbnfSyntax(EbnfErrors* errs):d_finished(false),d_resolved(false),d_spliced(false),
+    d_analyzed(false),d_syms(new SymbolTable()),d_garbage(0),d_errs(errs)
 {
 
 }
@@ -107,6 +112,122 @@ void EbnfSyntax::dump() const
 	qDebug() << "******** End Dump";
 }
 
+static QString opSuffix( const EbnfToken& tok )
+{
+    switch( tok.d_op )
+    {
+    case EbnfToken::Transparent:
+        return QLatin1String("*");
+    case EbnfToken::Keep:
+        return QLatin1String("!");
+    case EbnfToken::Skip:
+        return QLatin1String("-");
+    default:
+        return QString();
+    }
+}
+
+void EbnfSyntax::writeEbnf(QTextStream& out) const
+{
+    // the pragmas first, since %keywords changes how the lexer reads the productions
+    QList<QByteArray> names;
+    for( Definitions::const_iterator i = d_pragmas.begin(); i != d_pragmas.end(); ++i )
+        names.append( i.key().toBa() );
+    qSort( names );
+    foreach( const QByteArray& name, names )
+    {
+        const Ast::Definition* d = d_pragmas.value( d_syms->find(name) );
+        if( d == 0 || d->d_node == 0 )
+            continue;
+        out << name << ( name == "%keywords" ? " += " : " ::= " );
+        writeEbnf( out, d->d_node );
+        out << endl;
+    }
+    foreach( const Ast::Definition* d, d_order )
+    {
+        out << d->d_tok.d_val.toStr() << opSuffix( d->d_tok ) << " ::=";
+        if( d->d_node )
+        {
+            out << " ";
+            writeEbnf( out, d->d_node );
+        }
+        out << endl;
+    }
+}
+
+void EbnfSyntax::writeEbnf(QTextStream& out, const Ast::Node* node, const Ast::Node* parent)
+{
+    // parentheses only where the parser would build a different tree without them; brackets
+    // enclose a whole expression
+    bool group = false;
+    switch( node->d_quant )
+    {
+    case Ast::Node::One:
+        group = parent != 0 && ( node->d_type == Ast::Node::Alternative ||
+                ( node->d_type == Ast::Node::Sequence && parent->d_type == Ast::Node::Sequence ) );
+        if( group )
+            out << "( ";
+        break;
+    case Ast::Node::ZeroOrOne:
+        out << "[ ";
+        break;
+    case Ast::Node::ZeroOrMore:
+        out << "{ ";
+        break;
+    }
+
+    switch( node->d_type )
+    {
+    case Ast::Node::Terminal:
+        if( node->d_literal )
+        {
+            QString str = node->d_tok.d_val.toStr();
+            str.replace( "\\", "\\\\" );
+            str.replace( "'", "\\'" );
+            out << "'" << str << "'";
+        }else
+            out << node->d_tok.d_val.toStr();
+        out << opSuffix( node->d_tok );
+        break;
+    case Ast::Node::Nonterminal:
+        out << node->d_tok.d_val.toStr() << opSuffix( node->d_tok );
+        break;
+    case Ast::Node::Predicate:
+        out << "\\" << node->d_tok.d_val.toStr() << "\\";
+        break;
+    case Ast::Node::Alternative:
+        for( int i = 0; i < node->d_subs.size(); i++ )
+        {
+            if( i != 0 )
+                out << " | ";
+            writeEbnf( out, node->d_subs[i], node );
+        }
+        break;
+    case Ast::Node::Sequence:
+        for( int i = 0; i < node->d_subs.size(); i++ )
+        {
+            if( i != 0 )
+                out << " ";
+            writeEbnf( out, node->d_subs[i], node );
+        }
+        break;
+    }
+
+    switch( node->d_quant )
+    {
+    case Ast::Node::One:
+        if( group )
+            out << " )";
+        break;
+    case Ast::Node::ZeroOrOne:
+        out << " ]";
+        break;
+    case Ast::Node::ZeroOrMore:
+        out << " }";
+        break;
+    }
+}
+
 void EbnfSyntax::clear()
 {
     foreach( Ast::Definition* d, d_defs )
@@ -117,7 +238,23 @@ void EbnfSyntax::clear()
         delete d;
     d_pragmas.clear();
     d_finished = false;
+    d_resolved = false;
+    d_spliced = false;
+    d_analyzed = false;
     d_idol.clear();
+    d_terms.clear();
+    d_flat.clear();
+    d_byPos.clear();
+    d_backRefs.clear();
+    d_unresolved.clear();
+    d_dirty.clear();
+    d_defIssues.clear();
+    d_recIssues.clear();
+    d_predIssues.clear();
+    d_pragmaIssues.clear();
+    d_laDefs.clear();
+    d_arena.clear();
+    d_garbage = 0;
 }
 
 static bool isTerminalOrSeqOfTerminals( const Ast::Node* n )
@@ -140,10 +277,12 @@ bool EbnfSyntax::addDef(Ast::Definition* d)
     if( d_errs )
         d_errs->resetErrCount();
     d_finished = false;
+    d_resolved = false;
+    d_analyzed = false;
     if( d_defs.contains( d->d_tok.d_val ) )
     {
         error( d_errs, EbnfErrors::Semantics, d->d_tok,
-                           QObject::tr("duplicate production '%1'").arg(d->d_tok.d_val.toStr()) );
+                           EbnfErrors::Msg("duplicate production '%1'").arg(d->d_tok.d_val.toStr()) );
         return false;
     }else
     {
@@ -154,7 +293,7 @@ bool EbnfSyntax::addDef(Ast::Definition* d)
             {
                 if( d_errs )
                     d_errs->warning( EbnfErrors::Semantics, d->d_tok.d_lineNr, d->d_tok.d_colNr,
-                                   QObject::tr("overwriting pragma '%1'").arg(d->d_tok.d_val.toStr()) );
+                                   EbnfErrors::Msg("overwriting pragma '%1'").arg(d->d_tok.d_val.toStr()) );
                 delete def;
             }
             def = d;
@@ -175,13 +314,13 @@ bool EbnfSyntax::addPragma(const EbnfToken& name, Ast::Node* ex)
     {
         if( d_errs )
             d_errs->warning( EbnfErrors::Semantics, name.d_lineNr, name.d_colNr,
-                           QObject::tr("invalid pragma '%1'").arg(name.d_val.toStr()) );
+                           EbnfErrors::Msg("invalid pragma '%1'").arg(name.d_val.toStr()) );
         delete ex;
         return false;
     }
     Ast::Definition*& def = d_pragmas[ name.d_val ];
     if( def == 0 )
-        def = new Ast::Definition(name);
+        def = new( &d_arena ) Ast::Definition(name);
 
     if( def->d_node == 0 )
     {
@@ -191,7 +330,7 @@ bool EbnfSyntax::addPragma(const EbnfToken& name, Ast::Node* ex)
     if( def->d_node->d_type != Ast::Node::Sequence )
     {
         Ast::Node* n = def->d_node;
-        def->d_node = new Ast::Node( Ast::Node::Sequence, def );
+        def->d_node = new( &d_arena ) Ast::Node( Ast::Node::Sequence, def );
         def->d_node->d_subs.append(n);
         n->d_parent = def->d_node;
     }
@@ -221,7 +360,7 @@ const Ast::Definition*EbnfSyntax::getDef(const EbnfToken::Sym& name) const
 
 EbnfSyntax::SymList EbnfSyntax::getPragma(const QByteArray& name) const
 {
-    const Ast::Definition* d = d_pragmas.value( EbnfToken::getSym(name) );
+    const Ast::Definition* d = d_pragmas.value( d_syms->find(name) );
     SymList res;
     if( d && d->d_node )
     {
@@ -250,48 +389,308 @@ void EbnfSyntax::addIdol(qint32 line)
     d_idol.append(line);
 }
 
+static void resetLeftRecursion( Ast::Node* node )
+{
+    node->d_leftRecursive = false;
+    node->d_pathToDef.clear();
+    foreach( Ast::Node* sub, node->d_subs )
+        resetLeftRecursion( sub );
+}
+
+static void resetTermIds( Ast::Node* node )
+{
+    node->d_termId = 0;
+    foreach( Ast::Node* sub, node->d_subs )
+        resetTermIds( sub );
+}
+
+static void resetFacts( Ast::Node* node )
+{
+    node->d_facts = 0;
+    foreach( Ast::Node* sub, node->d_subs )
+        resetFacts( sub );
+}
+
 bool EbnfSyntax::finishSyntax()
 {
     if( d_finished )
         return true;
-    if( !resolveAllSymbols() )
+    TraceSpan span("finishSyntax");
+    const bool incremental = d_spliced && d_analyzed;
+    if( d_spliced && !incremental )
+        resetAnalysis(); // the passes below only reset the flags of the nodes they visit
+    d_spliced = false;
+    d_analyzed = false;
+    if( !d_resolved )
+        resolveAllSymbols();
+    if( !reportSymbols() || !assignTerminalIds() )
+    {
+        if( incremental )
+            resetAnalysis(); // same state as after a full parse
+        d_dirty.clear();
+        d_flat.build( d_order ); // the analyzers still run in EbnfStudio
+        indexSymbols();
         return false;
-    checkReachability();
-    calculateNullable();
-    calcLeftRecursion();
-    checkPragmas();
-    checkPredicates();
+    }
+
+    // the remaining passes report to a buffer so that the entries can be kept by production
+    EbnfErrors* errs = d_errs;
+    EbnfErrors buffer;
+    buffer.setBuffered(true);
+    d_errs = &buffer;
+    if( incremental )
+        updateAnalysis();
+    else
+    {
+        d_defIssues.clear();
+        d_recIssues.clear();
+        d_predIssues.clear();
+        d_pragmaIssues.clear();
+        d_laDefs.clear();
+        checkReachability();
+        calculateNullable( d_order );
+        calcLeftRecursion( d_order );
+        checkPragmas();
+        checkPredicates();
+    }
+    d_errs = errs;
+    if( d_errs )
+    {
+        if( incremental )
+            reportAnalysis();
+        else
+        {
+            foreach( const EbnfErrors::Entry& e, buffer.getBuffer() )
+                d_errs->add( e );
+        }
+    }
+    d_dirty.clear();
+    d_flat.build( d_order );
+    indexSymbols();
+    d_analyzed = true;
     d_finished = true;
     return true;
 }
 
-bool EbnfSyntax::resolveAllSymbols()
+void EbnfSyntax::resetAnalysis()
+{
+    foreach( Ast::Definition* d, d_order )
+    {
+        d->d_nullable = false;
+        d->d_repeatable = false;
+        d->d_directLeftRecursive = false;
+        d->d_indirectLeftRecursive = false;
+        d->d_notReachable = false;
+        if( d->d_node )
+        {
+            resetLeftRecursion( d->d_node );
+            resetTermIds( d->d_node );
+            resetFacts( d->d_node );
+        }
+    }
+    d_terms.clear();
+    d_analyzed = false;
+}
+
+static void collectUsed( Ast::Node* node, EbnfSyntax::OrderedDefs& res )
+{
+    if( node->d_type == Ast::Node::Nonterminal && node->d_def != 0 )
+        res.append( node->d_def );
+    foreach( Ast::Node* sub, node->d_subs )
+        collectUsed( sub, res );
+}
+
+void EbnfSyntax::updateAnalysis()
+{
+    // a production is only reachable through its users, so the changes propagate to the used ones
+    Ast::DefSet reach;
+    OrderedDefs todo = d_dirty.toList();
+    while( !todo.isEmpty() )
+    {
+        Ast::Definition* d = todo.takeLast();
+        if( reach.contains(d) )
+            continue;
+        reach.insert(d);
+        if( d->d_node )
+            collectUsed( d->d_node, todo );
+    }
+    OrderedDefs defs;
+    QList<bool> notReachable;
+    foreach( Ast::Definition* d, d_order )
+    {
+        if( reach.contains(d) )
+        {
+            defs.append(d);
+            notReachable.append(d->d_notReachable);
+            d->d_notReachable = false;
+        }
+    }
+    calcReachability( defs );
+
+    // nullability, left recursion and the diagnostics depend on the used productions, so the
+    // changes propagate to the users
+    Ast::DefSet affected;
+    todo = d_dirty.toList();
+    for( int i = 0; i < defs.size(); i++ )
+    {
+        if( defs[i]->d_notReachable != notReachable[i] )
+            todo.append( defs[i] );
+    }
+    while( !todo.isEmpty() )
+    {
+        Ast::Definition* d = todo.takeLast();
+        if( affected.contains(d) )
+            continue;
+        affected.insert(d);
+        foreach( Ast::Node* n, d->d_usedBy )
+            todo.append( n->d_owner );
+    }
+    defs.clear();
+    foreach( Ast::Definition* d, d_order )
+    {
+        if( affected.contains(d) )
+            defs.append(d);
+    }
+    calculateNullable( defs );
+
+    foreach( Ast::Definition* d, defs )
+    {
+        d_defIssues.remove(d);
+        d_recIssues.remove(d);
+        const int from = d_errs->getBuffer().size();
+        checkContent(d);
+        keepIssues( d_defIssues, d, from );
+    }
+    calcLeftRecursion( defs );
+
+    affected += d_laDefs;
+    foreach( Ast::Definition* d, d_order )
+    {
+        if( affected.contains(d) )
+        {
+            d_predIssues.remove(d);
+            d_laDefs.remove(d);
+            checkPredicates(d);
+        }
+    }
+}
+
+void EbnfSyntax::reportAnalysis()
+{
+    // same order as the passes of the full analysis
+    Q_ASSERT( d_errs != 0 );
+    OrderedDefs notReachable;
+    foreach( Ast::Definition* d, d_order )
+    {
+        if( d->d_notReachable )
+        {
+            notReachable.append(d);
+            d->d_notReachable = false;
+        }
+    }
+    calcReachability( notReachable ); // finds and reports them again, in the order of the full pass
+    foreach( Ast::Definition* d, d_order )
+    {
+        foreach( const EbnfErrors::Entry& e, d_defIssues.value(d) )
+            d_errs->add(e);
+    }
+    foreach( Ast::Definition* d, d_order )
+    {
+        foreach( const EbnfErrors::Entry& e, d_recIssues.value(d) )
+            d_errs->add(e);
+    }
+    foreach( const EbnfErrors::Entry& e, d_pragmaIssues )
+        d_errs->add(e);
+    foreach( Ast::Definition* d, d_order )
+    {
+        foreach( const EbnfErrors::Entry& e, d_predIssues.value(d) )
+            d_errs->add(e);
+    }
+}
+
+void EbnfSyntax::keepIssues(EbnfSyntax::IssueCache& cache, const Ast::Definition* d, int from)
+{
+    const QList<EbnfErrors::Entry>& buf = d_errs->getBuffer();
+    if( from >= buf.size() )
+        return;
+    QList<EbnfErrors::Entry>& l = cache[d];
+    for( int i = from; i < buf.size(); i++ )
+        l.append( buf[i] );
+}
+
+static bool lessInSource( const Ast::Node* lhs, const Ast::Node* rhs )
+{
+    return lhs->d_tok.d_lineNr < rhs->d_tok.d_lineNr ||
+            ( lhs->d_tok.d_lineNr == rhs->d_tok.d_lineNr && lhs->d_tok.d_colNr < rhs->d_tok.d_colNr );
+}
+
+static void insertInSourceOrder( Ast::ConstNodeList& l, const Ast::Node* node )
+{
+    // a full resolution appends in source order, so this is usually the end
+    l.insert( std::upper_bound( l.begin(), l.end(), node, lessInSource ) - l.begin(), node );
+}
+
+void EbnfSyntax::resolveAllSymbols()
 {
-    if( d_errs )
-        d_errs->resetErrCount();
     EbnfSyntax::OrderedDefs::const_iterator i;
     for( i = d_order.begin(); i != d_order.end(); ++i )
 	{
         (*i)->d_usedBy.clear();
 	}
     d_backRefs.clear();
+    d_unresolved.clear();
     for( i = d_order.begin(); i != d_order.end(); ++i )
     {
         Ast::Definition* d = (*i);
         if( d->d_node && !d->doIgnore() )
         {
             //qDebug() << Node::s_typeName[(*i)->d_node->d_type] << (*i)->d_node->d_tok.toString(false);
-            resolveAllSymbols( d->d_node );
+            resolveSymbols( d->d_node );
         }
 	}
+    d_resolved = true;
+}
+
+bool EbnfSyntax::reportSymbols()
+{
+    if( d_errs )
+        d_errs->resetErrCount();
+
+    // same diagnostics in the same order as a walk through all productions, but only the
+    // offending nodes are visited
+    Ast::NodeList hits;
+    Unresolved::const_iterator i;
+    for( i = d_unresolved.begin(); i != d_unresolved.end(); ++i )
+        hits += i.value();
+    foreach( Ast::Definition* d, d_order )
+    {
+        if( d->d_tok.d_op == EbnfToken::Skip ) // d_notReachable could be from a previous analysis
+        {
+            foreach( Ast::Node* n, d->d_usedBy )
+                hits.append(n);
+        }
+    }
+    std::stable_sort( hits.begin(), hits.end(), lessInSource );
+    foreach( Ast::Node* n, hits )
+    {
+        if( n->d_def != 0 )
+            error( d_errs, EbnfErrors::Semantics, n->d_tok,
+                           EbnfErrors::Msg("'%1' uses skipped '%2'").
+                                arg(n->d_owner->d_tok.d_val.toStr()).arg(n->d_def->d_tok.d_val.toStr()) );
+        else
+            error( d_errs, EbnfErrors::Semantics, n->d_tok,
+                           EbnfErrors::Msg("'%1' references unknown '%2'").
+                                arg(n->d_owner->d_tok.d_val.toStr()).arg(n->d_tok.d_val.toStr()) );
+    }
+
     for( int j = 1; j < d_order.size(); j++ ) // ignore first
     {
         Ast::Definition* d = d_order[j];
-        if( !d->doIgnore() && d->d_usedBy.isEmpty() && d->d_node != 0 )
+        if( d->d_tok.d_op != EbnfToken::Skip && d->d_usedBy.isEmpty() && d->d_node != 0 )
         {
             if( d_errs )
                 d_errs->warning( EbnfErrors::Semantics, d->d_tok.d_lineNr, d->d_tok.d_colNr,
-                                 QObject::tr("unused production '%1'").arg(d->d_tok.d_val.c_str() ));
+                                 EbnfErrors::Msg("unused production '%1'").arg(d->d_tok.d_val.c_str() ));
         }
     }
 
@@ -301,32 +700,308 @@ bool EbnfSyntax::resolveAllSymbols()
         return true;
 }
 
-void EbnfSyntax::calculateNullable()
+static bool intersects( const Ast::Node* node, quint32 fromLine, quint32 toLine )
 {
-    // Implement algorithm by a fixed­‐point iteration
+    if( node == 0 )
+        return false;
+    if( node->d_tok.d_lineNr >= fromLine && node->d_tok.d_lineNr < toLine )
+        return true;
+    foreach( const Ast::Node* sub, node->d_subs )
+    {
+        if( intersects( sub, fromLine, toLine ) )
+            return true;
+    }
+    return false;
+}
 
-    foreach( Ast::Definition* d, d_order )
+static void shiftLines( Ast::Node* node, quint32 fromLine, qint32 delta )
+{
+    if( node->d_tok.d_lineNr >= fromLine )
+        node->d_tok.d_lineNr += delta;
+    foreach( Ast::Node* sub, node->d_subs )
+        shiftLines( sub, fromLine, delta );
+}
+
+static quint32 nodeBytes( const Ast::Node* node )
+{
+    quint32 res = sizeof(Ast::Node);
+    foreach( const Ast::Node* sub, node->d_subs )
+        res += nodeBytes( sub );
+    return res;
+}
+
+static void shiftLines( QList<EbnfErrors::Entry>& issues, quint32 fromLine, qint32 delta )
+{
+    for( int i = 0; i < issues.size(); i++ )
     {
-        d->d_nullable = false;
-        d->d_repeatable = false;
+        if( issues[i].d_line >= fromLine )
+            issues[i].d_line += delta;
+    }
+}
+
+bool EbnfSyntax::splice(quint32 fromLine, quint32 toLine, qint32 lineDelta, EbnfSyntax* part)
+{
+    Q_ASSERT( part != 0 && part != this && fromLine <= toLine );
+
+    // the memory of replaced productions is only released with the arena, so start over instead
+    // of letting it grow without bound
+    if( d_garbage > d_arena.getAllocated() / 2 )
+        return false;
+
+    // pragmas are merged by name and change the lexer, so they are not spliced
+    if( !part->d_pragmas.isEmpty() )
+        return false;
+    foreach( const Ast::Definition* d, d_pragmas )
+    {
+        if( ( d->d_tok.d_lineNr >= fromLine && d->d_tok.d_lineNr < toLine ) ||
+                intersects( d->d_node, fromLine, toLine ) )
+            return false;
+    }
+
+    int first = 0;
+    while( first < d_order.size() && d_order[first]->d_tok.d_lineNr < fromLine )
+        first++;
+    int last = first;
+    while( last < d_order.size() && d_order[last]->d_tok.d_lineNr < toLine )
+        last++;
+
+    QSet<EbnfToken::Sym> replaced;
+    for( int i = first; i < last; i++ )
+        replaced.insert( d_order[i]->d_tok.d_val );
+    foreach( const Ast::Definition* d, part->d_order )
+    {
+        if( d_defs.contains( d->d_tok.d_val ) && !replaced.contains( d->d_tok.d_val ) )
+            return false; // let the full parse report the duplicate
+    }
+
+    if( d_resolved )
+    {
+        for( int i = first; i < last; i++ )
+        {
+            if( d_order[i]->d_node )
+                unlinkSymbols( d_order[i]->d_node );
+        }
+        // the remaining references to the replaced productions are unresolved until a new
+        // production with the same name shows up
+        for( int i = first; i < last; i++ )
+        {
+            Ast::Definition* d = d_order[i];
+            foreach( Ast::Node* n, d->d_usedBy )
+            {
+                n->d_def = 0;
+                BackRefs::iterator j = d_backRefs.find( n->d_tok.d_val );
+                Q_ASSERT( j != d_backRefs.end() );
+                j.value().removeOne( n );
+                if( j.value().isEmpty() )
+                    d_backRefs.erase( j );
+                d_unresolved[n->d_tok.d_val].append( n );
+                d_dirty.insert( n->d_owner );
+            }
+        }
+    }
+    for( int i = first; i < last; i++ )
+    {
+        Ast::Definition* d = d_order[i];
+        d_dirty.remove( d );
+        d_defIssues.remove( d );
+        d_recIssues.remove( d );
+        d_predIssues.remove( d );
+        d_laDefs.remove( d );
+        d_defs.remove( d->d_tok.d_val );
+        d_garbage += sizeof(Ast::Definition) + ( d->d_node ? nodeBytes( d->d_node ) : 0 );
+        delete d;
     }
+    d_order.erase( d_order.begin() + first, d_order.begin() + last );
 
-    bool changed;
-    do
+    if( lineDelta != 0 )
     {
-        changed = false;
-        foreach( Ast::Definition* d, d_order )
+        for( int i = first; i < d_order.size(); i++ )
+        {
+            d_order[i]->d_tok.d_lineNr += lineDelta;
+            if( d_order[i]->d_node )
+                shiftLines( d_order[i]->d_node, toLine, lineDelta );
+        }
+        foreach( Ast::Definition* d, d_pragmas )
         {
-            const bool nullable = ( d->d_node == 0 ? false : d->d_node->isNullable() );
-            const bool repeatable = ( d->d_node == 0 ? false : d->d_node->isRepeatable() );
-            if( nullable != d->d_nullable || repeatable != d->d_repeatable )
+            if( d->d_tok.d_lineNr >= toLine )
+                d->d_tok.d_lineNr += lineDelta;
+            if( d->d_node )
+                shiftLines( d->d_node, toLine, lineDelta );
+        }
+        for( int i = 0; i < d_idol.size(); i++ )
+        {
+            if( d_idol[i] >= qint32(toLine) )
+                d_idol[i] += lineDelta;
+        }
+        IssueCache::iterator j;
+        for( j = d_defIssues.begin(); j != d_defIssues.end(); ++j )
+            shiftLines( j.value(), toLine, lineDelta );
+        for( j = d_recIssues.begin(); j != d_recIssues.end(); ++j )
+            shiftLines( j.value(), toLine, lineDelta );
+        for( j = d_predIssues.begin(); j != d_predIssues.end(); ++j )
+            shiftLines( j.value(), toLine, lineDelta );
+        shiftLines( d_pragmaIssues, toLine, lineDelta );
+    }
+
+    for( int i = 0; i < part->d_order.size(); i++ )
+    {
+        Ast::Definition* d = part->d_order[i];
+        d_order.insert( first + i, d );
+        d_defs.insert( d->d_tok.d_val, d );
+        d_dirty.insert( d );
+    }
+    if( d_resolved )
+    {
+        foreach( Ast::Definition* d, part->d_order )
+        {
+            if( d->d_node && !d->doIgnore() )
+                resolveSymbols( d->d_node );
+        }
+        foreach( Ast::Definition* d, part->d_order )
+        {
+            Unresolved::iterator j = d_unresolved.find( d->d_tok.d_val );
+            if( j == d_unresolved.end() )
+                continue;
+            Ast::ConstNodeList& refs = d_backRefs[d->d_tok.d_val];
+            foreach( Ast::Node* n, j.value() )
             {
-                d->d_nullable = nullable;
-                d->d_repeatable = repeatable;
-                changed = true;
+                n->d_def = d;
+                d->d_usedBy.insert( n );
+                insertInSourceOrder( refs, n );
+                d_dirty.insert( n->d_owner );
             }
+            d_unresolved.erase( j );
         }
-    }while( changed );
+    }
+    part->d_order.clear();
+    part->d_defs.clear();
+    d_arena.adopt( part->d_arena );
+    d_flat.clear();
+    d_byPos.clear();
+    d_finished = false;
+    d_spliced = true;
+    return true;
+}
+
+struct _PendingSubs
+{
+    Ast::Node* d_parent;
+    int d_nullable; // number of subs still to become nullable; -1..never
+    int d_repeatable;
+    _PendingSubs( Ast::Node* parent = 0 ):d_parent(parent),d_nullable(-1),d_repeatable(-1){}
+};
+typedef QList< QPair<Ast::Node*,quint8> > _FactList;
+
+static void initFacts( Ast::Node* node, Ast::Node* parent, QHash<Ast::Node*,int>& index,
+                       QVector<_PendingSubs>& pending, _FactList& changed )
+{
+    const int i = pending.size();
+    index.insert( node, i );
+    pending.append( _PendingSubs(parent) );
+    node->d_facts = Ast::Node::Known;
+    int visible = 0;
+    foreach( Ast::Node* sub, node->d_subs )
+    {
+        initFacts( sub, node, index, pending, changed );
+        if( !sub->doIgnore() )
+            visible++;
+    }
+    _PendingSubs& p = pending[i];
+    switch( node->d_type )
+    {
+    case Ast::Node::Nonterminal:
+        if( node->d_def )
+        {
+            // the flags of the productions in the pass are false, the others final
+            p.d_nullable = node->d_def->d_nullable ? 0 : 1;
+            p.d_repeatable = node->d_def->d_repeatable ? 0 : 1;
+        }
+        break;
+    case Ast::Node::Sequence:
+        p.d_nullable = visible;
+        p.d_repeatable = visible == 1 ? 1 : -1;
+        break;
+    case Ast::Node::Alternative:
+        p.d_nullable = visible > 0 ? 1 : -1;
+        p.d_repeatable = visible == 1 ? 1 : -1;
+        break;
+    default:
+        break;
+    }
+    if( node->d_quant != Ast::Node::One )
+        p.d_nullable = 0;
+    if( node->d_quant == Ast::Node::ZeroOrMore )
+        p.d_repeatable = 0;
+    if( p.d_nullable == 0 )
+    {
+        node->d_facts |= Ast::Node::Nullable;
+        changed.append( qMakePair( node, quint8(Ast::Node::Nullable) ) );
+    }
+    if( p.d_repeatable == 0 )
+    {
+        node->d_facts |= Ast::Node::Repeatable;
+        changed.append( qMakePair( node, quint8(Ast::Node::Repeatable) ) );
+    }
+}
+
+static void countDown( Ast::Node* node, quint8 fact, _PendingSubs& p, _FactList& changed )
+{
+    int& count = fact == Ast::Node::Nullable ? p.d_nullable : p.d_repeatable;
+    if( count > 0 && --count == 0 )
+    {
+        node->d_facts |= fact;
+        changed.append( qMakePair( node, fact ) );
+    }
+}
+
+void EbnfSyntax::calculateNullable(const OrderedDefs& defs)
+{
+    // Worklist over the nodes; each node counts the subs (or the production it refers to) which
+    // still have to become nullable resp. repeatable, and gets the fact when the count drops to
+    // zero. A production gets it from its top node and passes it on to its users, so each node
+    // is visited once per fact and the result is cached in the node.
+    // defs has to include all productions using one of defs; the others are final
+
+    foreach( Ast::Definition* d, defs )
+    {
+        d->d_nullable = false;
+        d->d_repeatable = false;
+    }
+
+    QHash<Ast::Node*,int> index;
+    QVector<_PendingSubs> pending;
+    _FactList changed;
+    foreach( Ast::Definition* d, defs )
+    {
+        if( d->d_node )
+            initFacts( d->d_node, 0, index, pending, changed );
+    }
+
+    while( !changed.isEmpty() )
+    {
+        Ast::Node* node = changed.last().first;
+        const quint8 fact = changed.last().second;
+        changed.removeLast();
+        Ast::Node* parent = pending[index.value(node)].d_parent;
+        if( parent )
+        {
+            if( !node->doIgnore() )
+                countDown( parent, fact, pending[index.value(parent)], changed );
+            continue;
+        }
+        Ast::Definition* d = node->d_owner;
+        Q_ASSERT( d->d_node == node );
+        bool& flag = fact == Ast::Node::Nullable ? d->d_nullable : d->d_repeatable;
+        if( flag )
+            continue;
+        flag = true;
+        foreach( Ast::Node* use, d->d_usedBy )
+        {
+            QHash<Ast::Node*,int>::const_iterator i = index.find( use );
+            if( i != index.end() )
+                countDown( use, fact, pending[i.value()], changed );
+        }
+    }
 
     // The computation will terminate because
     // - the variables are only changed monotonically (from false to true)
@@ -344,45 +1019,70 @@ void EbnfSyntax::calculateNullable()
 
 void EbnfSyntax::checkReachability()
 {
-    bool changed;
-    do
+    calcReachability( d_order );
+    foreach( Ast::Definition* d, d_order )
     {
-        changed = false;
-        foreach( Ast::Definition* d, d_order )
-        {
-            if( d->d_usedBy.isEmpty() || d->doIgnore() )
-                continue; // unused already checked
+        const int from = d_errs->getBuffer().size();
+        checkContent(d);
+        keepIssues( d_defIssues, d, from );
+    }
+}
 
-            bool atLeastOneIsReachable = false;
-            foreach( const Ast::Node* n, d->d_usedBy )
-            {
-                if( !n->doIgnore() && !n->d_owner->doIgnore() )
-                {
-                    atLeastOneIsReachable = true;
-                    break;
-                }
-            }
-            const bool notReachable = !atLeastOneIsReachable;
-            // qDebug() << d->d_tok.d_val.c_str() << atLeastOneIsReachable << d->doIgnore() << d->d_notReachable;
-            if( notReachable != d->d_notReachable )
+void EbnfSyntax::calcReachability(const OrderedDefs& defs)
+{
+    // defs has to include all productions used by one of defs; the others are final.
+    // A production counts its reachable uses and becomes not reachable when the last one is in
+    // a production which became not reachable; this only happens once per production.
+    QHash<Ast::Definition*,int> live;
+    QHash<Ast::Definition*,Ast::NodeList> counted; // owner -> the counted uses it contains
+    OrderedDefs todo;
+    foreach( Ast::Definition* d, defs )
+    {
+        if( d->d_usedBy.isEmpty() || d->doIgnore() )
+            continue; // unused already checked
+
+        int count = 0;
+        foreach( Ast::Node* n, d->d_usedBy )
+        {
+            if( !n->doIgnore() && !n->d_owner->doIgnore() )
             {
-                if( d_errs )
-                    d_errs->warning( EbnfErrors::Semantics, d->d_tok.d_lineNr, d->d_tok.d_colNr,
-                                     QObject::tr("production not reachable '%1'").arg(d->d_tok.d_val.c_str() ));
-                changed = true;
-                d->d_notReachable = notReachable;
+                counted[n->d_owner].append(n);
+                count++;
             }
         }
-    }while( changed );
-    foreach( Ast::Definition* d, d_order )
+        live.insert( d, count );
+        if( count == 0 )
+            todo.append( d );
+    }
+    for( int i = 0; i < todo.size(); i++ )
     {
-        if( d->doIgnore() )
-            continue;
-        if( d_errs != 0 && d->d_node != 0 && !d->d_node->isAnyReachable() )
-            d_errs->warning( EbnfErrors::Semantics, d->d_tok.d_lineNr, d->d_tok.d_colNr,
-                             QObject::tr("production has not reachable content '%1'").arg(d->d_tok.d_val.c_str() ));
+        Ast::Definition* d = todo[i];
+        // qDebug() << d->d_tok.d_val.c_str() << "not reachable";
+        reportNotReachable(d);
+        d->d_notReachable = true;
+        foreach( Ast::Node* n, counted.value(d) )
+        {
+            QHash<Ast::Definition*,int>::iterator j = live.find( n->d_def );
+            if( j != live.end() && j.value() > 0 && --j.value() == 0 )
+                todo.append( n->d_def );
+        }
     }
+}
 
+void EbnfSyntax::reportNotReachable(const Ast::Definition* d)
+{
+    if( d_errs )
+        d_errs->warning( EbnfErrors::Semantics, d->d_tok.d_lineNr, d->d_tok.d_colNr,
+                         EbnfErrors::Msg("production not reachable '%1'").arg(d->d_tok.d_val.c_str() ));
+}
+
+void EbnfSyntax::checkContent(const Ast::Definition* d)
+{
+    if( d->doIgnore() )
+        return;
+    if( d_errs != 0 && d->d_node != 0 && !d->d_node->isAnyReachable() )
+        d_errs->warning( EbnfErrors::Semantics, d->d_tok.d_lineNr, d->d_tok.d_colNr,
+                         EbnfErrors::Msg("production has not reachable content '%1'").arg(d->d_tok.d_val.c_str() ));
 }
 
 static inline bool isHit( const Ast::Symbol* sym, quint32 line, quint16 col )
@@ -391,23 +1091,86 @@ static inline bool isHit( const Ast::Symbol* sym, quint32 line, quint16 col )
             sym->d_tok.d_colNr <= col && col <= ( sym->d_tok.d_colNr + sym->d_tok.d_len );
 }
 
+static inline bool posLessThan( const Ast::Symbol* lhs, const Ast::Symbol* rhs )
+{
+    return lhs->d_tok.d_lineNr < rhs->d_tok.d_lineNr ||
+            ( lhs->d_tok.d_lineNr == rhs->d_tok.d_lineNr && lhs->d_tok.d_colNr < rhs->d_tok.d_colNr );
+}
+
+static void indexNodes( QVector<const Ast::Symbol*>& res, const Ast::Node* node )
+{
+    if( node == 0 )
+        return;
+    if( node->d_tok.d_len != 0 ) // terminals, nonterminals and predicates
+        res.append( node );
+    foreach( const Ast::Node* sub, node->d_subs )
+        indexNodes( res, sub );
+}
+
+void EbnfSyntax::indexSymbols()
+{
+    d_byPos.clear();
+    foreach( const Ast::Definition* d, d_order )
+    {
+        d_byPos.append( d );
+        indexNodes( d_byPos, d->d_node );
+    }
+    // stable, so symbols at the same position stay in the order of the former recursive search
+    std::stable_sort( d_byPos.begin(), d_byPos.end(), posLessThan );
+}
+
+int EbnfSyntax::lowerBound(quint32 line, quint16 col) const
+{
+    int lo = 0;
+    int hi = d_byPos.size();
+    while( lo < hi )
+    {
+        const int mid = ( lo + hi ) / 2;
+        const EbnfToken& t = d_byPos[mid]->d_tok;
+        if( t.d_lineNr < line || ( t.d_lineNr == line && t.d_colNr < col ) )
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
 const Ast::Symbol*EbnfSyntax::findSymbolBySourcePos(quint32 line, quint16 col, bool nonTermOnly) const
 {
-    //qDebug() << "find" << line << col;
-    for( int i = d_order.size() - 1; i >= 0; i-- )
+    // the first hit in source order; the end of the token counts as hit
+    for( int i = lowerBound( line, 0 ); i < d_byPos.size(); i++ )
     {
-        if( d_order[i]->d_tok.d_lineNr <= line )
+        const Ast::Symbol* sym = d_byPos[i];
+        if( sym->d_tok.d_lineNr != line || sym->d_tok.d_colNr > col )
+            break;
+        if( !isHit( sym, line, col ) )
+            continue;
+        if( sym->d_tok.d_type == EbnfToken::Production )
         {
-
-            if( !nonTermOnly && isHit( d_order[i], line, col ) )
-                return d_order[i];
-            else
-                return findSymbolBySourcePosImp( d_order[i]->d_node, line, col, nonTermOnly );
+            if( !nonTermOnly )
+                return sym;
+        }else
+        {
+            const Ast::Node* node = static_cast<const Ast::Node*>( sym );
+            if( node->d_type == Ast::Node::Nonterminal || ( !nonTermOnly && node->d_type == Ast::Node::Terminal ) )
+                return sym;
         }
     }
     return 0;
 }
 
+const Ast::Symbol*EbnfSyntax::findSymbolAt(quint32 line, quint16 col) const
+{
+    // tokens don't overlap if the end is excluded, so the last one starting at or before col is the candidate
+    const int i = lowerBound( line, col + 1 ) - 1;
+    if( i < 0 )
+        return 0;
+    const EbnfToken& t = d_byPos[i]->d_tok;
+    if( t.d_lineNr == line && t.d_colNr <= col && col < t.d_colNr + t.d_len )
+        return d_byPos[i];
+    return 0;
+}
+
 Ast::ConstNodeList EbnfSyntax::getBackRefs(const Ast::Symbol* sym) const
 {
     if( sym == 0 )
@@ -468,7 +1231,7 @@ const Ast::Node*EbnfSyntax::firstPredicateOf(const Ast::Node* node)
     return 0;
 }
 
-bool EbnfSyntax::resolveAllSymbols(Ast::Node *node)
+void EbnfSyntax::resolveSymbols(Ast::Node *node)
 {
 	Q_ASSERT( node->d_owner != 0 );
     switch( node->d_type )
@@ -481,128 +1244,77 @@ bool EbnfSyntax::resolveAllSymbols(Ast::Node *node)
                 Ast::Definition* def = i.value();
                 def->d_usedBy.insert(node);
                 node->d_def = def;
-                d_backRefs[node->d_tok.d_val].append(node);
-                if( def->doIgnore() )
-                    error( d_errs, EbnfErrors::Semantics, node->d_tok,
-                                   QObject::tr("'%1' uses skipped '%2'").
-                                        arg(node->d_owner->d_tok.d_val.toStr()).arg(def->d_tok.d_val.toStr()) );
+                insertInSourceOrder( d_backRefs[node->d_tok.d_val], node );
+                d_dirty.insert(def);
             }else
             {
-                error( d_errs, EbnfErrors::Semantics, node->d_tok,
-                                   QObject::tr("'%1' references unknown '%2'").
-                                        arg(node->d_owner->d_tok.d_val.toStr()).arg(node->d_tok.d_val.toStr()) );
+                node->d_def = 0;
+                d_unresolved[node->d_tok.d_val].append(node);
             }
         }
         break;
     case Ast::Node::Terminal:
     case Ast::Node::Predicate:
-        d_backRefs[node->d_tok.d_val].append(node);
+        insertInSourceOrder( d_backRefs[node->d_tok.d_val], node );
         break;
     default:
         break;
     }
     foreach( Ast::Node* sub, node->d_subs )
     {
-        resolveAllSymbols( sub );
+        resolveSymbols( sub );
     }
-    if( d_errs )
-        return d_errs->getErrCount() == 0;
-    else
-        return true;
-}
-
-const Ast::Symbol*EbnfSyntax::findSymbolBySourcePosImp(const Ast::Node* node, quint32 line, quint16 col, bool nonTermOnly) const
-{
-    if( node == 0 )
-        return 0;
-    if( node->d_tok.d_lineNr > line )
-        return 0;
-    //qDebug() << "Node" << node->d_tok.toString() << node->d_tok.d_lineNr << node->d_tok.d_colNr << node->d_tok.d_len;
-    if( node->d_type == Ast::Node::Terminal && !nonTermOnly && isHit( node, line, col ) )
-        return node;
-    else if( node->d_type == Ast::Node::Nonterminal && isHit( node, line, col ) )
-        return node;
-    // else
-    foreach( const Ast::Node* n, node->d_subs )
-    {
-        // TODO: binary search falls nötig
-        const Ast::Symbol* res = findSymbolBySourcePosImp( n, line, col, nonTermOnly );
-        if( res )
-            return res;
-    }
-    return 0;
 }
 
-void EbnfSyntax::calcLeftRecursion()
+void EbnfSyntax::unlinkSymbols(Ast::Node* node)
 {
-    foreach( Ast::Definition* d, d_order )
-    {
-        d->d_directLeftRecursive = false;
-        d->d_indirectLeftRecursive = false;
-        if( d->doIgnore() || d->d_node == 0 )
-            continue;
-        Ast::NodeList path;
-        markLeftRecursion(d,d->d_node,path);
-    }
-    /*
-    QList< QPair<Node,NodeSet> > startsWith;
-    foreach( Definition* d, d_order )
+    switch( node->d_type )
     {
-        d->d_directLeftRecursive = false;
-        if( d->doIgnore() || d->d_node == 0 )
-            continue;
-        startsWith << qMakePair( Node(Node::Nonterminal,d,d->d_tok), calcStartsWithNtSet(d->d_node) );
-        NodeSet::iterator i = startsWith.last().second.find(&startsWith.last().first);
-        if( i != startsWith.last().second.end() )
+    case Ast::Node::Nonterminal:
+        if( node->d_def == 0 )
         {
-            const_cast<Node*>((*i).d_node)->d_leftRecursive = true;
-            startsWith.last().first.d_owner->d_directLeftRecursive = true;
-            qDebug() << "direct left recursion" << startsWith.last().first.d_owner->d_tok.d_val;
-            startsWith.last().second.erase(i);
+            Unresolved::iterator i = d_unresolved.find( node->d_tok.d_val );
+            if( i != d_unresolved.end() )
+            {
+                i.value().removeOne(node);
+                if( i.value().isEmpty() )
+                    d_unresolved.erase(i);
+            }
+            break;
         }
-    }
-    */
-
-    /*
-    bool changed;
-    do
-    {
-        changed = false;
-        foreach( Definition* d, d_order )
+        node->d_def->d_usedBy.remove(node);
+        d_dirty.insert(node->d_def);
+        node->d_def = 0;
+        // fall through
+    case Ast::Node::Terminal:
+    case Ast::Node::Predicate:
         {
-            const bool nullable = ( d->d_node == 0 ? false : d->d_node->isNullable() );
-            const bool repeatable = ( d->d_node == 0 ? false : d->d_node->isRepeatable() );
-            if( nullable != d->d_nullable || repeatable != d->d_repeatable )
+            BackRefs::iterator i = d_backRefs.find( node->d_tok.d_val );
+            if( i != d_backRefs.end() )
             {
-                d->d_nullable = nullable;
-                d->d_repeatable = repeatable;
-                changed = true;
+                i.value().removeOne(node);
+                if( i.value().isEmpty() )
+                    d_backRefs.erase(i);
             }
         }
-    }while( changed );
-    */
-
+        break;
+    default:
+        break;
+    }
+    foreach( Ast::Node* sub, node->d_subs )
+        unlinkSymbols( sub );
 }
 
-void EbnfSyntax::markLeftRecursion(Ast::Definition* start, Ast::Node* cur, Ast::NodeList& path)
+// the references a production can start with, i.e. the edges of the starts-with graph
+static void collectLeftCorner( Ast::Node* cur, Ast::NodeList& res )
 {
     if( cur == 0 || cur->doIgnore() )
         return;
-
-    if( cur->d_owner == start )
-    {
-        cur->d_pathToDef.clear();
-        cur->d_leftRecursive = false;
-    }
     switch( cur->d_type )
     {
     case Ast::Node::Alternative:
         foreach( Ast::Node* sub, cur->d_subs )
-        {
-            if( sub->doIgnore() )
-                continue;
-            markLeftRecursion(start,sub,path);
-        }
+            collectLeftCorner(sub,res);
         break;
     case Ast::Node::Sequence:
         foreach( Ast::Node* sub, cur->d_subs )
@@ -610,57 +1322,144 @@ void EbnfSyntax::markLeftRecursion(Ast::Definition* start, Ast::Node* cur, Ast::
             if( sub->doIgnore() )
                 continue;
             // gehe bis zum ersten das nicht optional ist; diese alle sind potentielle Starts
-            markLeftRecursion(start,sub,path);
+            collectLeftCorner(sub,res);
             if( !sub->isNullable() )
                 break;
         }
         break;
     case Ast::Node::Nonterminal:
-        if( !cur->doIgnore() && cur->d_def != 0 && cur->d_def->d_node != 0 )
+        if( cur->d_def != 0 && cur->d_def->d_node != 0 )
+            res.append(cur);
+        break;
+    case Ast::Node::Terminal:
+    case Ast::Node::Predicate:
+        // ignore
+        break;
+    }
+}
+
+void EbnfSyntax::calcLeftRecursion(const OrderedDefs& defs)
+{
+    // A production is left recursive iff it is in a cyclic component of the starts-with graph.
+    // defs is closed under the users of its members, so each component is complete.
+    const int n = defs.size();
+    QHash<Ast::Definition*,int> index;
+    for( int i = 0; i < n; i++ )
+        index.insert( defs[i], i );
+    QVector<Ast::NodeList> corner(n);
+    SccGraph g(n);
+    for( int i = 0; i < n; i++ )
+    {
+        Ast::Definition* d = defs[i];
+        d->d_directLeftRecursive = false;
+        d->d_indirectLeftRecursive = false;
+        if( d->d_node == 0 )
+            continue;
+        resetLeftRecursion( d->d_node );
+        collectLeftCorner( d->d_node, corner[i] );
+        foreach( Ast::Node* ref, corner[i] )
         {
-            if( cur->d_def == start )
+            const int to = index.value( ref->d_def, -1 );
+            if( to != -1 )
+                g.addEdge( i, to );
+        }
+    }
+    g.calcComponents();
+
+    // one path per component member to and from the first member, the representative; the
+    // recursive references to a production are reported with a cycle through the representative
+    QVector<Ast::NodeList> hits(n); // referenced production -> recursive references
+    QVector<Ast::Node*> toRep(n,0), fromRep(n,0);
+    QVector<int> nextToRep(n,-1), prevFromRep(n,-1);
+    const QList< QVector<int> >& comps = g.getComponents();
+    for( int c = 0; c < comps.size(); c++ )
+    {
+        if( !g.isCyclic(c) )
+            continue;
+        const QVector<int>& comp = comps[c];
+        QHash<int,Ast::NodeList> incoming;
+        foreach( int v, comp )
+        {
+            foreach( Ast::Node* ref, corner[v] )
             {
-                if( cur->d_owner == start )
-                    start->d_directLeftRecursive = true;
-                else
-                    start->d_indirectLeftRecursive = true;
-                cur->d_leftRecursive = true;
-                cur->d_pathToDef = path;
-                if( d_errs )
+                const int to = index.value( ref->d_def, -1 );
+                if( to != -1 && g.getComponentOf(to) == c )
                 {
-                    Ast::ConstNodeList l;
-                    foreach( Ast::Node* n, path )
-                        l.append(n);
-                    d_errs->error( EbnfErrors::Semantics, cur->d_tok.d_lineNr, cur->d_tok.d_colNr,
-                                   QString("%1 left recursion with '%2'").
-                                   arg(start->d_directLeftRecursive?"direct":"indirect").arg(start->d_tok.d_val.toStr()),
-                                   QVariant::fromValue(EbnfSyntax::IssueData(
-                                                           EbnfSyntax::IssueData::LeftRec,start->d_node, cur,l)));
+                    hits[to].append(ref);
+                    incoming[to].append(ref);
                 }
-            }else
+            }
+        }
+        const int rep = comp.first();
+        QList<int> todo;
+        todo << rep;
+        prevFromRep[rep] = rep;
+        while( !todo.isEmpty() )
+        {
+            const int v = todo.takeFirst();
+            foreach( Ast::Node* ref, corner[v] )
+            {
+                const int to = index.value( ref->d_def, -1 );
+                if( to == -1 || g.getComponentOf(to) != c || prevFromRep[to] != -1 )
+                    continue;
+                prevFromRep[to] = v;
+                fromRep[to] = ref;
+                todo << to;
+            }
+        }
+        todo << rep;
+        nextToRep[rep] = rep;
+        while( !todo.isEmpty() )
+        {
+            const int v = todo.takeFirst();
+            foreach( Ast::Node* ref, incoming.value(v) )
+            {
+                const int from = index.value( ref->d_owner );
+                if( nextToRep[from] != -1 )
+                    continue;
+                nextToRep[from] = v;
+                toRep[from] = ref;
+                todo << from;
+            }
+        }
+    }
+
+    for( int i = 0; i < n; i++ )
+    {
+        Ast::Definition* start = defs[i];
+        if( start->doIgnore() || start->d_node == 0 || hits[i].isEmpty() )
+            continue;
+        const int from = d_errs ? d_errs->getBuffer().size() : 0;
+        Ast::NodeList head;
+        for( int v = i; v != nextToRep[v]; v = nextToRep[v] )
+            head.append( toRep[v] );
+        foreach( Ast::Node* cur, hits[i] )
+        {
+            Ast::NodeList path = head;
+            const int pos = path.size();
+            for( int v = index.value( cur->d_owner ); v != prevFromRep[v]; v = prevFromRep[v] )
+                path.insert( pos, fromRep[v] );
+            const bool direct = cur->d_owner == start;
+            if( direct )
+                start->d_directLeftRecursive = true;
+            else
+                start->d_indirectLeftRecursive = true;
+            cur->d_leftRecursive = true;
+            cur->d_pathToDef = path;
+            if( d_errs )
             {
-                bool recursion = false;
+                Ast::ConstNodeList l;
                 foreach( Ast::Node* n, path )
-                {
-                    if( n == cur || n->d_def == cur->d_def )
-                    {
-                        recursion = true;
-                        break;
-                    }
-                }
-                if( !recursion )
-                {
-                    path.push_back(cur);
-                    markLeftRecursion(start,cur->d_def->d_node,path);
-                    path.pop_back();
-                }
+                    l.append(n);
+                d_errs->error( EbnfErrors::Semantics, cur->d_tok.d_lineNr, cur->d_tok.d_colNr,
+                               EbnfErrors::Msg("%1 left recursion with '%2'").
+                               arg(direct?"direct":"indirect").arg(start->d_tok.d_val.toStr()),
+                               QVariant::fromValue(EbnfSyntax::IssueData(
+                                                       EbnfSyntax::IssueData::LeftRec,start->d_node, cur,l)));
             }
         }
-        break;
-    case Ast::Node::Terminal:
-    case Ast::Node::Predicate:
-        // ignore
-        break;
+        if( d_errs )
+            keepIssues( d_recIssues, start, from );
     }
 }
 
@@ -668,14 +1467,16 @@ void EbnfSyntax::checkPragmas()
 {
     if( d_errs == 0 )
         return;
+    const int from = d_errs->getBuffer().size();
     foreach( const Ast::Definition* d, d_pragmas )
     {
         if( !isTerminalOrSeqOfTerminals( d->d_node ) )
         {
             d_errs->error( EbnfErrors::Semantics, d->d_tok.d_lineNr, d->d_tok.d_colNr,
-                           QObject::tr("right hand side of pragma '%1' must be a sequence of (non)terminals").arg(d->d_tok.d_val.toStr()) );
+                           EbnfErrors::Msg("right hand side of pragma '%1' must be a sequence of (non)terminals").arg(d->d_tok.d_val.toStr()) );
         }
     }
+    d_pragmaIssues = d_errs->getBuffer().mid(from);
 }
 
 Ast::NodeRefSet EbnfSyntax::calcStartsWithNtSet(Ast::Node* node)
@@ -723,32 +1524,35 @@ Ast::NodeRefSet EbnfSyntax::calcStartsWithNtSet(Ast::Node* node)
 
 void EbnfSyntax::checkPredicates()
 {
-    if( d_errs == 0 )
+    foreach( Ast::Definition* d, d_order )
+        checkPredicates(d);
+}
+
+void EbnfSyntax::checkPredicates(Ast::Definition* d)
+{
+    if( d_errs == 0 || d->doIgnore() || d->d_node == 0 )
         return;
-    foreach( const Ast::Definition* d, d_defs )
-    {
-        if( !d->doIgnore() && d->d_node != 0 )
-            checkPredicates(d->d_node);
-    }
+    const int from = d_errs->getBuffer().size();
+    checkPredicates(d->d_node);
+    keepIssues( d_predIssues, d, from );
 }
 
 static bool checkLaAst( EbnfSyntax* syn, LaParser::Ast* ast, const EbnfToken& tok )
 {
     if( ast->d_type == LaParser::Ast::Ident )
     {
-        const EbnfToken::Sym sym = EbnfToken::getSym(ast->d_val);
-        if( syn->getKeywords().contains(sym) )
+        if( syn->getKeywords().contains(ast->d_val) )
             return true;
-        const Ast::Definition* d = syn->getDef(sym);
+        const Ast::Definition* d = syn->getDef( syn->getSymbols()->find(ast->d_val) );
         if( d == 0 )
             return error( syn->getErrs(), EbnfErrors::Semantics, tok,
-                          QString("unknown terminal '%1'").arg(ast->d_val.constData()) );
+                          EbnfErrors::Msg("unknown terminal '%1'").arg(ast->d_val.constData()) );
         if( d->d_node != 0 )
             return error( syn->getErrs(), EbnfErrors::Semantics, tok,
-                          QString("symbol '%1' is not a terminal").arg(ast->d_val.constData()) );
+                          EbnfErrors::Msg("symbol '%1' is not a terminal").arg(ast->d_val.constData()) );
         if( d->doIgnore() )
             return error( syn->getErrs(), EbnfErrors::Semantics, tok,
-                          QString("referencing skipped terminal '%1'").arg(ast->d_val.constData()) );
+                          EbnfErrors::Msg("referencing skipped terminal '%1'").arg(ast->d_val.constData()) );
     }else
     {
         foreach( LaParser::AstRef sub, ast->d_subs )
@@ -768,7 +1572,7 @@ void EbnfSyntax::checkPredicates(Ast::Node* node)
             bool ok;
             const quint32 p = val.mid(3).trimmed().toUInt(&ok);
             if( !ok || p < 1 )
-                error( d_errs, EbnfErrors::Semantics, node->d_tok, "invalid LL predicate" );
+                error( d_errs, EbnfErrors::Semantics, node->d_tok, EbnfErrors::Msg("invalid LL predicate") );
         }else if( val.startsWith("LL(") )
         {
             if( val.endsWith(')') )
@@ -778,27 +1582,66 @@ void EbnfSyntax::checkPredicates(Ast::Node* node)
                 if( ok && p >= 1)
                     return;
             }
-            error( d_errs, EbnfErrors::Semantics, node->d_tok, "invalid LL predicate" );
+            error( d_errs, EbnfErrors::Semantics, node->d_tok, EbnfErrors::Msg("invalid LL predicate") );
         }else if( val.startsWith("LA:") )
         {
+            d_laDefs.insert( node->d_owner );
             LaParser p;
             bool res = p.parse(val.mid(3));
 //            if( p.getLaExpr().constData() )
 //                p.getLaExpr()->dump();
             if( !res )
-                error( d_errs, EbnfErrors::Syntax, node->d_tok, QString("invalid LA predicate: %1").arg(p.getErr()) );
+                error( d_errs, EbnfErrors::Syntax, node->d_tok, EbnfErrors::Msg("invalid LA predicate: %1").arg(p.getErr()) );
             else
             {
                 Q_ASSERT( p.getLaExpr().constData() != 0 );
                 checkLaAst( this, p.getLaExpr().data(), node->d_tok );
             }
         }else
-            error( d_errs, EbnfErrors::Syntax, node->d_tok, "unknown predicate" );
+            error( d_errs, EbnfErrors::Syntax, node->d_tok, EbnfErrors::Msg("unknown predicate") );
     }else
         foreach( Ast::Node* sub, node->d_subs )
             checkPredicates(sub);
 }
 
+bool EbnfSyntax::assignTerminalIds()
+{
+    // Alle Terminals mit demselben Symbol erhalten dieselbe Id; der erste Node steht für das Symbol
+    d_terms.clear();
+    d_terms.append(0); // id 0 is not used
+    QHash<EbnfToken::Sym,quint16> ids;
+    foreach( Ast::Definition* d, d_order )
+    {
+        if( d->d_node )
+            assignTerminalIds( d->d_node, ids );
+    }
+    if( ids.size() >= d_terms.size() ) // some symbols got no id
+    {
+        error( d_errs, EbnfErrors::Semantics, d_order.first()->d_tok,
+               EbnfErrors::Msg("grammar has more than %1 distinct terminals").arg(0xffff) );
+        return false;
+    }
+    return true;
+}
+
+void EbnfSyntax::assignTerminalIds(Ast::Node* node, QHash<EbnfToken::Sym, quint16>& ids)
+{
+    node->d_termId = 0;
+    if( node->d_type == Ast::Node::Terminal ||
+            ( node->d_type == Ast::Node::Nonterminal && ( node->d_def == 0 || node->d_def->d_node == 0 ) ) )
+    {
+        quint16& id = ids[node->d_tok.d_val];
+        if( id == 0 && d_terms.size() <= 0xffff )
+        {
+            id = d_terms.size();
+            d_terms.append(node);
+        }
+        node->d_termId = id;
+    }
+    foreach( Ast::Node* sub, node->d_subs )
+        assignTerminalIds( sub, ids );
+}
+
 bool Ast::Definition::doIgnore() const
 {
     return d_tok.d_op == EbnfToken::Skip || d_notReachable;
@@ -827,6 +1670,8 @@ bool Ast::Node::doIgnore() const
 
 bool Ast::Node::isNullable() const
 {
+    if( d_facts & Known )
+        return d_facts & Nullable;
     if( d_quant != One )
         return true;
     switch( d_type )
@@ -862,6 +1707,8 @@ bool Ast::Node::isNullable() const
 
 bool Ast::Node::isRepeatable() const
 {
+    if( d_facts & Known )
+        return d_facts & Repeatable;
     if( d_quant == ZeroOrMore )
         return true;
 
@@ -1044,3 +1891,38 @@ Ast::Definition::~Definition()
 {
     if( d_node ) delete d_node;
 }
+
+// every symbol is preceded by a word telling where it was allocated
+enum { HeapSymbol = 0, ArenaSymbol = 1 };
+static const size_t s_symHeader = 8;
+
+void* Ast::Symbol::operator new(size_t size)
+{
+    char* p = (char*)::malloc( size + s_symHeader );
+    Q_CHECK_PTR( p );
+    *(quint8*)p = HeapSymbol;
+    return p + s_symHeader;
+}
+
+void* Ast::Symbol::operator new(size_t size, AstArena* arena)
+{
+    Q_ASSERT( arena != 0 );
+    char* p = (char*)arena->allocate( size + s_symHeader );
+    *(quint8*)p = ArenaSymbol;
+    return p + s_symHeader;
+}
+
+void Ast::Symbol::operator delete(void* ptr)
+{
+    if( ptr == 0 )
+        return;
+    char* p = (char*)ptr - s_symHeader;
+    if( *(quint8*)p == HeapSymbol )
+        ::free( p );
+}
+
+void Ast::Symbol::operator delete(void* ptr, AstArena*)
+{
+    // only called if a constructor throws
+    Q_UNUSED(ptr);
+}
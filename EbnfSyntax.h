@@ -26,8 +26,12 @@
 #include <QSet>
 #include <QVariant>
 #include "EbnfToken.h"
+#include "EbnfErrors.h"
+#include "AstArena.h"
+#include "FlatSyntax.h"
+#include "SymbolTable.h"
 
-class EbnfErrors;
+class QTextStream;
 
 namespace Ast
 {
@@ -45,6 +49,13 @@ namespace Ast
         virtual bool isNullable() const { return false; }
         virtual bool isRepeatable() const { return false; }
         virtual bool isAnyReachable() const { return true; }
+
+        // new(syn->getArena()) allocates in the arena of the syntax, where delete only runs the
+        // destructor; plain new allocates on the heap as usual
+        static void* operator new( size_t );
+        static void* operator new( size_t, AstArena* );
+        static void operator delete( void* );
+        static void operator delete( void*, AstArena* );
     };
 
     struct Definition : public Symbol
@@ -69,6 +80,7 @@ namespace Ast
     {
         enum Type { Terminal, Nonterminal, Sequence, Alternative, Predicate };
         enum Quantity { One, ZeroOrOne, ZeroOrMore };
+        enum Fact { Known = 1, Nullable = 2, Repeatable = 4 };
         static const char* s_typeName[];
     #ifdef _DEBUG
         Type d_type;
@@ -79,15 +91,19 @@ namespace Ast
     #endif
         bool d_leftRecursive;
         bool d_literal;
+        quint8 d_facts; // cached by EbnfSyntax::finishSyntax; isNullable and isRepeatable if Known
+        quint16 d_termId; // dense id of the terminal symbol, assigned by finishSyntax; 0..no terminal
+        qint32 d_flatId; // index in EbnfSyntax::getFlat, assigned by finishSyntax
         NodeList d_subs; // owned
         NodeList d_pathToDef;
         Definition* d_owner;
         Definition* d_def; // resolved nonterminal
         Node* d_parent; // TODO: ev. unnötig; man kann damit bottom up über Sequence hinweg schauen
         Node(Type t, Definition* d, const EbnfToken& tok = EbnfToken(), bool lit = false):Symbol(tok),d_type(t),
-            d_quant(One),d_owner(d),d_def(0),d_parent(0),d_leftRecursive(false),d_literal(lit){}
+            d_quant(One),d_owner(d),d_def(0),d_parent(0),d_leftRecursive(false),d_literal(lit),d_facts(0),d_termId(0),d_flatId(-1){}
         Node(Type t, Node* parent, const EbnfToken& tok = EbnfToken()):Symbol(tok),d_type(t),
-            d_quant(One),d_owner(parent->d_owner),d_def(0),d_parent(parent),d_leftRecursive(false){ parent->d_subs.append(this); }
+            d_quant(One),d_owner(parent->d_owner),d_def(0),d_parent(parent),d_leftRecursive(false),
+            d_literal(false),d_facts(0),d_termId(0),d_flatId(-1){ parent->d_subs.append(this); }
         ~Node();
         bool doIgnore() const;
         bool isNullable() const;
@@ -144,7 +160,7 @@ class EbnfSyntax : public QSharedData
 public:
     typedef QList<qint32> IfDefOutList; // Jeder Eintrag ist die Zeile der Änderung. Start bei On.
     typedef QSet<EbnfToken::Sym> Defines;
-    typedef QSet<EbnfToken::Sym> Keywords;
+    typedef QSet<QByteArray> Keywords;
 
     struct IssueData
     {
@@ -161,6 +177,7 @@ public:
 
     void clear();
     EbnfErrors* getErrs() const { return d_errs; }
+    void setErrs( EbnfErrors* errs ) { d_errs = errs; }
 
     typedef QHash<EbnfToken::Sym,Ast::Definition*> Definitions;
     typedef QList<Ast::Definition*> OrderedDefs;
@@ -168,6 +185,10 @@ public:
 
     bool addDef( Ast::Definition* ); // transfer ownership
     bool addPragma(const EbnfToken& name, Ast::Node* ); // transfer ownership
+    AstArena* getArena() { return &d_arena; }
+    // the names and values of all tokens of the syntax; shared with the lexer during parsing
+    SymbolTable* getSymbols() const { return d_syms.data(); }
+    void setSymbols( SymbolTable* syms ) { d_syms = syms; }
     const Definitions& getDefs() const { return d_defs; }
     const Ast::Definition* getDef(const EbnfToken::Sym& name ) const;
     const OrderedDefs& getOrderedDefs() const { return d_order; }
@@ -181,9 +202,27 @@ public:
     void setKeywords( const Keywords& kw ) { d_kw = kw; }
     const Keywords& getKeywords() const { return d_kw; }
 
+    // After a splice only the productions depending on the changed ones are analyzed again; the
+    // diagnostics of the others are reported from the previous run.
     bool finishSyntax();
 
+    // Replaces the productions starting in lines fromLine..toLine-1 by the ones of part, which was
+    // parsed from the corresponding lines of the edited text, and moves the following lines by
+    // lineDelta; only the symbols of the replaced productions and the references to their names are
+    // resolved again. Returns false without changes if the result could differ from a full parse
+    // (pragmas, duplicate names) or if the arena holds too many replaced productions; part is empty
+    // afterwards. finishSyntax must be called again.
+    bool splice( quint32 fromLine, quint32 toLine, qint32 lineDelta, EbnfSyntax* part );
+
+    // terminals and pseudo terminals (productions without body) by Node::d_termId; valid after finishSyntax
+    const Ast::Node* getTerminal( quint16 id ) const { return d_terms.value(id); }
+    int getTerminalCount() const { return d_terms.size() - 1; } // id 0 is not used
+    // the productions as arrays, for the analyzers and generators; valid after finishSyntax
+    const FlatSyntax& getFlat() const { return d_flat; }
+
+    // binary search in an index of the symbols by position; valid after finishSyntax
     const Ast::Symbol* findSymbolBySourcePos( quint32 line, quint16 col , bool nonTermOnly = true ) const;
+    const Ast::Symbol* findSymbolAt( quint32 line, quint16 col ) const; // any symbol, end of token excluded
     Ast::ConstNodeList getBackRefs( const Ast::Symbol* ) const;
     static const Ast::Node* firstVisibleElementOf( const Ast::Node* );
     static const Ast::Node* firstPredicateOf( const Ast::Node* );
@@ -194,18 +233,36 @@ public:
     static Ast::NodeSet collectNodes( const Ast::NodeRefSet& pattern, const Ast::NodeSet& set );
 
     void dump() const;
+    // writes the pragmas and productions in the notation of the .ebnf files, one per line; comments,
+    // preprocessor lines and the keywords of a .keywords file are not represented, and %keywords is
+    // written with '+=', so the lexer reads its names as keywords
+    void writeEbnf( QTextStream& ) const;
+    static void writeEbnf( QTextStream&, const Ast::Node*, const Ast::Node* parent = 0 );
 protected:
-    bool resolveAllSymbols();
-    void calculateNullable();
+    void resolveAllSymbols();
+    void resolveSymbols( Ast::Node* );
+    void unlinkSymbols( Ast::Node* );
+    bool reportSymbols();
+    void resetAnalysis();
+    void updateAnalysis();
+    void reportAnalysis();
+    void calculateNullable( const OrderedDefs& );
     void checkReachability();
-    bool resolveAllSymbols( Ast::Node *node );
-    const Ast::Symbol* findSymbolBySourcePosImp( const Ast::Node*, quint32 line, quint16 col, bool nonTermOnly ) const;
-    void calcLeftRecursion();
-    void markLeftRecursion( Ast::Definition*,Ast::Node* node, Ast::NodeList& );
+    void calcReachability( const OrderedDefs& );
+    void reportNotReachable( const Ast::Definition* );
+    void checkContent( const Ast::Definition* );
+    void indexSymbols();
+    int lowerBound( quint32 line, quint16 col ) const;
+    void calcLeftRecursion( const OrderedDefs& );
     void checkPragmas();
     Ast::NodeRefSet calcStartsWithNtSet( Ast::Node* node );
     void checkPredicates();
+    void checkPredicates(Ast::Definition*);
     void checkPredicates(Ast::Node* node);
+    bool assignTerminalIds();
+    void assignTerminalIds( Ast::Node*, QHash<EbnfToken::Sym,quint16>& );
+    typedef QHash<const Ast::Definition*,QList<EbnfErrors::Entry> > IssueCache;
+    void keepIssues( IssueCache&, const Ast::Definition*, int from );
 
 private:
     Q_DISABLE_COPY(EbnfSyntax)
@@ -215,10 +272,27 @@ private:
     Definitions d_pragmas;
     Defines d_defines;
     typedef QHash<EbnfToken::Sym,Ast::ConstNodeList> BackRefs;
-    BackRefs d_backRefs;
+    BackRefs d_backRefs; // in source order
+    typedef QHash<EbnfToken::Sym,Ast::NodeList> Unresolved;
+    Unresolved d_unresolved; // nonterminals without definition
     IfDefOutList d_idol;
     Keywords d_kw;
+    Ast::ConstNodeList d_terms;
+    FlatSyntax d_flat;
+    QVector<const Ast::Symbol*> d_byPos; // productions and the nodes with a token, by line and column
     bool d_finished;
+    bool d_resolved; // d_backRefs, d_unresolved and d_usedBy are up to date
+    bool d_spliced; // the analysis flags of the nodes are from a previous finishSyntax
+    bool d_analyzed; // all passes of the previous finishSyntax completed
+    AstArena d_arena;
+    SymbolTableRef d_syms;
+    quint32 d_garbage; // bytes of d_arena used by deleted productions
+    Ast::DefSet d_dirty; // productions changed or with changed references since the last analysis
+    IssueCache d_defIssues; // reachable content by production
+    IssueCache d_recIssues; // left recursion by production
+    IssueCache d_predIssues;
+    QList<EbnfErrors::Entry> d_pragmaIssues;
+    Ast::DefSet d_laDefs; // productions with LA predicates, which refer to productions by name
 };
 
 typedef QExplicitlySharedDataPointer<EbnfSyntax> EbnfSyntaxRef;
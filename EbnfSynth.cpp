@@ -0,0 +1,446 @@
+/*
+* Copyright 2026 Rochus Keller <mailto:me@rochus-keller.ch>
+*
+* This file is part of the EbnfStudio application.
+*
+* The following is the license that applies to this copy of the
+* application. For a license to use the application under conditions
+* other than those described here, please email to me@rochus-keller.ch.
+*
+* GNU General Public License Usage
+* This file may be used under the terms of the GNU General Public
+* License (GPL) versions 2.0 or 3.0 as published by the Free Software
+* Foundation and appearing in the file LICENSE.GPL included in
+* the packaging of this file. Please review the following information
+* to ensure GNU General Public Licensing requirements will be met:
+* http://www.fsf.org/licensing/licenses/info/GPLv2.html and
+* http://www.gnu.org/copyleft/gpl.html.
+*/
+
+// ebnfsynth writes synthetic grammars of any size for scale testing FirstFollowSet, EbnfAnalyzer and
+// EbnfAnalyzer2. The productions are built as an EbnfSyntax and written by EbnfSyntax::writeEbnf.
+// The output is deterministic for a seed. Production 0 is the start; the productions are all
+// reachable, each derives a finite string (the first alternative only refers to productions
+// further down) and there is no left recursion (a reference to a production further up is only
+// placed after a terminal of the same sequence), so the issues reported by ebnfc are ambiguities.
+
+#include "EbnfSyntax.h"
+#include "EbnfVersion.h"
+#include <QCoreApplication>
+#include <QFile>
+#include <QTextStream>
+#include <QtDebug>
+
+struct SynthOptions
+{
+    int d_productions;
+    int d_terminals; // pseudo terminals t0..; only the used ones are declared
+    int d_alternatives; // max alternatives of a production; groups have up to half as many
+    int d_sequence; // max factors of a sequence
+    int d_depth; // max nesting of groups
+    int d_recursion; // length of the cycles of mutually recursive productions; 0..none
+    double d_nullable; // share of the productions with an optional body
+    double d_optional; // probability of a group per factor
+    double d_refs; // probability of a nonterminal per factor
+    double d_conflicts; // probability that an alternative starts with the first terminal of the previous one
+    double d_predicates; // probability that such an alternative starts with an LL(2) predicate
+    quint32 d_seed;
+    SynthOptions():d_productions(100),d_terminals(20),d_alternatives(3),d_sequence(4),d_depth(2),
+        d_recursion(0),d_nullable(0.1),d_optional(0.15),d_refs(0.4),d_conflicts(0.1),d_predicates(0.5),d_seed(1){}
+};
+
+class GrammarSynth
+{
+public:
+    explicit GrammarSynth( const SynthOptions& o ):d_o(o),d_state(o.d_seed ? o.d_seed : 1),d_cur(0),
+        d_forwardOnly(false){}
+    EbnfSyntaxRef generate();
+private:
+    Ast::Node* expression( Ast::Node* parent, int level, bool guarded, bool lone );
+    Ast::Node* term( Ast::Node* parent, int level, bool guarded, bool lone, const Ast::Node* prefix );
+    Ast::Node* factor( Ast::Node* parent, int level, bool guarded, bool lone );
+    Ast::Node* terminal( Ast::Node* parent );
+    Ast::Node* reference( Ast::Node* parent, int target );
+    Ast::Node* node( Ast::Node::Type, Ast::Node* parent, const EbnfToken& tok = EbnfToken() );
+    int pickTarget( bool guarded );
+    void addAlternative( int def, int target, bool guard );
+    void makeReachable();
+    static bool isTerminal( const Ast::Node* );
+    static const Ast::Node* firstTerminal( const Ast::Node* );
+    EbnfToken token( EbnfToken::TokenType, const QByteArray& );
+    quint32 random( quint32 n ); // 0..n-1
+    bool chance( double p ) { return random(1000000) < p * 1000000.0; }
+
+    SynthOptions d_o;
+    EbnfSyntaxRef d_syn;
+    QList<Ast::Definition*> d_defs; // the productions
+    QList< QList<int> > d_pending; // per production the productions it has to refer to
+    QList< QList<int> > d_refs; // per production the productions it refers to
+    QVector<bool> d_usedTerms;
+    quint32 d_state;
+    int d_cur; // the production being generated
+    bool d_forwardOnly; // in the first alternative of d_cur
+};
+
+static const char* s_literals[] = { "+", "-", "*", "/", "(", ")", "[", "]", ",", ";", ":=", ".", 0 };
+
+quint32 GrammarSynth::random(quint32 n)
+{
+    // xorshift32, the same sequence on all platforms
+    d_state ^= d_state << 13;
+    d_state ^= d_state >> 17;
+    d_state ^= d_state << 5;
+    return n == 0 ? 0 : d_state % n;
+}
+
+EbnfToken GrammarSynth::token(EbnfToken::TokenType t, const QByteArray& val)
+{
+    return EbnfToken( t, d_cur + 1, 1, val.size(), d_syn->getSymbols()->intern(val) );
+}
+
+Ast::Node* GrammarSynth::node(Ast::Node::Type t, Ast::Node* parent, const EbnfToken& tok)
+{
+    if( parent == 0 )
+        return new( d_syn->getArena() ) Ast::Node( t, d_defs[d_cur], tok );
+    else
+        return new( d_syn->getArena() ) Ast::Node( t, parent, tok );
+}
+
+EbnfSyntaxRef GrammarSynth::generate()
+{
+    d_syn = new EbnfSyntax();
+    d_defs.clear();
+    d_pending.clear();
+    d_refs.clear();
+    d_usedTerms.fill( false, qMax( 1, d_o.d_terminals ) );
+    const int n = qMax( 1, d_o.d_productions );
+    for( d_cur = 0; d_cur < n; d_cur++ )
+    {
+        d_defs.append( new( d_syn->getArena() ) Ast::Definition( token( EbnfToken::Production,
+                                                                   "N" + QByteArray::number(d_cur) ) ) );
+        d_syn->addDef( d_defs.back() );
+        d_pending.append( QList<int>() );
+        d_refs.append( QList<int>() );
+    }
+    // each production of a cycle refers to the next one, the last one to the first
+    const int r = d_o.d_recursion;
+    for( int first = 1; r > 1 && first + r <= n; first += r )
+    {
+        for( int i = first; i < first + r - 1; i++ )
+            d_pending[i].append( i + 1 );
+        d_pending[first + r - 1].append( first );
+    }
+
+    for( d_cur = 0; d_cur < n; d_cur++ )
+    {
+        Ast::Definition* d = d_defs[d_cur];
+        d->d_node = expression( 0, 0, false, false );
+        if( d_cur != 0 && chance( d_o.d_nullable ) && d->d_node->d_quant == Ast::Node::One )
+            d->d_node->d_quant = chance( 0.5 ) ? Ast::Node::ZeroOrOne : Ast::Node::ZeroOrMore;
+        foreach( int target, d_pending[d_cur] )
+            addAlternative( d_cur, target, target <= d_cur );
+    }
+    makeReachable();
+
+    d_cur = n;
+    for( int i = 0; i < d_usedTerms.size(); i++ )
+    {
+        if( d_usedTerms[i] )
+            d_syn->addDef( new( d_syn->getArena() ) Ast::Definition(
+                               token( EbnfToken::Production, "t" + QByteArray::number(i) ) ) );
+    }
+    EbnfSyntaxRef res = d_syn;
+    d_syn = 0;
+    return res;
+}
+
+Ast::Node* GrammarSynth::expression(Ast::Node* parent, int level, bool guarded, bool lone)
+{
+    const int max = level == 0 ? d_o.d_alternatives : qMax( 1, d_o.d_alternatives / 2 );
+    const int count = 1 + random( qMax( 1, max ) );
+    if( count == 1 )
+    {
+        d_forwardOnly = d_forwardOnly || level == 0;
+        Ast::Node* res = term( parent, level, guarded, lone, 0 );
+        if( level == 0 )
+            d_forwardOnly = false;
+        return res;
+    }
+    Ast::Node* alt = node( Ast::Node::Alternative, parent );
+    const Ast::Node* prev = 0;
+    for( int i = 0; i < count; i++ )
+    {
+        if( level == 0 )
+            d_forwardOnly = i == 0;
+        const Ast::Node* prefix = i != 0 && prev != 0 && chance( d_o.d_conflicts ) ? prev : 0;
+        prev = firstTerminal( term( alt, level, guarded, false, prefix ) );
+    }
+    if( level == 0 )
+        d_forwardOnly = false;
+    return alt;
+}
+
+Ast::Node* GrammarSynth::term(Ast::Node* parent, int level, bool guarded, bool lone, const Ast::Node* prefix)
+{
+    const int len = 1 + random( qMax( 1, d_o.d_sequence ) );
+    const bool pred = prefix != 0 && chance( d_o.d_predicates );
+    if( len == 1 && prefix == 0 )
+        return factor( parent, level, guarded, lone );
+
+    Ast::Node* seq = node( Ast::Node::Sequence, parent );
+    if( pred )
+        node( Ast::Node::Predicate, seq, token( EbnfToken::Predicate, "LL:2" ) );
+    if( prefix )
+    {
+        Ast::Node* t = node( Ast::Node::Type(prefix->d_type), seq, prefix->d_tok );
+        t->d_literal = prefix->d_literal;
+        guarded = true;
+    }
+    for( int i = 0; i < len; i++ )
+    {
+        const Ast::Node* f = factor( seq, level, guarded, false );
+        if( isTerminal( f ) && f->d_quant == Ast::Node::One )
+            guarded = true; // a reference further up after this one is no left recursion
+    }
+    return seq;
+}
+
+Ast::Node* GrammarSynth::factor(Ast::Node* parent, int level, bool guarded, bool lone)
+{
+    // the content of a bracket must not be a bracket itself
+    if( level < d_o.d_depth && !lone && chance( d_o.d_optional ) )
+    {
+        const quint32 kind = random(5);
+        Ast::Node* group = expression( parent, level + 1, guarded, kind < 4 );
+        if( kind < 2 )
+            group->d_quant = Ast::Node::ZeroOrOne;
+        else if( kind < 4 )
+            group->d_quant = Ast::Node::ZeroOrMore;
+        return group;
+    }
+    if( chance( d_o.d_refs ) )
+    {
+        const int target = pickTarget( guarded );
+        if( target != -1 )
+            return reference( parent, target );
+    }
+    return terminal( parent );
+}
+
+int GrammarSynth::pickTarget(bool guarded)
+{
+    const bool backward = guarded && !d_forwardOnly;
+    QList<int>& pending = d_pending[d_cur];
+    for( int i = 0; i < pending.size(); i++ )
+    {
+        if( pending[i] > d_cur || backward )
+            return pending.takeAt(i);
+    }
+    const int n = d_defs.size();
+    if( backward )
+        return random( n );
+    if( d_cur + 1 >= n )
+        return -1;
+    return d_cur + 1 + random( n - d_cur - 1 );
+}
+
+Ast::Node* GrammarSynth::reference(Ast::Node* parent, int target)
+{
+    d_refs[d_cur].append( target );
+    return node( Ast::Node::Nonterminal, parent, token( EbnfToken::NonTerm, "N" + QByteArray::number(target) ) );
+}
+
+Ast::Node* GrammarSynth::terminal(Ast::Node* parent)
+{
+    if( chance( 0.3 ) )
+    {
+        int count = 0;
+        while( s_literals[count] )
+            count++;
+        Ast::Node* t = node( Ast::Node::Terminal, parent, token( EbnfToken::Literal, s_literals[random(count)] ) );
+        t->d_literal = true;
+        return t;
+    }
+    const int i = random( d_usedTerms.size() );
+    d_usedTerms[i] = true;
+    return node( Ast::Node::Nonterminal, parent, token( EbnfToken::NonTerm, "t" + QByteArray::number(i) ) );
+}
+
+bool GrammarSynth::isTerminal(const Ast::Node* n)
+{
+    // literals and references to the pseudo terminals t0..
+    return n->d_type == Ast::Node::Terminal ||
+            ( n->d_type == Ast::Node::Nonterminal && n->d_tok.d_val.c_str()[0] == 't' );
+}
+
+const Ast::Node* GrammarSynth::firstTerminal(const Ast::Node* n)
+{
+    if( n->d_quant != Ast::Node::One )
+        return 0;
+    if( n->d_type == Ast::Node::Sequence )
+    {
+        const int i = n->d_subs.first()->d_type == Ast::Node::Predicate ? 1 : 0;
+        n = n->d_subs[i];
+    }
+    if( n->d_quant == Ast::Node::One && isTerminal( n ) )
+        return n;
+    return 0;
+}
+
+void GrammarSynth::addAlternative(int def, int target, bool guard)
+{
+    const int cur = d_cur;
+    d_cur = def;
+    Ast::Definition* d = d_defs[def];
+    Ast::Node* alt = d->d_node;
+    if( alt->d_type != Ast::Node::Alternative || alt->d_quant != Ast::Node::One )
+    {
+        alt = node( Ast::Node::Alternative, 0 );
+        alt->d_subs.append( d->d_node );
+        d->d_node->d_parent = alt;
+        d->d_node = alt;
+    }
+    if( guard )
+    {
+        Ast::Node* seq = node( Ast::Node::Sequence, alt );
+        terminal( seq );
+        reference( seq, target );
+    }else
+        reference( alt, target );
+    d_cur = cur;
+}
+
+void GrammarSynth::makeReachable()
+{
+    const int n = d_defs.size();
+    QVector<bool> reached( n, false );
+    QList<int> work;
+    for( int i = 0; i < n; i++ )
+    {
+        if( i != 0 && reached[i] )
+            continue;
+        if( i != 0 )
+        {
+            // a production further up which is already reachable refers to this one
+            int from = random( i );
+            while( !reached[from] )
+                from = random( i );
+            addAlternative( from, i, false );
+        }
+        reached[i] = true;
+        work.append( i );
+        while( !work.isEmpty() )
+        {
+            const int cur = work.takeLast();
+            foreach( int to, d_refs[cur] )
+            {
+                if( !reached[to] )
+                {
+                    reached[to] = true;
+                    work.append( to );
+                }
+            }
+        }
+    }
+}
+
+static void writeGrammar( QTextStream& out, const QStringList& args, EbnfSyntax* syn )
+{
+    out << "// generated by ebnfsynth";
+    for( int i = 1; i < args.size(); i++ )
+    {
+        if( args[i] == "-o" )
+            i++;
+        else
+            out << " " << args[i];
+    }
+    out << endl;
+    syn->writeEbnf( out );
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+    a.setOrganizationName("Rochus Keller");
+    a.setOrganizationDomain("github.com/rochus-keller/EbnfStudio");
+    a.setApplicationName("ebnfsynth");
+    a.setApplicationVersion(EBNF_VERSION);
+
+    SynthOptions o;
+    QString outPath;
+    bool ok = true;
+    QStringList args = a.arguments();
+    for( int i = 1; i < args.size(); i++ )
+    {
+        const QString arg = args[ i ];
+        const bool hasValue = i + 1 < args.size();
+        if( ( arg == "-n" || arg == "--productions" ) && hasValue )
+            o.d_productions = qMax( 1, args[ ++i ].toInt() );
+        else if( arg == "--terminals" && hasValue )
+            o.d_terminals = qMax( 1, args[ ++i ].toInt() );
+        else if( arg == "--alternatives" && hasValue )
+            o.d_alternatives = qMax( 1, args[ ++i ].toInt() );
+        else if( arg == "--sequence" && hasValue )
+            o.d_sequence = qMax( 1, args[ ++i ].toInt() );
+        else if( arg == "--depth" && hasValue )
+            o.d_depth = qMax( 0, args[ ++i ].toInt() );
+        else if( arg == "--recursion" && hasValue )
+            o.d_recursion = qMax( 0, args[ ++i ].toInt() );
+        else if( arg == "--nullable" && hasValue )
+            o.d_nullable = args[ ++i ].toDouble();
+        else if( arg == "--optional" && hasValue )
+            o.d_optional = args[ ++i ].toDouble();
+        else if( arg == "--refs" && hasValue )
+            o.d_refs = args[ ++i ].toDouble();
+        else if( arg == "--conflicts" && hasValue )
+            o.d_conflicts = args[ ++i ].toDouble();
+        else if( arg == "--predicates" && hasValue )
+            o.d_predicates = args[ ++i ].toDouble();
+        else if( arg == "--seed" && hasValue )
+            o.d_seed = args[ ++i ].toUInt();
+        else if( arg == "-o" && hasValue )
+            outPath = args[ ++i ];
+        else
+            ok = false;
+    }
+
+    if( !ok )
+    {
+        qCritical() << "usage: ebnfsynth [options] [-o file.ebnf]";
+        qCritical() << "  -n, --productions N   number of productions (default 100)";
+        qCritical() << "      --terminals N     number of pseudo terminals t0.. (default 20)";
+        qCritical() << "      --alternatives N  max alternatives of a production (default 3)";
+        qCritical() << "      --sequence N      max factors of a sequence (default 4)";
+        qCritical() << "      --depth N         max nesting of (), [] and {} (default 2)";
+        qCritical() << "      --recursion N     length of cycles of mutually recursive productions (default 0)";
+        qCritical() << "      --nullable P      share of productions with an optional body (default 0.1)";
+        qCritical() << "      --optional P      probability of a group per factor (default 0.15)";
+        qCritical() << "      --refs P          probability of a nonterminal per factor (default 0.4)";
+        qCritical() << "      --conflicts P     probability that an alternative shares the first terminal";
+        qCritical() << "                        of the previous one (default 0.1)";
+        qCritical() << "      --predicates P    probability that such an alternative gets \\LL:2\\ (default 0.5)";
+        qCritical() << "      --seed N          the same seed and options give the same grammar (default 1)";
+        qCritical() << "writes to stdout without -o";
+        return 1;
+    }
+
+    GrammarSynth synth( o );
+    EbnfSyntaxRef syn = synth.generate();
+
+    if( outPath.isEmpty() )
+    {
+        QTextStream out( stdout );
+        writeGrammar( out, args, syn.data() );
+    }else
+    {
+        QFile file( outPath );
+        if( !file.open( QIODevice::WriteOnly ) )
+        {
+            qCritical() << "cannot write" << outPath;
+            return 1;
+        }
+        QTextStream out( &file );
+        writeGrammar( out, args, syn.data() );
+    }
+    return 0;
+}
@@ -0,0 +1,50 @@
+QT       += core
+QT       -= gui
+
+TARGET = ebnfsynth
+CONFIG   += console
+CONFIG   -= app_bundle
+
+TEMPLATE = app
+
+INCLUDEPATH += ..
+
+CONFIG(debug, debug|release) {
+    DEFINES += _DEBUG
+}
+
+
+
+!win32 {
+    QMAKE_CXXFLAGS += -Wno-reorder -Wno-unused-parameter -Wno-unused-function -Wno-unused-variable -Wno-switch \
+        -Wno-deprecated-declarations -Wno-sign-compare -Wno-parentheses -Wno-unused-parameter -Werror=return-type
+}
+
+SOURCES += \
+    EbnfSynth.cpp \
+    SccGraph.cpp \
+    Tracer.cpp \
+    TermSet.cpp \
+    AstArena.cpp \
+    FlatSyntax.cpp \
+    SymbolTable.cpp \
+    EbnfErrors.cpp \
+    EbnfSyntax.cpp \
+    EbnfToken.cpp \
+    LaParser.cpp
+
+HEADERS += \
+    SccGraph.h \
+    Tracer.h \
+    TermSet.h \
+    AstArena.h \
+    FlatSyntax.h \
+    SymbolTable.h \
+    EbnfErrors.h \
+    EbnfSyntax.h \
+    EbnfToken.h \
+    EbnfVersion.h \
+    LaParser.h
+
+
+
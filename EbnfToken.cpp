@@ -88,14 +88,20 @@ QString EbnfToken::toString(bool labeled) const
     return QByteArray();
 }
 
-QHash<QByteArray,EbnfToken::Sym> EbnfToken::s_symTbl;
+// laid out like the strings of SymbolTable
+static const struct { quint32 d_len; char d_str[1]; } s_empty = { 0, { 0 } };
+
+EbnfToken::Sym EbnfToken::Sym::empty()
+{
+    return Sym( s_empty.d_str );
+}
 
 QByteArray EbnfToken::Sym::toBa() const
 {
     if( d_str == 0 )
         return QByteArray();
     else
-        return QByteArray::fromRawData( d_str, ::strlen(d_str) );
+        return QByteArray::fromRawData( d_str, size() );
 }
 
 QString EbnfToken::Sym::toStr() const
@@ -103,7 +109,7 @@ QString EbnfToken::Sym::toStr() const
     if( d_str == 0 )
         return QString();
     else
-        return QString::fromUtf8( d_str );
+        return QString::fromUtf8( d_str, size() );
 }
 
 const char*EbnfToken::Sym::c_str() const
@@ -114,35 +120,11 @@ const char*EbnfToken::Sym::c_str() const
         return d_str;
 }
 
-int EbnfToken::Sym::size() const
-{
-    if( d_str == 0 )
-        return 0;
-    else
-        return ::strlen(d_str);
-}
-
 bool EbnfToken::Sym::isEmpty() const
 {
     return d_str == 0;
 }
 
-EbnfToken::Sym EbnfToken::getSym(const QByteArray& str)
-{
-    Sym& sym = s_symTbl[str];
-    if( sym.d_str == 0 )
-        sym.d_str = str.constData();
-
-    //qDebug() << str << (void*)(atom.constData());
-
-    return sym;
-}
-
-void EbnfToken::resetSymTbl()
-{
-
-}
-
 bool EbnfToken::isPpType(int tt)
 {
     switch(tt)
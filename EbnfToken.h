@@ -23,6 +23,8 @@
 #include <QString>
 #include <QHash>
 
+class SymbolTable;
+
 struct EbnfToken
 {
     class Sym
@@ -30,6 +32,7 @@ struct EbnfToken
     public:
         Sym(const Sym& rhs ):d_str(rhs.d_str){}
         Sym():d_str(0){}
+        static Sym empty(); // the same for all tables
 
         operator QByteArray() const { return toBa(); }
         QByteArray toBa() const;
@@ -37,12 +40,13 @@ struct EbnfToken
         operator const char*() const { return c_str(); }
         const char* c_str() const;
         const char* data() const { return d_str; }
-        int size() const;
+        int size() const { return d_str == 0 ? 0 : *reinterpret_cast<const quint32*>( d_str - sizeof(quint32) ); }
         bool isEmpty() const;
         bool operator==(const Sym& rhs) const { return d_str == rhs.d_str; }
     private:
-        friend class EbnfToken;
-        const char* d_str; // stores utf-8
+        friend class SymbolTable;
+        explicit Sym(const char* str):d_str(str){}
+        const char* d_str; // stores utf-8, zero terminated and preceded by the length, see SymbolTable
     };
 
     enum TokenType { Invalid, Production, Assig, NonTerm, Keyword, Literal,
@@ -66,20 +70,13 @@ struct EbnfToken
     uint d_colNr : 15;
     quint32 d_lineNr;
     Sym d_val; // utf-8
-    EbnfToken(TokenType t = Invalid, quint32 line = 0,quint16 col = 0, quint16 len = 0, const QByteArray& val = QByteArray() ):
-        d_type(t),d_lineNr(line),d_colNr(col),d_len(len),d_op(Normal){ d_val = getSym(val);}
+    EbnfToken(TokenType t = Invalid, quint32 line = 0,quint16 col = 0, quint16 len = 0, const Sym& val = Sym::empty() ):
+        d_type(t),d_lineNr(line),d_colNr(col),d_len(len),d_op(Normal),d_val(val){}
     QString toString(bool labeled = true) const;
     bool isValid() const { return d_type != Eof && d_type != Invalid; }
     bool isErr() const { return d_type == Invalid; }
 
-
-    static Sym getSym( const QByteArray& );
-    static void resetSymTbl();
-
     static bool isPpType(int );
-
-private:
-    static QHash<QByteArray,Sym> s_symTbl;
 };
 
 inline uint qHash(const EbnfToken::Sym& r ) { return qHash(r.data()); }
@@ -18,9 +18,11 @@
 */
 
 #include "FirstFollowSet.h"
+#include "Tracer.h"
 #include <QtDebug>
+#include <QElapsedTimer>
 
-FirstFollowSet::FirstFollowSet(QObject *parent) : QObject(parent),d_includeNts(false)
+FirstFollowSet::FirstFollowSet(QObject *parent) : QObject(parent),d_firstTime(0),d_followTime(0),d_flat(0),d_includeNts(false)
 {
 
 }
@@ -31,8 +33,26 @@ void FirstFollowSet::setSyntax(EbnfSyntax* syn)
         return;
     clear();
     d_syn = syn;
-    calculateFirstSets();
-    calculateFollowSets();
+    if( syn == 0 )
+        return;
+    d_flat = &syn->getFlat();
+    const int n = d_flat->getNodeCount();
+    d_first.resize(n);
+    d_follow.resize(n);
+    d_cached.fill(false, n);
+    QElapsedTimer t;
+    t.start();
+    {
+        TraceSpan span("calculateFirstSets");
+        calculateFirstSets();
+    }
+    d_firstTime = t.nsecsElapsed();
+    t.start();
+    {
+        TraceSpan span("calculateFollowSets");
+        calculateFollowSets();
+    }
+    d_followTime = t.nsecsElapsed();
 }
 
 void FirstFollowSet::setIncludeNts(bool on)
@@ -43,27 +63,143 @@ void FirstFollowSet::setIncludeNts(bool on)
 void FirstFollowSet::clear()
 {
     d_syn = 0;
+    d_flat = 0;
     d_first.clear();
     d_follow.clear();
+    d_cached.clear();
+    d_firstStats = FixpointSolver::Stats();
+    d_followStats = FixpointSolver::Stats();
+    d_firstTime = 0;
+    d_followTime = 0;
+}
+
+int FirstFollowSet::resolve(int id) const
+{
+    if( id != -1 && d_flat->getType(id) == Ast::Node::Nonterminal && d_flat->getTarget(id) != -1 )
+        return d_flat->getTarget(id);
+    return id;
+}
+
+Ast::NodeSet FirstFollowSet::getFirstNodeSet(const Ast::Node* node, bool) const
+{
+    if( d_flat == 0 )
+        return Ast::NodeSet();
+    return getFirstNodeSet( d_flat->indexOf(node) );
 }
 
-Ast::NodeSet FirstFollowSet::getFirstNodeSet(const Ast::Node* node, bool cache) const
+Ast::NodeSet FirstFollowSet::getFirstNodeSet(int id) const
 {
-    if( node && node->d_type == Ast::Node::Nonterminal && node->d_def && node->d_def->d_node )
-        node = node->d_def->d_node;
-    Ast::NodeSet res = d_first.value(node);
-    if( res.isEmpty() )
+    // the sets are unions along the starts-with references, so a walk which visits each node once
+    // finds the same terminals as getFirstBits, but each occurrence by its own node
+    Ast::NodeSet res;
+    id = resolve(id);
+    if( id == -1 )
+        return res;
+    QVector<bool> visited( d_flat->getNodeCount() );
+    collectFirstNodes( id, res, visited );
+    return res;
+}
+
+void FirstFollowSet::collectFirstNodes(int id, Ast::NodeSet& res, QVector<bool>& visited) const
+{
+    if( id == -1 || visited[id] || d_flat->doIgnore(id) )
+        return;
+    visited[id] = true;
+    switch( d_flat->getType(id) )
     {
-        res = calculateFirstSet(node);
-        if( !res.isEmpty() && cache )
+    case Ast::Node::Terminal:
+        res << d_flat->getNode(id);
+        break;
+    case Ast::Node::Alternative:
+    case Ast::Node::Sequence:
+        for( int sub = d_flat->getSubBegin(id); sub < d_flat->getSubEnd(id); sub++ )
+        {
+            if( d_flat->doIgnore(sub) )
+                continue;
+            collectFirstNodes( sub, res, visited );
+            if( d_flat->getType(id) == Ast::Node::Sequence && !d_flat->isNullable(sub) )
+                break;
+        }
+        break;
+    case Ast::Node::Nonterminal:
+        if( d_flat->getTarget(id) == -1 )
+            res << d_flat->getNode(id); // unechtes Terminal
+        else
         {
-            FirstFollowSet* set = const_cast<FirstFollowSet*>(this);
-            set->d_first[node] = res;
+            if( d_includeNts )
+                res << d_flat->getNode(id);
+            if( d_cached[d_flat->getTarget(id)] ) // like calculateFirstSet, which only sees analyzed productions
+                collectFirstNodes( d_flat->getTarget(id), res, visited );
         }
+        break;
+    default:
+        break;
+    }
+}
+
+TermSet FirstFollowSet::getFirstBits(const Ast::Node* node) const
+{
+    if( d_flat == 0 )
+        return TermSet();
+    return getFirstBits( d_flat->indexOf(node) );
+}
+
+TermSet FirstFollowSet::getFirstBits(int id) const
+{
+    id = resolve(id);
+    if( id != -1 && d_cached[id] )
+        return d_first[id];
+    // not analyzed, e.g. not reachable
+    return calculateFirstSet(id);
+}
+
+TermSet FirstFollowSet::getFollowBits(const Ast::Node* node) const
+{
+    if( d_flat == 0 )
+        return TermSet();
+    return getFollowBits( d_flat->indexOf(node) );
+}
+
+TermSet FirstFollowSet::getFollowBits(int id) const
+{
+    id = resolve(id);
+    if( id == -1 )
+        return TermSet();
+    return d_follow[id];
+    /* Wenn man die Repeats hier berechnet, kommt nicht dasselbe raus wie wenn man sie in calculateFollowSet2 berechnet!
+    if( node->d_quant == Ast::Node::ZeroOrMore && doRepeats )
+        // Wenn das Element wiederholt wird, erscheint auch sein eigenes First-Set als Teil des Follow-Sets
+        res += getFirstSet(1,node);
+        */
+}
+
+Ast::NodeRefSet FirstFollowSet::toRefSet(const TermSet& s) const
+{
+    Ast::NodeRefSet res;
+    foreach( quint16 id, s.toList() )
+        res.insert( Ast::NodeRef( d_syn->getTerminal(id) ) );
+    return res;
+}
+
+TermSet FirstFollowSet::toBits(const Ast::NodeSet& s)
+{
+    TermSet res;
+    foreach( const Ast::Node* n, s )
+    {
+        Q_ASSERT( n->d_termId != 0 ); // only terminals and pseudo terminals
+        res.insert( n->d_termId );
     }
     return res;
 }
 
+TermSet FirstFollowSet::toBits(const Ast::NodeRefSet& s)
+{
+    TermSet res;
+    foreach( const Ast::NodeRef& r, s )
+        res.insert( r.d_node->d_termId );
+    return res;
+}
+
 Ast::NodeRefSet FirstFollowSet::getFirstSet(const Ast::Node* node, bool cache ) const
 {
     // TODO: cache if need be
@@ -79,15 +215,9 @@ Ast::NodeRefSet FirstFollowSet::getFirstSet(const Ast::Definition* d) const
 
 Ast::NodeSet FirstFollowSet::getFollowNodeSet(const Ast::Node* node) const
 {
-    if( node && node->d_type == Ast::Node::Nonterminal && node->d_def && node->d_def->d_node )
-        node = node->d_def->d_node;
-    Ast::NodeSet res = d_follow.value(node);
-    /* Wenn man die Repeats hier berechnet, kommt nicht dasselbe raus wie wenn man sie in calculateFollowSet2 berechnet!
-    if( node->d_quant == Ast::Node::ZeroOrMore && doRepeats )
-        // Wenn das Element wiederholt wird, erscheint auch sein eigenes First-Set als Teil des Follow-Sets
-        res += getFirstSet(1,node);
-        */
-    return res;
+    if( d_flat == 0 )
+        return Ast::NodeSet();
+    return getFollowNodeSet( d_flat->indexOf(node) );
 }
 
 Ast::NodeRefSet FirstFollowSet::getFollowSet(const Ast::Definition* d) const
@@ -99,56 +229,48 @@ Ast::NodeRefSet FirstFollowSet::getFollowSet(const Ast::Definition* d) const
 
 Ast::NodeRefSet FirstFollowSet::getFollowSet(const Ast::Node* node) const
 {
-    // TODO: cache if need be
-    return EbnfSyntax::nodeToRefSet( getFollowNodeSet( node ) );
+    return toRefSet( getFollowBits( node ) );
 }
 
-Ast::NodeSet FirstFollowSet::calculateFirstSet(const Ast::Node* node) const
+TermSet FirstFollowSet::calculateFirstSet(int id) const
 {
-    if( node == 0 || node->doIgnore() )
-        return Ast::NodeSet();
+    if( id == -1 || d_flat->doIgnore(id) )
+        return TermSet();
 
-    Ast::NodeSet res;
-    switch( node->d_type )
+    TermSet res;
+    switch( d_flat->getType(id) )
     {
     case Ast::Node::Terminal:
-        res << node;
+        res.insert( d_flat->getNode(id)->d_termId );
         break;
     case Ast::Node::Alternative:
-        foreach( Ast::Node* sub, node->d_subs )
+        for( int sub = d_flat->getSubBegin(id); sub < d_flat->getSubEnd(id); sub++ )
         {
-            if( sub->doIgnore() )
+            if( d_flat->doIgnore(sub) )
                 continue;
             // eine Alternative kann in jedes der Elemente verzweigen, also ist der Union das First Set
-            res += calculateFirstSet( sub );
+            res |= calculateFirstSet( sub );
         }
         break;
     case Ast::Node::Sequence:
-        foreach( Ast::Node* sub, node->d_subs )
+        for( int sub = d_flat->getSubBegin(id); sub < d_flat->getSubEnd(id); sub++ )
         {
-            if( sub->doIgnore() )
+            if( d_flat->doIgnore(sub) )
                 continue;
-            res += calculateFirstSet( sub );
-            if( !sub->isNullable() )
+            res |= calculateFirstSet( sub );
+            if( !d_flat->isNullable(sub) )
                 break;
         }
         break;
     case Ast::Node::Nonterminal:
-        if( !node->doIgnore() )
-        {
-            if( node->d_def == 0 || node->d_def->d_node == 0 )
-                res << node; // unechtes Terminal
-            else
-            {
-                res = d_first[node->d_def->d_node];
-                if( d_includeNts )
-                    res += node;
-            }
-        }
+        if( d_flat->getTarget(id) == -1 )
+            res.insert( d_flat->getNode(id)->d_termId ); // unechtes Terminal
+        else
+            res = d_first[d_flat->getTarget(id)]; // nonterminals (setIncludeNts) only in getFirstNodeSet
         break;
     case Ast::Node::Predicate:
         // ignore
-        Q_ASSERT(false); // wir können nie hier landen wegen oberstem node->ignore
+        Q_ASSERT(false); // wir können nie hier landen wegen oberstem doIgnore
         break;
     }
     // Cache nützt während First-Kalkulation noch nichts,
@@ -156,27 +278,73 @@ Ast::NodeSet FirstFollowSet::calculateFirstSet(const Ast::Node* node) const
     return res;
 }
 
+void FirstFollowSet::collectReferencedDefs(int def, QList<int>& res) const
+{
+    // the productions referenced from the body, except from ignored parts
+    const int body = d_flat->getBody(def);
+    QVector<bool> hidden( d_flat->getBodyEnd(def) - body );
+    for( int id = body; id < d_flat->getBodyEnd(def); id++ )
+    {
+        const int parent = d_flat->getParent(id);
+        hidden[id - body] = d_flat->doIgnore(id) || ( parent != -1 && hidden[parent - body] );
+        if( !hidden[id - body] && d_flat->getType(id) == Ast::Node::Nonterminal && d_flat->getTarget(id) != -1 )
+            res.append( d_flat->getOwner( d_flat->getTarget(id) ) );
+    }
+}
+
+void FirstFollowSet::collectDefs(QList<int>& defs, QVector<int>& index) const
+{
+    index.fill( -1, d_flat->getDefCount() );
+    for( int def = 0; def < d_flat->getDefCount(); def++ )
+    {
+        if( d_flat->getBody(def) == -1 // pseudoterminal, wird nicht hier behandelt, sondern beim NT, das darauf zeigt
+                || d_flat->getDef(def)->doIgnore() )
+            continue;
+        index[def] = defs.size();
+        defs.append( def );
+    }
+}
+
+struct FirstFollowSet::FirstEquations : public FixpointSolver::Equations
+{
+    FirstFollowSet* d_this;
+    const QList<int>& d_defs;
+    FirstEquations( FirstFollowSet* that, const QList<int>& defs ):d_this(that),d_defs(defs){}
+    bool update( int var )
+    {
+        const int body = d_this->d_flat->getBody( d_defs[var] );
+        const TermSet newValue = d_this->calculateFirstSet(body);
+        TermSet& cur = d_this->d_first[body];
+        if( newValue == cur )
+            return false;
+        cur = newValue;
+        return true;
+    }
+};
+
 void FirstFollowSet::calculateFirstSets()
 {
-    // Implement algorithm by a fixed-point iteration
+    // Implement algorithm by a fixed-point iteration; the first set of a definition only depends on the
+    // first sets of the definitions it references, so FixpointSolver updates only those which can change.
+
+    QList<int> defs;
+    QVector<int> index;
+    collectDefs( defs, index );
 
-    bool changed;
-    do
+    FixpointSolver solver( defs.size() );
+    for( int i = 0; i < defs.size(); i++ )
     {
-        changed = false;
-        foreach( Ast::Definition* d, d_syn->getOrderedDefs() )
+        QList<int> refs;
+        collectReferencedDefs( defs[i], refs );
+        foreach( int r, refs )
         {
-            if( d->d_node == 0 // pseudoterminal, wird nicht hier behandelt, sondern beim NT, das darauf zeigt
-                    || d->doIgnore() )
-                continue;
-            Ast::NodeSet newValue = calculateFirstSet(d->d_node);
-            if( newValue != d_first[d->d_node] )
-            {
-                d_first[d->d_node] = newValue;
-                changed = true;
-            }
+            if( index[r] != -1 )
+                solver.addDependency( i, index[r] );
         }
-    }while( changed );
+    }
+    FirstEquations eq( this, defs );
+    solver.solve( &eq );
+    d_firstStats = solver.getStats();
 
     // The computation will terminate because
     // - the variables are changed monotonically (using set union)
@@ -189,71 +357,187 @@ void FirstFollowSet::calculateFirstSets()
 
     // dieser algo brauch 21 ms.
     // der rekursive brauchte 20 ms.
+
+    // now the sets of all nodes of the analyzed productions; the subs have higher ids than their
+    // node, so going backwards every node finds the sets of its subs already calculated
+    foreach( int def, defs )
+    {
+        const int body = d_flat->getBody(def);
+        for( int id = d_flat->getBodyEnd(def) - 1; id > body; id-- )
+        {
+            if( d_flat->doIgnore(id) )
+                continue;
+            TermSet& res = d_first[id];
+            switch( d_flat->getType(id) )
+            {
+            case Ast::Node::Alternative:
+            case Ast::Node::Sequence:
+                for( int sub = d_flat->getSubBegin(id); sub < d_flat->getSubEnd(id); sub++ )
+                {
+                    if( d_flat->doIgnore(sub) )
+                        continue;
+                    res |= d_first[sub];
+                    if( d_flat->getType(id) == Ast::Node::Sequence && !d_flat->isNullable(sub) )
+                        break;
+                }
+                break;
+            default:
+                res = calculateFirstSet(id);
+                break;
+            }
+        }
+        for( int id = body; id < d_flat->getBodyEnd(def); id++ )
+            d_cached[id] = true;
+    }
 }
 
+struct FirstFollowSet::FollowEquations : public FixpointSolver::Equations
+{
+    FirstFollowSet* d_this;
+    const QList<int>& d_defs;
+    FollowEquations( FirstFollowSet* that, const QList<int>& defs ):d_this(that),d_defs(defs){}
+    bool update( int var )
+    {
+        return d_this->calculateFollowSet2(d_this->d_flat->getBody( d_defs[var] ), false);
+    }
+};
 
 void FirstFollowSet::calculateFollowSets()
 {
-    bool changed;
-    do
+    // calculateFollowSet2 of a definition adds to the follow sets of the definitions it references, so
+    // these have to be updated again if something changed; the definition itself too, since repetitions
+    // add to follow sets already visited in the same pass.
+    QList<int> defs;
+    QVector<int> index;
+    collectDefs( defs, index );
+
+    FixpointSolver solver( defs.size() );
+    for( int i = 0; i < defs.size(); i++ )
     {
-        changed = false;
-        for( int i = 0; i < d_syn->getOrderedDefs().size(); i++ )
+        solver.addDependency( i, i );
+        QList<int> refs;
+        collectReferencedDefs( defs[i], refs );
+        foreach( int r, refs )
         {
-            Ast::Definition* def = d_syn->getOrderedDefs()[i];
-            if( def->d_node == 0 || def->doIgnore() )
-                continue;
-            //qDebug() << def->d_tok.d_val;
-            //changed |= calculateFollowSet(d);
-            changed |= calculateFollowSet2(def->d_node, false);
+            if( index[r] != -1 )
+                solver.addDependency( index[r], i );
         }
-    }while( changed );
+    }
+    FollowEquations eq( this, defs );
+    solver.solve( &eq );
+    d_followStats = solver.getStats();
+}
 
+static inline bool isNt( quint8 type )
+{
+    return type == Ast::Node::Nonterminal ||
+            type == Ast::Node::Sequence ||
+            type == Ast::Node::Alternative;
 }
 
-static inline bool isNt( const Ast::Node* node )
+int FirstFollowSet::followOf(int id) const
 {
-    return node->d_type == Ast::Node::Nonterminal ||
-            node->d_type == Ast::Node::Sequence ||
-            node->d_type == Ast::Node::Alternative;
+    if( d_flat->getType(id) == Ast::Node::Nonterminal && d_flat->getNode(id)->d_def )
+        return d_flat->getTarget(id); // -1 for a pseudo terminal, which has no follow set
+    return id;
 }
 
-static bool add(FirstFollowSet::Lookup& lkp, const Ast::Node* node, const Ast::NodeSet& rhs )
+bool FirstFollowSet::addFollow(int id, const TermSet& rhs )
 {
-    if( node->d_def )
-    {
-        Q_ASSERT(node->d_type == Ast::Node::Nonterminal );
-        node = node->d_def->d_node;
-    }
-    Ast::NodeSet& orig = lkp[node];
-    Ast::NodeSet lhs = orig;
-    lhs += rhs;
-    bool changed = false;
-    if( orig != lhs )
+    id = followOf(id);
+    if( id == -1 )
+        return false;
+    // union only grows the set
+    return d_follow[id].unite( rhs );
+}
+
+bool FirstFollowSet::isFollowed(int id) const
+{
+    while( !d_flat->doIgnore(id) )
     {
-        changed = true;
-        orig = lhs;
+        const int parent = d_flat->getParent(id);
+        if( parent == -1 )
+            return d_cached[id]; // the body of an analyzed production
+        if( !isNt(d_flat->getType(id)) )
+            return false;
+        id = parent;
     }
-    return changed;
-#if 0
-    Ast::NodeSet lhs = lkp[node];
-    lhs += rhs;
-    bool changed = false;
-    if( lhs != lkp[node] )
+    return false;
+}
+
+Ast::NodeSet FirstFollowSet::getFollowNodeSet(int id) const
+{
+    // The equations of calculateFollowSet2 backwards: the set is the union of the first sets added
+    // to the node and to the nodes whose follow sets are added to it. Unlike getFollowBits each
+    // occurrence of a terminal is a node of its own.
+    Ast::NodeSet res;
+    id = resolve(id);
+    if( id == -1 )
+        return res;
+    const int n = d_flat->getNodeCount();
+    QVector<bool> done(n), firstDone(n);
+    QList<int> todo;
+    todo << id;
+    done[id] = true;
+    while( !todo.isEmpty() )
     {
-        changed = true;
-        lkp[node] = lhs;
+        const int cur = todo.takeLast();
+        // the nodes calculateFollowSet2 passes to addFollow which end up in cur
+        QList<int> from;
+        if( followOf(cur) == cur )
+            from << cur;
+        if( d_flat->getParent(cur) == -1 )
+        {
+            const int def = d_flat->getOwner(cur);
+            for( int i = d_flat->getUserBegin(def); i < d_flat->getUserEnd(def); i++ )
+                from << d_flat->getUser(i);
+        }
+        foreach( int a, from )
+        {
+            if( followOf(a) != cur || !isFollowed(a) )
+                continue;
+            QList<int> follows;
+            const int parent = d_flat->getParent(a);
+            if( parent != -1 )
+            {
+                bool foundNn = false;
+                if( d_flat->getType(parent) == Ast::Node::Sequence )
+                    for( int b = a + 1; b < d_flat->getSubEnd(parent); b++ )
+                    {
+                        if( d_flat->doIgnore(b) )
+                            continue;
+                        collectFirstNodes( resolve(b), res, firstDone );
+                        if( !d_flat->isNullable(b) )
+                        {
+                            foundNn = true;
+                            break;
+                        }
+                    }
+                if( !foundNn )
+                    follows << parent;
+            }else if( d_flat->getType(a) == Ast::Node::Nonterminal )
+                follows << a; // a production which only consists of a nonterminal
+            if( d_flat->getQuant(a) == Ast::Node::ZeroOrMore )
+                collectFirstNodes( resolve(a), res, firstDone );
+            foreach( int f, follows )
+            {
+                if( !done[f] )
+                {
+                    done[f] = true;
+                    todo << f;
+                }
+            }
+        }
     }
-    return changed;
-#endif
+    return res;
 }
 
-bool FirstFollowSet::calculateFollowSet2(const Ast::Node* node, bool addRepetitions )
+bool FirstFollowSet::calculateFollowSet2(int id, bool addRepetitions )
 {
     // Dieser Algorithmus produziert ein identisches Follow-Set mit Coco/R wenn addRepetitions
     // habe vollständigen 1:1-Vergleich gemacht.
 
-    if( node == 0 || node->doIgnore() )
+    if( id == -1 || d_flat->doIgnore(id) )
         return false;
 
     // NT ---
@@ -262,42 +546,40 @@ bool FirstFollowSet::calculateFollowSet2(const Ast::Node* node, bool addRepetiti
     //                     NT | T | SEQ | ALT
 
     bool changed = false;
-    switch( node->d_type )
+    const quint8 type = d_flat->getType(id);
+    switch( type )
     {
     case Ast::Node::Nonterminal:
-        if( node == node->d_owner->d_node )
+        if( d_flat->getParent(id) == -1 )
         {
             // Spezialfall, wenn Definition nur ein NT enthält
-            Ast::NodeSet follow = d_follow[node];
+            const TermSet follow = d_follow[id];
             // vereine das Follow Set dieses Nonterminals mit demjenigen dieser Production, in der sich das
             // Nonterminal gerade befindet
-            changed |= add( d_follow, node, follow );
+            changed |= addFollow( id, follow );
             // Wiederholung wird weiter unten behandelt
         }
         break;
     case Ast::Node::Alternative:
     case Ast::Node::Sequence:
-        for( int i = 0; i < node->d_subs.size(); i++ )
+        for( int a = d_flat->getSubBegin(id); a < d_flat->getSubEnd(id); a++ )
         {
             // gehe durch alle Elemente der Sequence oder Alternative
-            Ast::Node* a = node->d_subs[i];
-            if( a->doIgnore() || !isNt(a))
+            if( d_flat->doIgnore(a) || !isNt(d_flat->getType(a)) )
                 continue;
             // hier werden nur die Elemente von Seq und Alt betrachtet, die Nonterminals sind.
             // Vorsicht: da wir in einer EBNF sind, ist jede Sequence und Alternative selber
             // eine Production bzw. Nonterminal! Siehe https://stackoverflow.com/questions/2466484/converting-ebnf-to-bnf
-            Ast::NodeSet follow;
+            TermSet follow;
             bool foundNn = false;
-            if( node->d_type == Ast::Node::Sequence )
-                for( int j = i + 1; j < node->d_subs.size(); j++ )
+            if( type == Ast::Node::Sequence )
+                for( int b = a + 1; b < d_flat->getSubEnd(id); b++ )
                 {
                     // Berechne im Falle einer Sequence das Follow Set ab dem aktuellen NT.
-                    const Ast::Node* b = node->d_subs[j];
-                    if( b->doIgnore() )
+                    if( d_flat->doIgnore(b) )
                         continue;
-                    const Ast::NodeSet first = getFirstNodeSet(b);
-                    follow += first;
-                    if( !b->isNullable() )
+                    follow |= getFirstBits(b);
+                    if( !d_flat->isNullable(b) )
                     {
                         // Jedes nullable b + das erste non-nullable b gehören zum Follow Set
                         foundNn = true;
@@ -308,10 +590,9 @@ bool FirstFollowSet::calculateFollowSet2(const Ast::Node* node, bool addRepetiti
             {
                 // wenn es sich um ein Element einer Alternative handelt oder in einer Sequence alles bis ans
                 // Ende nullable war, wird das übergeordnete Follow Set runtergeholt
-                const Ast::NodeSet outer = d_follow[node];
-                follow += outer;
+                follow |= d_follow[id];
             }
-            changed |= add( d_follow, a, follow );
+            changed |= addFollow( a, follow );
 
             // go down
             changed |= calculateFollowSet2(a,addRepetitions);
@@ -321,10 +602,10 @@ bool FirstFollowSet::calculateFollowSet2(const Ast::Node* node, bool addRepetiti
         break;
     }
     // das muss hier auf Ebene von node gemacht werden, da sonst Definition.d_node nicht berücksichtigt wird.
-    if( isNt(node) && node->d_quant == Ast::Node::ZeroOrMore ) //  && addRepetitions )
+    if( isNt(type) && d_flat->getQuant(id) == Ast::Node::ZeroOrMore ) //  && addRepetitions )
     {
         // Wenn das Element wiederholt wird, erscheint auch sein eigenes First-Set als Teil des Follow-Sets
-        changed |= add( d_follow, node, getFirstNodeSet(node) );
+        changed |= addFollow( id, getFirstBits(id) );
         // NOTE: wenn eine Alternative wiederholt, kann jedes Element potentiell vorkommen, es muss also das first
         // von jedem Sub ins follow der Alternative. Das wird von getFirstSet(Alternative) bereits berücksichtigt
     }
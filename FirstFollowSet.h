@@ -22,36 +22,76 @@
 
 #include <QObject>
 #include "EbnfSyntax.h"
+#include "FixpointSolver.h"
+#include "TermSet.h"
 
+// First and Follow sets of all nodes of a finished syntax, calculated on EbnfSyntax::getFlat and
+// stored by node id as terminal id bitsets.
 class FirstFollowSet : public QObject
 {
 public:
-    typedef QHash<const Ast::Node*, Ast::NodeSet> Lookup;
+    typedef QVector<TermSet> Lookup; // by node id
 
     explicit FirstFollowSet(QObject *parent = 0);
 
     void setSyntax( EbnfSyntax* );
     void setIncludeNts(bool);
     EbnfSyntax* getSyntax() const { return d_syn.data(); }
+    const FlatSyntax* getFlat() const { return d_flat; } // of getSyntax, null if there is none
     void clear();
 
-    Ast::NodeSet getFirstNodeSet(const Ast::Node* , bool cache = true) const;
+    Ast::NodeSet getFirstNodeSet(const Ast::Node* , bool cache = true) const; // all sets are cached
     Ast::NodeRefSet getFirstSet(const Ast::Node* , bool cache = true) const;
     Ast::NodeRefSet getFirstSet( const Ast::Definition* ) const;
     Ast::NodeSet getFollowNodeSet( const Ast::Node*) const;
     Ast::NodeRefSet getFollowSet( const Ast::Definition*) const;
     Ast::NodeRefSet getFollowSet( const Ast::Node*) const;
+
+    // First and Follow sets as terminal id bitsets, used by the analyzers; the node sets above
+    // are built on request for the generators and diagnostics (e.g. EbnfSyntax::collectNodes)
+    TermSet getFirstBits( const Ast::Node* ) const;
+    TermSet getFollowBits( const Ast::Node* ) const;
+    Ast::NodeRefSet toRefSet( const TermSet& ) const;
+    static TermSet toBits( const Ast::NodeSet& );
+    static TermSet toBits( const Ast::NodeRefSet& );
+
+    // the same by node id of EbnfSyntax::getFlat
+    Ast::NodeSet getFirstNodeSet( int id ) const;
+    Ast::NodeSet getFollowNodeSet( int id ) const;
+    TermSet getFirstBits( int id ) const;
+    TermSet getFollowBits( int id ) const;
+
+    const FixpointSolver::Stats& getFirstStats() const { return d_firstStats; }
+    const FixpointSolver::Stats& getFollowStats() const { return d_followStats; }
+    qint64 getFirstTime() const { return d_firstTime; } // nanoseconds spent by setSyntax
+    qint64 getFollowTime() const { return d_followTime; }
 protected:
-    Ast::NodeSet calculateFirstSet( const Ast::Node* ) const;
+    int resolve( int id ) const; // the body of the production a nonterminal refers to
+    TermSet calculateFirstSet( int id ) const;
     void calculateFirstSets();
     void calculateFollowSets();
-    bool calculateFollowSet2(const Ast::Node* , bool addRepetitions = true);
-    bool calculateFollowSet( const Ast::Definition* );
+    bool calculateFollowSet2( int id, bool addRepetitions = true);
+    bool addFollow( int id, const TermSet& );
+    void collectDefs( QList<int>&, QVector<int>& ) const;
+    void collectReferencedDefs( int def, QList<int>& ) const;
+    void collectFirstNodes( int id, Ast::NodeSet&, QVector<bool>& visited ) const;
+    int followOf( int id ) const; // where addFollow adds to, -1 for none
+    bool isFollowed( int id ) const; // calculateFollowSet2 visits the node
 private:
     friend class EbnfAnalyzer;
+    struct FirstEquations;
+    struct FollowEquations;
+    friend struct FirstEquations;
+    friend struct FollowEquations;
     Lookup d_first;
     Lookup d_follow;
+    QVector<bool> d_cached; // the node belongs to an analyzed production and its sets are final
+    FixpointSolver::Stats d_firstStats;
+    FixpointSolver::Stats d_followStats;
+    qint64 d_firstTime;
+    qint64 d_followTime;
     EbnfSyntaxRef d_syn;
+    const FlatSyntax* d_flat;
     bool d_includeNts;
 };
 
@@ -0,0 +1,102 @@
+/*
+* Copyright 2026 Rochus Keller <mailto:me@rochus-keller.ch>
+*
+* This file is part of the EbnfStudio application.
+*
+* The following is the license that applies to this copy of the
+* application. For a license to use the application under conditions
+* other than those described here, please email to me@rochus-keller.ch.
+*
+* GNU General Public License Usage
+* This file may be used under the terms of the GNU General Public
+* License (GPL) versions 2.0 or 3.0 as published by the Free Software
+* Foundation and appearing in the file LICENSE.GPL included in
+* the packaging of this file. Please review the following information
+* to ensure GNU General Public Licensing requirements will be met:
+* http://www.fsf.org/licensing/licenses/info/GPLv2.html and
+* http://www.gnu.org/copyleft/gpl.html.
+*/
+
+#include "FixpointSolver.h"
+
+FixpointSolver::Stats& FixpointSolver::Stats::operator+=(const FixpointSolver::Stats& rhs)
+{
+    d_vars += rhs.d_vars;
+    d_components += rhs.d_components;
+    d_updates += rhs.d_updates;
+    return *this;
+}
+
+FixpointSolver::FixpointSolver(int varCount)
+{
+    reset(varCount);
+}
+
+void FixpointSolver::reset(int varCount)
+{
+    d_deps.reset(varCount);
+    d_dependents.clear();
+    d_dependents.resize(varCount);
+    d_stats = Stats();
+}
+
+void FixpointSolver::addDependency(int var, int dependsOn)
+{
+    d_deps.addEdge(var, dependsOn);
+    if( var != dependsOn )
+        d_dependents[dependsOn].append(var);
+}
+
+void FixpointSolver::solve(FixpointSolver::Equations* eq)
+{
+    d_deps.calcComponents();
+    const QList< QVector<int> >& comps = d_deps.getComponents();
+    const int n = d_deps.getVertexCount();
+    d_stats.d_vars += n;
+    d_stats.d_components += comps.size();
+
+    QVector<bool> dirty(n, false);
+    for( int c = 0; c < comps.size(); c++ )
+    {
+        const QVector<int>& comp = comps[c];
+        if( !d_deps.isCyclic(c) )
+        {
+            // not recursive, all inputs are final
+            d_stats.d_updates++;
+            eq->update(comp.first());
+            continue;
+        }
+        for( int i = 0; i < comp.size(); i++ )
+            dirty[comp[i]] = true;
+        int pending = comp.size();
+        while( pending > 0 )
+        {
+            for( int i = 0; i < comp.size(); i++ )
+            {
+                const int v = comp[i];
+                if( !dirty[v] )
+                    continue;
+                dirty[v] = false;
+                pending--;
+                d_stats.d_updates++;
+                if( !eq->update(v) )
+                    continue;
+                if( d_deps.hasSelfLoop(v) )
+                {
+                    dirty[v] = true;
+                    pending++;
+                }
+                const QVector<int>& dependents = d_dependents[v];
+                for( int j = 0; j < dependents.size(); j++ )
+                {
+                    const int w = dependents[j];
+                    if( d_deps.getComponentOf(w) == c && !dirty[w] )
+                    {
+                        dirty[w] = true;
+                        pending++;
+                    }
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,64 @@
+#ifndef FIXPOINTSOLVER_H
+#define FIXPOINTSOLVER_H
+
+/*
+* Copyright 2026 Rochus Keller <mailto:me@rochus-keller.ch>
+*
+* This file is part of the EbnfStudio application.
+*
+* The following is the license that applies to this copy of the
+* application. For a license to use the application under conditions
+* other than those described here, please email to me@rochus-keller.ch.
+*
+* GNU General Public License Usage
+* This file may be used under the terms of the GNU General Public
+* License (GPL) versions 2.0 or 3.0 as published by the Free Software
+* Foundation and appearing in the file LICENSE.GPL included in
+* the packaging of this file. Please review the following information
+* to ensure GNU General Public Licensing requirements will be met:
+* http://www.fsf.org/licensing/licenses/info/GPLv2.html and
+* http://www.gnu.org/copyleft/gpl.html.
+*/
+
+#include "SccGraph.h"
+
+// Dependency driven fixpoint iteration over the variables 0..n-1. The dependency graph is split
+// into strongly connected components (see SccGraph) which are solved in reverse topological order, so
+// a component is only started when all variables it reads from other components are final.
+// Within a component only the dependents of a changed variable are updated again; the members
+// are visited in ascending order, i.e. in the order the caller numbered the variables.
+class FixpointSolver
+{
+public:
+    class Equations
+    {
+    public:
+        virtual ~Equations() {}
+        // recalculate the variable; return true if its value (or anything a dependent reads) changed
+        virtual bool update( int var ) = 0;
+    };
+
+    struct Stats
+    {
+        quint32 d_vars;
+        quint32 d_components;
+        quint32 d_updates; // number of update() calls
+        Stats():d_vars(0),d_components(0),d_updates(0){}
+        Stats& operator+=( const Stats& );
+    };
+
+    explicit FixpointSolver( int varCount = 0 );
+    void reset( int varCount );
+    void addDependency( int var, int dependsOn ); // var reads dependsOn; var == dependsOn is allowed
+    void solve( Equations* );
+    const Stats& getStats() const { return d_stats; }
+
+    // the components in solving order, each with ascending members; valid after solve()
+    const QList< QVector<int> >& getComponents() const { return d_deps.getComponents(); }
+private:
+    SccGraph d_deps; // var -> vars it reads
+    QVector< QVector<int> > d_dependents; // var -> vars which read it
+    Stats d_stats;
+};
+
+#endif // FIXPOINTSOLVER_H
@@ -0,0 +1,175 @@
+/*
+* Copyright 2026 Rochus Keller <mailto:me@rochus-keller.ch>
+*
+* This file is part of the EbnfStudio application.
+*
+* The following is the license that applies to this copy of the
+* application. For a license to use the application under conditions
+* other than those described here, please email to me@rochus-keller.ch.
+*
+* GNU General Public License Usage
+* This file may be used under the terms of the GNU General Public
+* License (GPL) versions 2.0 or 3.0 as published by the Free Software
+* Foundation and appearing in the file LICENSE.GPL included in
+* the packaging of this file. Please review the following information
+* to ensure GNU General Public Licensing requirements will be met:
+* http://www.fsf.org/licensing/licenses/info/GPLv2.html and
+* http://www.gnu.org/copyleft/gpl.html.
+*/
+
+#include "FlatSyntax.h"
+#include "EbnfSyntax.h"
+
+void FlatSyntax::build(const QList<Ast::Definition*>& defs)
+{
+    clear();
+    d_def.reserve( defs.size() );
+    d_body.reserve( defs.size() );
+    d_bodyEnd.reserve( defs.size() );
+
+    // breadth first per production, so that the subs of a node get consecutive ids
+    for( int i = 0; i < defs.size(); i++ )
+    {
+        Ast::Definition* d = defs[i];
+        d_def.append( d );
+        if( d->d_node == 0 )
+        {
+            d_body.append( -1 );
+            d_bodyEnd.append( -1 );
+            continue;
+        }
+        d_body.append( d_node.size() );
+        d_node.append( d->d_node );
+        d_parent.append( -1 );
+        for( int id = d_body.last(); id < d_node.size(); id++ )
+        {
+            Ast::Node* node = const_cast<Ast::Node*>( d_node[id] );
+            node->d_flatId = id;
+            d_owner.append( i );
+            d_subBegin.append( d_node.size() );
+            d_subCount.append( node->d_subs.size() );
+            foreach( Ast::Node* sub, node->d_subs )
+            {
+                d_node.append( sub );
+                d_parent.append( id );
+            }
+        }
+        d_bodyEnd.append( d_node.size() );
+    }
+
+    const int n = d_node.size();
+    d_type.resize( n );
+    d_quant.resize( n );
+    d_flags.resize( n );
+    d_termId.resize( n );
+    d_target.resize( n );
+    // subs first, so the flags of Ast::Node are calculated from the ones already stored
+    for( int id = n - 1; id >= 0; id-- )
+    {
+        const Ast::Node* node = d_node[id];
+        d_type[id] = node->d_type;
+        d_quant[id] = node->d_quant;
+        d_termId[id] = node->d_termId;
+        d_target[id] = node->d_def && node->d_def->d_node ? node->d_def->d_node->d_flatId : -1;
+
+        quint8 flags = node->doIgnore() ? Ignore : 0;
+        bool nullable = false;
+        bool repeatable = false;
+        switch( node->d_type )
+        {
+        case Ast::Node::Nonterminal:
+            if( node->d_def )
+            {
+                nullable = node->d_def->isNullable();
+                repeatable = node->d_def->isRepeatable();
+            }
+            break;
+        case Ast::Node::Sequence:
+        case Ast::Node::Alternative:
+            {
+                const bool seq = node->d_type == Ast::Node::Sequence;
+                nullable = seq;
+                int visible = 0;
+                for( int sub = getSubBegin(id); sub < getSubEnd(id); sub++ )
+                {
+                    if( doIgnore(sub) )
+                        continue;
+                    if( seq && !isNullable(sub) )
+                        nullable = false;
+                    else if( !seq && isNullable(sub) )
+                        nullable = true;
+                    repeatable = ++visible == 1 && isRepeatable(sub);
+                }
+            }
+            break;
+        default:
+            break;
+        }
+        if( nullable || node->d_quant != Ast::Node::One )
+            flags |= Nullable;
+        if( repeatable || node->d_quant == Ast::Node::ZeroOrMore )
+            flags |= Repeatable;
+        d_flags[id] = flags;
+    }
+
+    d_userBegin.reserve( d_def.size() + 1 );
+    foreach( const Ast::Definition* d, d_def )
+    {
+        d_userBegin.append( d_users.size() );
+        foreach( Ast::Node* use, d->d_usedBy )
+        {
+            Q_ASSERT( indexOf( use ) != -1 );
+            d_users.append( use->d_flatId );
+        }
+    }
+    d_userBegin.append( d_users.size() );
+}
+
+void FlatSyntax::clear()
+{
+    d_node.clear();
+    d_type.clear();
+    d_quant.clear();
+    d_flags.clear();
+    d_termId.clear();
+    d_subBegin.clear();
+    d_subCount.clear();
+    d_parent.clear();
+    d_target.clear();
+    d_owner.clear();
+    d_def.clear();
+    d_body.clear();
+    d_bodyEnd.clear();
+    d_userBegin.clear();
+    d_users.clear();
+}
+
+int FlatSyntax::indexOf(const Ast::Node* node) const
+{
+    if( node == 0 )
+        return -1;
+    const int id = node->d_flatId;
+    if( id >= 0 && id < d_node.size() && d_node[id] == node )
+        return id;
+    return -1;
+}
+
+int FlatSyntax::getNext(int id, int* index) const
+{
+    int parent = d_parent[id];
+    while( parent != -1 )
+    {
+        if( d_type[parent] == Ast::Node::Sequence ) // bei Alternative gehe direkt eine Stufe nach oben
+        {
+            if( id + 1 < getSubEnd(parent) )
+            {
+                if( index )
+                    *index += 1;
+                return id + 1;
+            }
+        }
+        id = parent;
+        parent = d_parent[parent];
+    }
+    return -1;
+}
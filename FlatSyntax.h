@@ -0,0 +1,96 @@
+#ifndef FLATSYNTAX_H
+#define FLATSYNTAX_H
+
+/*
+* Copyright 2026 Rochus Keller <mailto:me@rochus-keller.ch>
+*
+* This file is part of the EbnfStudio application.
+*
+* The following is the license that applies to this copy of the
+* application. For a license to use the application under conditions
+* other than those described here, please email to me@rochus-keller.ch.
+*
+* GNU General Public License Usage
+* This file may be used under the terms of the GNU General Public
+* License (GPL) versions 2.0 or 3.0 as published by the Free Software
+* Foundation and appearing in the file LICENSE.GPL included in
+* the packaging of this file. Please review the following information
+* to ensure GNU General Public Licensing requirements will be met:
+* http://www.fsf.org/licensing/licenses/info/GPLv2.html and
+* http://www.gnu.org/copyleft/gpl.html.
+*/
+
+#include <QVector>
+#include <QList>
+
+namespace Ast
+{
+    struct Node;
+    struct Definition;
+}
+
+// Read-only copy of the productions of a finished EbnfSyntax as parallel arrays, indexed by node id
+// (see Ast::Node::d_flatId). The subs of a node have consecutive ids, always higher than the id of
+// the node, so the analyzers walk the grammar by index instead of chasing d_subs and d_def, and
+// the ignore, nullable and repeatable flags are looked up instead of recalculated recursively.
+// Productions are indexed in the order of EbnfSyntax::getOrderedDefs.
+class FlatSyntax
+{
+public:
+    enum Flag { Ignore = 1, Nullable = 2, Repeatable = 4 };
+
+    FlatSyntax() {}
+
+    void build( const QList<Ast::Definition*>& ); // assigns d_flatId to all nodes
+    void clear();
+
+    int getNodeCount() const { return d_node.size(); }
+    const Ast::Node* getNode( int id ) const { return d_node[id]; }
+    int indexOf( const Ast::Node* ) const; // -1 if not part of the syntax
+
+    quint8 getType( int id ) const { return d_type[id]; }
+    quint8 getQuant( int id ) const { return d_quant[id]; }
+    quint16 getTermId( int id ) const { return d_termId[id]; }
+    bool doIgnore( int id ) const { return d_flags[id] & Ignore; }
+    bool isNullable( int id ) const { return d_flags[id] & Nullable; }
+    bool isRepeatable( int id ) const { return d_flags[id] & Repeatable; }
+
+    int getSubBegin( int id ) const { return d_subBegin[id]; }
+    int getSubEnd( int id ) const { return d_subBegin[id] + d_subCount[id]; }
+    int getSubCount( int id ) const { return d_subCount[id]; }
+    int getParent( int id ) const { return d_parent[id]; } // -1 for the body of a production
+    int getIndexInParent( int id ) const { return id - d_subBegin[d_parent[id]]; }
+    int getTarget( int id ) const { return d_target[id]; } // body of the referenced production or -1
+    int getOwner( int id ) const { return d_owner[id]; } // production index
+
+    // same as Ast::Node::getNext; -1 if there is none
+    int getNext( int id, int* index = 0 ) const;
+
+    int getDefCount() const { return d_def.size(); }
+    const Ast::Definition* getDef( int def ) const { return d_def[def]; }
+    int getBody( int def ) const { return d_body[def]; } // -1 if the production has no body
+    int getBodyEnd( int def ) const { return d_bodyEnd[def]; } // the nodes of def are getBody..getBodyEnd-1
+    // the nonterminals referencing the production, in the iteration order of d_usedBy
+    int getUserBegin( int def ) const { return d_userBegin[def]; }
+    int getUserEnd( int def ) const { return d_userBegin[def+1]; }
+    int getUser( int i ) const { return d_users[i]; }
+private:
+    QVector<const Ast::Node*> d_node;
+    QVector<quint8> d_type;
+    QVector<quint8> d_quant;
+    QVector<quint8> d_flags;
+    QVector<quint16> d_termId;
+    QVector<qint32> d_subBegin;
+    QVector<qint32> d_subCount;
+    QVector<qint32> d_parent;
+    QVector<qint32> d_target;
+    QVector<qint32> d_owner;
+
+    QVector<const Ast::Definition*> d_def;
+    QVector<qint32> d_body;
+    QVector<qint32> d_bodyEnd;
+    QVector<qint32> d_userBegin; // one more than d_def
+    QVector<qint32> d_users;
+};
+
+#endif // FLATSYNTAX_H
@@ -0,0 +1,150 @@
+/*
+* Copyright 2026 Rochus Keller <mailto:me@rochus-keller.ch>
+*
+* This file is part of the EbnfStudio application.
+*
+* The following is the license that applies to this copy of the
+* application. For a license to use the application under conditions
+* other than those described here, please email to me@rochus-keller.ch.
+*
+* GNU General Public License Usage
+* This file may be used under the terms of the GNU General Public
+* License (GPL) versions 2.0 or 3.0 as published by the Free Software
+* Foundation and appearing in the file LICENSE.GPL included in
+* the packaging of this file. Please review the following information
+* to ensure GNU General Public Licensing requirements will be met:
+* http://www.fsf.org/licensing/licenses/info/GPLv2.html and
+* http://www.gnu.org/copyleft/gpl.html.
+*/
+
+#include "IssueMdl.h"
+#include <QTreeView>
+#include <QtDebug>
+
+IssueMdl::IssueMdl(QTreeView* parent) :
+    QAbstractItemModel(parent),d_err(":/images/exclamation-red.png"),d_warn(":/images/exclamation-circle.png")
+{
+
+}
+
+QTreeView*IssueMdl::getParent() const
+{
+    return static_cast<QTreeView*>(QObject::parent());
+}
+
+void IssueMdl::setIssues(const EbnfErrors::EntryList& l)
+{
+    // merge the two sorted lists; equal entries are kept, only their data refers to the new syntax
+    int row = 0;
+    int j = 0;
+    while( row < d_rows.size() || j < l.size() )
+    {
+        if( row < d_rows.size() && j < l.size() && d_rows[row] == l[j] )
+        {
+            d_rows[row].d_data = l[j].d_data;
+            row++;
+            j++;
+        }else if( row < d_rows.size() && ( j == l.size() || !EbnfErrors::lessThan( l[j], d_rows[row] ) ) )
+        {
+            int end = row + 1;
+            while( end < d_rows.size() && ( j == l.size() || EbnfErrors::lessThan( d_rows[end], l[j] ) ) )
+                end++;
+            beginRemoveRows( QModelIndex(), row, end - 1 );
+            d_rows.erase( d_rows.begin() + row, d_rows.begin() + end );
+            endRemoveRows();
+        }else
+        {
+            int end = j + 1;
+            while( end < l.size() && ( row == d_rows.size() || EbnfErrors::lessThan( l[end], d_rows[row] ) ) )
+                end++;
+            beginInsertRows( QModelIndex(), row, row + end - j - 1 );
+            for( int i = j; i < end; i++ )
+                d_rows.insert( row++, l[i] );
+            endInsertRows();
+            j = end;
+        }
+    }
+}
+
+const EbnfErrors::Entry* IssueMdl::getIssue(const QModelIndex& index) const
+{
+    if( !index.isValid() || index.row() >= d_rows.size() )
+        return 0;
+    return &d_rows[index.row()];
+}
+
+QModelIndex IssueMdl::findIssue(quint32 line, quint16 col) const
+{
+    // binary search for the first issue right of the position
+    int lo = 0;
+    int hi = d_rows.size();
+    while( lo < hi )
+    {
+        const int mid = ( lo + hi ) / 2;
+        const EbnfErrors::Entry& e = d_rows[mid];
+        if( e.d_line < line || ( e.d_line == line && e.d_col <= col ) )
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    if( lo > 0 && d_rows[lo-1].d_line == line )
+        return createIndex( lo - 1, 0 );
+    return QModelIndex();
+}
+
+int IssueMdl::getErrCount() const
+{
+    int res = 0;
+    foreach( const EbnfErrors::Entry& e, d_rows )
+    {
+        if( e.d_isErr )
+            res++;
+    }
+    return res;
+}
+
+QVariant IssueMdl::data(const QModelIndex& index, int role) const
+{
+    const EbnfErrors::Entry* e = getIssue(index);
+    if( e == 0 )
+        return QVariant();
+    switch( role )
+    {
+    case Qt::DisplayRole:
+        if( index.column() == 0 )
+            return QString("%1 : %2").arg(e->d_line).arg(e->d_col);
+        else
+            return e->d_msg.toString();
+    case Qt::ToolTipRole:
+        if( index.column() == 1 )
+            return e->d_msg.toString();
+        break;
+    case Qt::DecorationRole:
+        if( index.column() == 0 )
+            return e->d_isErr ? d_err : d_warn;
+        break;
+    }
+    return QVariant();
+}
+
+QModelIndex IssueMdl::index(int row, int column, const QModelIndex& parent) const
+{
+    if( !parent.isValid() && row >= 0 && row < d_rows.size() && column >= 0 && column < columnCount() )
+        return createIndex( row, column );
+    else
+        return QModelIndex();
+}
+
+int IssueMdl::rowCount(const QModelIndex& parent) const
+{
+    if( parent.isValid() )
+        return 0;
+    else
+        return d_rows.size();
+}
+
+Qt::ItemFlags IssueMdl::flags(const QModelIndex& index) const
+{
+    Q_UNUSED(index)
+    return Qt::ItemIsEnabled | Qt::ItemIsSelectable;
+}
@@ -0,0 +1,58 @@
+#ifndef ISSUEMDL_H
+#define ISSUEMDL_H
+
+/*
+* Copyright 2026 Rochus Keller <mailto:me@rochus-keller.ch>
+*
+* This file is part of the EbnfStudio application.
+*
+* The following is the license that applies to this copy of the
+* application. For a license to use the application under conditions
+* other than those described here, please email to me@rochus-keller.ch.
+*
+* GNU General Public License Usage
+* This file may be used under the terms of the GNU General Public
+* License (GPL) versions 2.0 or 3.0 as published by the Free Software
+* Foundation and appearing in the file LICENSE.GPL included in
+* the packaging of this file. Please review the following information
+* to ensure GNU General Public Licensing requirements will be met:
+* http://www.fsf.org/licensing/licenses/info/GPLv2.html and
+* http://www.gnu.org/copyleft/gpl.html.
+*/
+
+#include <QAbstractItemModel>
+#include <QPixmap>
+#include "EbnfErrors.h"
+
+class QTreeView;
+
+// Flat list of the issues in the order of EbnfErrors::getSorted. setIssues only inserts and
+// removes the rows which differ from the previous list, so the view keeps its selection and
+// only paints the visible rows; messages are composed when a row is painted.
+class IssueMdl : public QAbstractItemModel
+{
+public:
+    explicit IssueMdl(QTreeView *parent = 0);
+
+    QTreeView* getParent() const;
+    void setIssues( const EbnfErrors::EntryList& ); // must be sorted with EbnfErrors::lessThan
+    const EbnfErrors::Entry* getIssue( const QModelIndex& ) const;
+    const EbnfErrors::Entry& getIssue( int row ) const { return d_rows[row]; }
+    QModelIndex findIssue( quint32 line, quint16 col ) const; // the last one of the line left of col
+    int getErrCount() const;
+
+    // overrides
+    int columnCount ( const QModelIndex & parent = QModelIndex() ) const { return 2; }
+    QVariant data ( const QModelIndex & index, int role = Qt::DisplayRole ) const;
+    QModelIndex index ( int row, int column, const QModelIndex & parent = QModelIndex() ) const;
+    QModelIndex parent ( const QModelIndex & index ) const { return QModelIndex(); }
+    int rowCount ( const QModelIndex & parent = QModelIndex() ) const;
+    Qt::ItemFlags flags ( const QModelIndex & index ) const;
+
+private:
+    QList<EbnfErrors::Entry> d_rows;
+    QPixmap d_err;
+    QPixmap d_warn;
+};
+
+#endif // ISSUEMDL_H
@@ -0,0 +1,307 @@
+/*
+* Copyright 2026 Rochus Keller <mailto:me@rochus-keller.ch>
+*
+* This file is part of the EbnfStudio application.
+*
+* The following is the license that applies to this copy of the
+* application. For a license to use the application under conditions
+* other than those described here, please email to me@rochus-keller.ch.
+*
+* GNU General Public License Usage
+* This file may be used under the terms of the GNU General Public
+* License (GPL) versions 2.0 or 3.0 as published by the Free Software
+* Foundation and appearing in the file LICENSE.GPL included in
+* the packaging of this file. Please review the following information
+* to ensure GNU General Public Licensing requirements will be met:
+* http://www.fsf.org/licensing/licenses/info/GPLv2.html and
+* http://www.gnu.org/copyleft/gpl.html.
+*/
+
+#include "LlkTrie.h"
+#include <QSet>
+
+LlkTrie::LlkTrie()
+{
+    clear();
+}
+
+void LlkTrie::clear()
+{
+    d_nodes.clear();
+    d_edges.clear();
+    d_buckets.clear();
+    d_buckets.fill( Empty, 64 );
+    d_unite.clear();
+    d_intersect.clear();
+    d_truncate.clear();
+    d_concat.clear();
+    Node empty;
+    empty.d_first = 0;
+    empty.d_count = 0;
+    empty.d_hash = 0;
+    empty.d_end = false;
+    d_nodes.append( empty ); // Empty is never looked up, so it doesn't occupy a bucket
+    make( true, QVector<Edge>() ); // Epsilon
+    Q_ASSERT( d_nodes.size() == 2 );
+}
+
+LlkTrie::Ref LlkTrie::single(quint16 id)
+{
+    QVector<Edge> edges;
+    edges.append( Edge( id, Epsilon ) );
+    return make( false, edges );
+}
+
+LlkTrie::Ref LlkTrie::unite(LlkTrie::Ref a, LlkTrie::Ref b)
+{
+    if( a == b || b == Empty )
+        return a;
+    if( a == Empty )
+        return b;
+    if( a > b )
+        qSwap(a,b);
+    QHash<quint64,Ref>::const_iterator m = d_unite.constFind( key(a,b) );
+    if( m != d_unite.constEnd() )
+        return m.value();
+
+    const Node na = d_nodes[a];
+    const Node nb = d_nodes[b];
+    QVector<Edge> edges;
+    edges.reserve( na.d_count + nb.d_count );
+    quint32 i = 0, j = 0;
+    while( i < na.d_count || j < nb.d_count )
+    {
+        const Edge ea = i < na.d_count ? d_edges[ na.d_first + i ] : Edge();
+        const Edge eb = j < nb.d_count ? d_edges[ nb.d_first + j ] : Edge();
+        if( j >= nb.d_count || ( i < na.d_count && ea.d_id < eb.d_id ) )
+        {
+            edges.append( ea );
+            i++;
+        }else if( i >= na.d_count || eb.d_id < ea.d_id )
+        {
+            edges.append( eb );
+            j++;
+        }else
+        {
+            edges.append( Edge( ea.d_id, unite( ea.d_to, eb.d_to ) ) );
+            i++;
+            j++;
+        }
+    }
+    const Ref res = make( na.d_end || nb.d_end, edges );
+    d_unite.insert( key(a,b), res );
+    return res;
+}
+
+LlkTrie::Ref LlkTrie::intersect(LlkTrie::Ref a, LlkTrie::Ref b)
+{
+    if( a == b )
+        return a;
+    if( a == Empty || b == Empty )
+        return Empty;
+    if( a > b )
+        qSwap(a,b);
+    QHash<quint64,Ref>::const_iterator m = d_intersect.constFind( key(a,b) );
+    if( m != d_intersect.constEnd() )
+        return m.value();
+
+    const Node na = d_nodes[a];
+    const Node nb = d_nodes[b];
+    QVector<Edge> edges;
+    quint32 i = 0, j = 0;
+    while( i < na.d_count && j < nb.d_count )
+    {
+        const Edge ea = d_edges[ na.d_first + i ];
+        const Edge eb = d_edges[ nb.d_first + j ];
+        if( ea.d_id < eb.d_id )
+            i++;
+        else if( eb.d_id < ea.d_id )
+            j++;
+        else
+        {
+            const Ref sub = intersect( ea.d_to, eb.d_to );
+            if( sub != Empty )
+                edges.append( Edge( ea.d_id, sub ) );
+            i++;
+            j++;
+        }
+    }
+    const Ref res = make( na.d_end && nb.d_end, edges );
+    d_intersect.insert( key(a,b), res );
+    return res;
+}
+
+bool LlkTrie::intersects(LlkTrie::Ref a, LlkTrie::Ref b) const
+{
+    QSet<quint64> disjoint;
+    return intersectsImp( a, b, disjoint );
+}
+
+bool LlkTrie::intersectsImp(LlkTrie::Ref a, LlkTrie::Ref b, QSet<quint64>& disjoint) const
+{
+    if( a == Empty || b == Empty )
+        return false;
+    if( a == b )
+        return true;
+    const Node& na = d_nodes[a];
+    const Node& nb = d_nodes[b];
+    if( na.d_end && nb.d_end )
+        return true;
+    if( disjoint.contains( key(a,b) ) )
+        return false;
+    quint32 i = 0, j = 0;
+    while( i < na.d_count && j < nb.d_count )
+    {
+        const Edge& ea = d_edges[ na.d_first + i ];
+        const Edge& eb = d_edges[ nb.d_first + j ];
+        if( ea.d_id < eb.d_id )
+            i++;
+        else if( eb.d_id < ea.d_id )
+            j++;
+        else
+        {
+            if( intersectsImp( ea.d_to, eb.d_to, disjoint ) )
+                return true;
+            i++;
+            j++;
+        }
+    }
+    disjoint.insert( key(a,b) );
+    return false;
+}
+
+LlkTrie::Ref LlkTrie::concatK(LlkTrie::Ref lhs, LlkTrie::Ref rhs, quint16 k)
+{
+    return concatImp( lhs, rhs, k, true );
+}
+
+LlkTrie::Ref LlkTrie::concatImp(LlkTrie::Ref lhs, LlkTrie::Ref rhs, int budget, bool root)
+{
+    // budget is the number of ids which can still be appended to the prefix leading to lhs
+    if( lhs == Empty )
+        return Empty;
+    if( budget <= 0 )
+        return Epsilon; // prefix has length k, everything below is cut off
+    const int slot = budget * 2 + ( root ? 1 : 0 );
+    if( d_concat.size() <= slot )
+        d_concat.resize( slot + 1 );
+    QHash<quint64,Ref>::const_iterator m = d_concat[slot].constFind( key(lhs,rhs) );
+    if( m != d_concat[slot].constEnd() )
+        return m.value();
+
+    const Node n = d_nodes[lhs];
+    QVector<Edge> edges;
+    edges.reserve( n.d_count );
+    for( quint32 i = 0; i < n.d_count; i++ )
+    {
+        const Edge e = d_edges[ n.d_first + i ];
+        edges.append( Edge( e.d_id, concatImp( e.d_to, rhs, budget - 1, false ) ) );
+    }
+    bool end = false;
+    Ref rest = Empty;
+    if( n.d_end )
+    {
+        // same as EbnfAnalyzer2::concatK: the empty prefix takes rhs as is, a non-empty prefix
+        // is kept if rhs is empty
+        if( root )
+            rest = rhs;
+        else if( rhs == Empty )
+            end = true;
+        else
+            rest = truncate( rhs, budget );
+    }
+    const Ref res = unite( make( end, edges ), rest );
+    d_concat[slot].insert( key(lhs,rhs), res );
+    return res;
+}
+
+LlkTrie::Ref LlkTrie::truncate(LlkTrie::Ref r, int len)
+{
+    if( r == Empty )
+        return Empty;
+    if( len <= 0 )
+        return Epsilon;
+    const quint64 k = ( quint64(r) << 16 ) | quint16(len);
+    QHash<quint64,Ref>::const_iterator m = d_truncate.constFind( k );
+    if( m != d_truncate.constEnd() )
+        return m.value();
+
+    const Node n = d_nodes[r];
+    QVector<Edge> edges;
+    edges.reserve( n.d_count );
+    for( quint32 i = 0; i < n.d_count; i++ )
+    {
+        const Edge e = d_edges[ n.d_first + i ];
+        edges.append( Edge( e.d_id, truncate( e.d_to, len - 1 ) ) );
+    }
+    const Ref res = make( n.d_end, edges );
+    d_truncate.insert( k, res );
+    return res;
+}
+
+LlkTrie::Ref LlkTrie::withoutEpsilon(LlkTrie::Ref r)
+{
+    const Node n = d_nodes[r];
+    if( !n.d_end )
+        return r;
+    QVector<Edge> edges;
+    edges.reserve( n.d_count );
+    for( quint32 i = 0; i < n.d_count; i++ )
+        edges.append( d_edges[ n.d_first + i ] );
+    return make( false, edges );
+}
+
+LlkTrie::Ref LlkTrie::make(bool end, const QVector<LlkTrie::Edge>& edges)
+{
+    if( !end && edges.isEmpty() )
+        return Empty;
+
+    uint h = end ? 1 : 0;
+    for( int i = 0; i < edges.size(); i++ )
+        h ^= ( ( uint(edges[i].d_id) << 16 ) ^ edges[i].d_to ) + 0x9e3779b9 + ( h << 6 ) + ( h >> 2 );
+
+    const int mask = d_buckets.size() - 1;
+    int b = h & mask;
+    while( d_buckets[b] != Empty )
+    {
+        const Node& n = d_nodes[ d_buckets[b] ];
+        if( n.d_hash == h && n.d_end == end && n.d_count == quint32(edges.size()) )
+        {
+            bool same = true;
+            for( int i = 0; i < edges.size() && same; i++ )
+            {
+                const Edge& e = d_edges[ n.d_first + i ];
+                same = e.d_id == edges[i].d_id && e.d_to == edges[i].d_to;
+            }
+            if( same )
+                return d_buckets[b];
+        }
+        b = ( b + 1 ) & mask;
+    }
+
+    Node n;
+    n.d_first = d_edges.size();
+    n.d_count = edges.size();
+    n.d_hash = h;
+    n.d_end = end;
+    const Ref res = d_nodes.size();
+    d_nodes.append( n );
+    d_edges += edges;
+    d_buckets[b] = res;
+    if( d_nodes.size() * 2 > d_buckets.size() )
+        rehash();
+    return res;
+}
+
+void LlkTrie::rehash()
+{
+    d_buckets.fill( Empty, d_buckets.size() * 2 );
+    const int mask = d_buckets.size() - 1;
+    for( int i = Epsilon; i < d_nodes.size(); i++ )
+    {
+        int b = d_nodes[i].d_hash & mask;
+        while( d_buckets[b] != Empty )
+            b = ( b + 1 ) & mask;
+        d_buckets[b] = i;
+    }
+}
@@ -0,0 +1,86 @@
+#ifndef LLKTRIE_H
+#define LLKTRIE_H
+
+/*
+* Copyright 2026 Rochus Keller <mailto:me@rochus-keller.ch>
+*
+* This file is part of the EbnfStudio application.
+*
+* The following is the license that applies to this copy of the
+* application. For a license to use the application under conditions
+* other than those described here, please email to me@rochus-keller.ch.
+*
+* GNU General Public License Usage
+* This file may be used under the terms of the GNU General Public
+* License (GPL) versions 2.0 or 3.0 as published by the Free Software
+* Foundation and appearing in the file LICENSE.GPL included in
+* the packaging of this file. Please review the following information
+* to ensure GNU General Public Licensing requirements will be met:
+* http://www.fsf.org/licensing/licenses/info/GPLv2.html and
+* http://www.gnu.org/copyleft/gpl.html.
+*/
+
+#include <QVector>
+#include <QHash>
+#include <QSet>
+
+// Sets of First_k sequences (terminal ids, see Ast::Node::d_termId) represented as prefix tries.
+// All trie nodes are hash-consed in one pool, so equal sets have equal Refs, common suffixes are
+// shared, and concatK grafts the right set below the leaves of the left one instead of building
+// the cross product. Nodes are immutable and live until clear().
+class LlkTrie
+{
+public:
+    typedef quint32 Ref;
+    enum { Empty = 0,   // the empty set
+           Epsilon = 1  // the set only containing the empty sequence
+         };
+
+    LlkTrie();
+    void clear();
+
+    Ref single( quint16 id );
+    Ref unite( Ref, Ref );
+    Ref intersect( Ref, Ref );
+    bool intersects( Ref, Ref ) const; // walks both tries in lockstep, stops at the first common sequence
+    Ref concatK( Ref lhs, Ref rhs, quint16 k ); // same semantics as EbnfAnalyzer2::concatK
+    Ref truncate( Ref, int len );
+    Ref withoutEpsilon( Ref );
+    Ref withEpsilon( Ref r ) { return unite( r, Epsilon ); }
+
+    bool hasEpsilon( Ref r ) const { return d_nodes[r].d_end; }
+    int edgeCount( Ref r ) const { return d_nodes[r].d_count; }
+    quint16 edgeId( Ref r, int i ) const { return d_edges[ d_nodes[r].d_first + i ].d_id; }
+    Ref edgeTarget( Ref r, int i ) const { return d_edges[ d_nodes[r].d_first + i ].d_to; }
+    int nodeCount() const { return d_nodes.size(); }
+private:
+    Q_DISABLE_COPY(LlkTrie)
+    struct Edge
+    {
+        quint16 d_id;
+        Ref d_to;
+        Edge( quint16 id = 0, Ref to = Empty ):d_id(id),d_to(to){}
+    };
+    struct Node
+    {
+        quint32 d_first; // index in d_edges; edges are sorted by id
+        quint32 d_count;
+        uint d_hash;
+        bool d_end; // the sequence leading here is part of the set
+    };
+    Ref make( bool end, const QVector<Edge>& );
+    Ref concatImp( Ref lhs, Ref rhs, int budget, bool root );
+    bool intersectsImp( Ref, Ref, QSet<quint64>& disjoint ) const;
+    static quint64 key( Ref a, Ref b ) { return ( quint64(a) << 32 ) | b; }
+    void rehash();
+
+    QVector<Node> d_nodes;
+    QVector<Edge> d_edges;
+    QVector<Ref> d_buckets; // open addressing over d_nodes by content, size is a power of two
+    QHash<quint64,Ref> d_unite;
+    QHash<quint64,Ref> d_intersect;
+    QHash<quint64,Ref> d_truncate;
+    QVector< QHash<quint64,Ref> > d_concat; // index budget * 2 + root
+};
+
+#endif // LLKTRIE_H
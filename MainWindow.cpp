@@ -25,6 +25,7 @@
 #include "EbnfAnalyzer.h"
 #include "SyntaxTools.h"
 #include "SyntaxTreeMdl.h"
+#include "IssueMdl.h"
 #include "SynTreeGen.h"
 #include "GenUtils.h"
 #include "CocoGen.h"
@@ -49,10 +50,12 @@
 #include <QVBoxLayout>
 #include <QLabel>
 #include <QClipboard>
+#include <QInputDialog>
+#include <QThread>
 #include <GuiTools/AutoMenu.h>
 
 MainWindow::MainWindow(QWidget *parent)
-    : QMainWindow(parent),d_exact(false)
+    : QMainWindow(parent),d_exact(false),d_threads(1)
 {
     d_tbl = new FirstFollowSet(this);
     d_edit = new EbnfEditor(this);
@@ -87,6 +90,7 @@ MainWindow::MainWindow(QWidget *parent)
     const QVariant state = s.value( "DockState" );
     if( !state.isNull() )
         restoreState( state.toByteArray() );
+    d_threads = qMax( 1, s.value( "AnalysisThreads", 1 ).toInt() );
 }
 
 MainWindow::~MainWindow()
@@ -113,56 +117,32 @@ void MainWindow::onCaption()
     }
 }
 
-static bool errorEntryLessThan(const EbnfErrors::Entry &s1, const EbnfErrors::Entry &s2)
-{
-    return s1.d_line < s2.d_line ||
-            ( !(s2.d_line < s1.d_line) && s1.d_col < s2.d_col );
-}
-
 void MainWindow::onErrors()
 {
-    d_errView->clear();
     d_errDetails->clear();
     d_pathView->clear();
-    QList<EbnfErrors::Entry> errs = d_edit->getErrs()->getErrors().toList();
-    std::sort(errs.begin(), errs.end(), errorEntryLessThan );
-    //qDebug() << errs.size() << "errors found";
-
-    for( int i = 0; i < errs.size(); i++ )
-    {
-        QTreeWidgetItem* item = new QTreeWidgetItem(d_errView);
-        item->setText(1, errs[i].d_msg );
-        item->setToolTip(1, item->text(1) );
-        if( errs[i].d_isErr )
-            item->setIcon(0, QPixmap(":/images/exclamation-red.png") );
-        else
-            item->setIcon(0, QPixmap(":/images/exclamation-circle.png") );
-        item->setText(0, QString("%1 : %2").arg(errs[i].d_line).arg(errs[i].d_col));
-        item->setData(0, Qt::UserRole, errs[i].d_line );
-        item->setData(0, Qt::UserRole+1, errs[i].d_data );
-        item->setData(1, Qt::UserRole, errs[i].d_col );
-        item->setData(1, Qt::UserRole+1, errs[i].d_isErr );
-    }
-    if( errs.size() )
-        d_errView->parentWidget()->show();
+    d_issues->setIssues( d_edit->getErrs()->getSorted() );
+    if( d_issues->rowCount() )
+        d_issues->getParent()->parentWidget()->show();
 }
 
 void MainWindow::onErrorsDblClicked()
 {
-    QTreeWidgetItem* item = d_errView->currentItem();
-    if( item )
+    const EbnfErrors::Entry* e = d_issues->getIssue( d_issues->getParent()->currentIndex() );
+    if( e )
     {
         const bool blocked = d_edit->blockSignals(true);
-        d_edit->setCursorPosition( item->data(0, Qt::UserRole ).toInt() - 1,
-                                   item->data(1, Qt::UserRole ).toInt() - 1, true );
+        d_edit->setCursorPosition( e->d_line - 1, e->d_col - 1, true );
         d_edit->blockSignals(blocked);
+        // the entry is invalid from here on if the issues changed meanwhile
+        const QVariant data = e->d_data;
+        d_errText->setText(QString("<html><a href='%1:%2'>%1 : %2</a> %3</html>").arg(e->d_line).arg(e->d_col).
+                           arg(e->d_msg.toString().toHtmlEscaped() ));
         onCursorChanged();
         d_edit->setFocus();
 
-        d_errText->setText(QString("<html><a href='%1'>%1</a> %2</html>").arg(item->text(0)).
-                           arg(item->text(1).toHtmlEscaped() ));
         d_errDetails->clear();
-        EbnfSyntax::IssueData d = item->data(0,Qt::UserRole+1).value<EbnfSyntax::IssueData>();
+        EbnfSyntax::IssueData d = data.value<EbnfSyntax::IssueData>();
         if( d.d_type )
         {
             foreach( const Ast::Node* r, d.d_list )
@@ -183,32 +163,20 @@ void MainWindow::onErrorsDblClicked()
     }
 }
 
-static bool UsedByLessThan( const Ast::Node* lhs, const Ast::Node* rhs )
-{
-    return lhs->d_tok.d_lineNr < rhs->d_tok.d_lineNr ||
-            (!(rhs->d_tok.d_lineNr < lhs->d_tok.d_lineNr) &&
-             lhs->d_tok.d_colNr < rhs->d_tok.d_colNr );
-}
-
 void MainWindow::onCursorChanged()
 {
     int line, col;
     d_edit->getCursorPosition( &line, &col );
     line += 1;
     col += 1;
-    for( int i = 0; i < d_errView->topLevelItemCount(); i++ )
+    // the last issue of the line starting at or before the cursor
+    const QModelIndex issue = d_issues->findIssue( line, col );
+    if( issue.isValid() )
     {
-        QTreeWidgetItem* item = d_errView->topLevelItem(i);
-        const int itemLine = item->data(0, Qt::UserRole ).toInt();
-        if( itemLine == line && item->data(1, Qt::UserRole ).toInt() <= col )
-        {
-            d_errView->setCurrentItem(item);
-            d_errView->scrollToItem( item ); // QAbstractItemView::EnsureVisible
-            d_errView->parentWidget()->show();
-        }
-        if( itemLine > line )
-            break;
-        // TODO: allenfalls binary search fall nötig
+        QTreeView* view = d_issues->getParent();
+        view->setCurrentIndex(issue);
+        view->scrollTo( issue ); // QAbstractItemView::EnsureVisible
+        view->parentWidget()->show();
     }
     QModelIndex index = d_mdl->findSymbol( line, col );
     if( index.isValid() )
@@ -220,8 +188,7 @@ void MainWindow::onCursorChanged()
         if( sym )
         {
 #if 1
-            Ast::ConstNodeList backrefs = d_edit->getSyntax()->getBackRefs(sym);
-            std::sort( backrefs.begin(), backrefs.end(), UsedByLessThan );
+            const Ast::ConstNodeList backrefs = d_edit->getSyntax()->getBackRefs(sym); // in source order
             EbnfEditor::SymList syms;
             foreach( const Ast::NodeRef& r, backrefs )
             {
@@ -390,6 +357,8 @@ static void expandSel( QTreeView* t, const QModelIndex& index )
     if( !index.isValid() )
         return;
     t->setExpanded(index, true);
+    if( t->model()->canFetchMore(index) )
+        t->model()->fetchMore(index);
     for( int i = 0; i < t->model()->rowCount(index); i++ )
         expandSel( t, t->model()->index(i,0,index) );
 }
@@ -529,20 +498,19 @@ void MainWindow::onFindAmbig()
 {
     ENABLED_IF(true);
 
-    d_tbl->setSyntax(d_edit->getSyntax());
-    if( d_exact )
-    {
-        // ~1000 times more expensive!
-        QApplication::setOverrideCursor( Qt::WaitCursor);
-        EbnfAnalyzer2 a;
-        a.checkForAmbiguity( d_tbl, d_edit->getErrs() );
-        QApplication::restoreOverrideCursor();
-    }else
-    {
-        EbnfAnalyzer a;
-        a.checkForAmbiguity( d_tbl, d_edit->getErrs() );
-    }
-    d_edit->updateExtraSelections();
+    // runs in the background; the exact algorithm is ~1000 times more expensive!
+    d_edit->analyze( d_exact ? AnalysisService::AnalyzeExact : AnalysisService::Analyze, d_threads );
+}
+
+void MainWindow::onAnalyzed()
+{
+    // take over the table the analysis was based on, it fits the current syntax of the editor
+    FirstFollowSet* tbl = d_edit->takeAnalysisTable();
+    if( tbl == 0 )
+        return;
+    delete d_tbl;
+    d_tbl = tbl;
+    d_tbl->setParent(this);
 }
 
 void MainWindow::onReloadKeywords()
@@ -655,10 +623,10 @@ void MainWindow::onTransformAlgolEbnf()
 
 void MainWindow::onCopyIssue()
 {
-    QList<QTreeWidgetItem*> sel = d_errView->selectedItems();
-    ENABLED_IF(!sel.isEmpty());
+    const EbnfErrors::Entry* e = d_issues->getIssue( d_issues->getParent()->currentIndex() );
+    ENABLED_IF( e != 0 );
 
-    QString text = sel.first()->text(0) + ": " + sel.first()->text(1);
+    QString text = QString("%1 : %2: %3").arg(e->d_line).arg(e->d_col).arg(e->d_msg.toString());
     QApplication::clipboard()->setText(text);
 }
 
@@ -668,15 +636,13 @@ void MainWindow::onCopyAllIssues()
 
     QString text;
     QTextStream out(&text);
-    int errs = 0;
-    for( int i = 0; i < d_errView->topLevelItemCount(); i++ )
+    for( int i = 0; i < d_issues->rowCount(); i++ )
     {
-        QTreeWidgetItem* item = d_errView->topLevelItem(i);
-        out << item->text(0) << ": " << item->text(1) << endl;
-        if( item->data(1, Qt::UserRole+1).toBool() )
-            errs++;
+        const EbnfErrors::Entry& e = d_issues->getIssue(i);
+        out << e.d_line << " : " << e.d_col << ": " << e.d_msg.toString() << endl;
     }
-    out << errs << " errors, " << ( d_errView->topLevelItemCount() - errs ) << " warnings" << endl;
+    const int errs = d_issues->getErrCount();
+    out << errs << " errors, " << ( d_issues->rowCount() - errs ) << " warnings" << endl;
     out.flush();
     QApplication::clipboard()->setText(text);
 }
@@ -688,6 +654,21 @@ void MainWindow::onExact()
     d_exact = !d_exact;
 }
 
+void MainWindow::onThreads()
+{
+    ENABLED_IF(true);
+
+    bool ok;
+    const int n = QInputDialog::getInt( this, tr("Analysis Threads"),
+                                        tr("Number of threads used by the exact algorithm:"), d_threads,
+                                        1, qMax( 64, QThread::idealThreadCount() ), 1, &ok );
+    if( !ok )
+        return;
+    d_threads = n;
+    QSettings s;
+    s.setValue( "AnalysisThreads", d_threads );
+}
+
 void MainWindow::createMenus()
 {
     Gui::AutoMenu* file = new Gui::AutoMenu( tr("File"), this, true );
@@ -730,6 +711,7 @@ void MainWindow::createMenus()
     //analyze->addCommand( "Calculate First Set", this, SLOT(onOutputFirstSet()) );
     analyze->addCommand( "Find ambiguities", this, SLOT(onFindAmbig() ), tr("CTRL+SHIFT+A"), true );
     analyze->addCommand( "Use exact algorithm", this, SLOT(onExact() ) );
+    analyze->addCommand( "Analysis threads...", this, SLOT(onThreads() ) );
 
     Gui::AutoMenu* generate = new Gui::AutoMenu( tr("Generate"), this, true );
     generate->addCommand( "Generate C++ Parser", this, SLOT(onGenCpp()) );
@@ -760,22 +742,24 @@ void MainWindow::createIssues()
     dock->setObjectName("Issues");
     dock->setAllowedAreas( Qt::AllDockWidgetAreas );
     dock->setFeatures( QDockWidget::DockWidgetMovable | QDockWidget::DockWidgetClosable );
-    d_errView = new QTreeWidget(dock);
-    d_errView->setSizePolicy(QSizePolicy::MinimumExpanding,QSizePolicy::Preferred);
-    d_errView->setAlternatingRowColors(true);
-    d_errView->setHeaderHidden(true);
-    d_errView->setSortingEnabled(false);
-    d_errView->setAllColumnsShowFocus(true);
-    d_errView->setRootIsDecorated(false);
-    d_errView->setColumnCount(2);
-    d_errView->header()->setSectionResizeMode(0, QHeaderView::ResizeToContents);
-    d_errView->header()->setSectionResizeMode(1, QHeaderView::Stretch);
-    dock->setWidget(d_errView);
+    QTreeView* view = new QTreeView(dock);
+    d_issues = new IssueMdl(view);
+    view->setModel(d_issues);
+    view->setSizePolicy(QSizePolicy::MinimumExpanding,QSizePolicy::Preferred);
+    view->setAlternatingRowColors(true);
+    view->setHeaderHidden(true);
+    view->setSortingEnabled(false);
+    view->setAllColumnsShowFocus(true);
+    view->setRootIsDecorated(false);
+    view->setUniformRowHeights(true);
+    view->header()->setSectionResizeMode(0, QHeaderView::ResizeToContents);
+    view->header()->setSectionResizeMode(1, QHeaderView::Stretch);
+    dock->setWidget(view);
     addDockWidget( Qt::BottomDockWidgetArea, dock );
-    connect(d_errView, SIGNAL(itemDoubleClicked(QTreeWidgetItem*,int)), this, SLOT(onErrorsDblClicked()) );
+    connect(view, SIGNAL(doubleClicked(QModelIndex)), this, SLOT(onErrorsDblClicked()) );
     connect( new QShortcut( tr("ESC"), this ), SIGNAL(activated()), dock, SLOT(hide()) );
 
-    Gui::AutoMenu* pop = new Gui::AutoMenu(d_errView,true);
+    Gui::AutoMenu* pop = new Gui::AutoMenu(view,true);
     pop->addCommand( "Copy issue", this, SLOT(onCopyIssue()) );
     pop->addCommand( "Copy all issues", this, SLOT(onCopyAllIssues()) );
 
@@ -799,6 +783,7 @@ void MainWindow::createTree()
     dock->setWidget(tree);
     addDockWidget( Qt::LeftDockWidgetArea, dock );
     connect( d_edit, SIGNAL(sigSyntaxUpdated()), this, SLOT(onSyntaxUpdated()) );
+    connect( d_edit, SIGNAL(sigAnalyzed()), this, SLOT(onAnalyzed()) );
     connect( tree, SIGNAL(doubleClicked(QModelIndex)), this, SLOT(onTreeDblClicked()) );
     Gui::AutoMenu* pop = new Gui::AutoMenu( tree, true );
     pop->addAction(tr("Expand all"), tree, SLOT(expandAll()) );
@@ -25,6 +25,7 @@
 class EbnfEditor;
 class QTreeWidget;
 class SyntaxTreeMdl;
+class IssueMdl;
 class FirstFollowSet;
 class QLabel;
 
@@ -62,6 +63,7 @@ protected slots:
     void onOutputFirstSet();
     void onUsedByDblClicked();
     void onFindAmbig();
+    void onAnalyzed();
     void onReloadKeywords();
     void onAbout();
     void onDetailsDblClicked();
@@ -71,6 +73,7 @@ protected slots:
     void onCopyIssue();
     void onCopyAllIssues();
     void onExact();
+    void onThreads();
 
 protected:
     void createMenus();
@@ -86,7 +89,7 @@ protected:
     void closeEvent ( QCloseEvent * event );
 private:
     EbnfEditor* d_edit;
-    QTreeWidget* d_errView;
+    IssueMdl* d_issues;
     QTreeWidget* d_usedBy;
     QTreeWidget* d_errDetails;
     QTreeWidget* d_pathView;
@@ -94,6 +97,7 @@ private:
     SyntaxTreeMdl* d_mdl;
     FirstFollowSet* d_tbl;
     bool d_exact;
+    int d_threads; // for the exact algorithm
 };
 
 #endif // MAINWINDOW_H
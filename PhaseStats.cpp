@@ -0,0 +1,176 @@
+/*
+* Copyright 2026 Rochus Keller <mailto:me@rochus-keller.ch>
+*
+* This file is part of the EbnfStudio application.
+*
+* The following is the license that applies to this copy of the
+* application. For a license to use the application under conditions
+* other than those described here, please email to me@rochus-keller.ch.
+*
+* GNU General Public License Usage
+* This file may be used under the terms of the GNU General Public
+* License (GPL) versions 2.0 or 3.0 as published by the Free Software
+* Foundation and appearing in the file LICENSE.GPL included in
+* the packaging of this file. Please review the following information
+* to ensure GNU General Public Licensing requirements will be met:
+* http://www.fsf.org/licensing/licenses/info/GPLv2.html and
+* http://www.gnu.org/copyleft/gpl.html.
+*/
+
+#include "PhaseStats.h"
+#include "Tracer.h"
+#ifdef Q_OS_WIN
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+PhaseStats::PhaseStats(const QByteArray& name):d_name(name),d_peakMemory(0)
+{
+}
+
+void PhaseStats::start(const char* phase)
+{
+    stop();
+    d_running = phase;
+    d_timer.start();
+}
+
+void PhaseStats::startSeparate(const char* phase)
+{
+    start( phase );
+    if( !d_separate.contains( d_running ) )
+        d_separate.append( d_running );
+}
+
+void PhaseStats::stop()
+{
+    if( d_running.isEmpty() )
+        return;
+    addTime( d_running.constData(), d_timer.nsecsElapsed() );
+    d_running.clear();
+}
+
+void PhaseStats::addTime(const char* phase, qint64 nsecs)
+{
+    for( int i = 0; i < d_phases.size(); i++ )
+    {
+        if( d_phases[i].first == phase )
+        {
+            d_phases[i].second += nsecs;
+            return;
+        }
+    }
+    d_phases.append( qMakePair( QByteArray(phase), nsecs ) );
+}
+
+void PhaseStats::addCounter(const QByteArray& name, qint64 value)
+{
+    d_counters.append( qMakePair( name, value ) );
+}
+
+void PhaseStats::addFixpoint(const QByteArray& name, const FixpointSolver::Stats& s)
+{
+    addCounter( name + ".updates", s.d_updates );
+    addCounter( name + ".variables", s.d_vars );
+    addCounter( name + ".components", s.d_components );
+}
+
+void PhaseStats::setPeakMemory()
+{
+    d_peakMemory = getPeakMemory();
+}
+
+qint64 PhaseStats::getTime(const char* phase) const
+{
+    for( int i = 0; i < d_phases.size(); i++ )
+    {
+        if( d_phases[i].first == phase )
+            return d_phases[i].second;
+    }
+    return 0;
+}
+
+static QByteArray toMs( qint64 nsecs )
+{
+    return QByteArray::number( double(nsecs) / 1000000.0, 'f', 3 );
+}
+
+QByteArray PhaseStats::toText() const
+{
+    QByteArray res;
+    if( !d_name.isEmpty() )
+        res += "*** " + d_name + "\n";
+    int width = 0;
+    for( int i = 0; i < d_phases.size(); i++ )
+        width = qMax( width, d_phases[i].first.size() );
+    for( int i = 0; i < d_counters.size(); i++ )
+        width = qMax( width, d_counters[i].first.size() );
+    qint64 total = 0;
+    for( int i = 0; i < d_phases.size(); i++ )
+    {
+        res += "    " + d_phases[i].first.leftJustified( width ) + " " +
+                toMs( d_phases[i].second ).rightJustified( 12 ) + " ms";
+        if( d_separate.contains( d_phases[i].first ) )
+            res += " (separate pass, not in total)";
+        else
+            total += d_phases[i].second;
+        res += "\n";
+    }
+    res += "    " + QByteArray("total").leftJustified( width ) + " " + toMs( total ).rightJustified( 12 ) + " ms\n";
+    for( int i = 0; i < d_counters.size(); i++ )
+        res += "    " + d_counters[i].first.leftJustified( width ) + " " +
+                QByteArray::number( d_counters[i].second ).rightJustified( 12 ) + "\n";
+    if( d_peakMemory > 0 )
+        res += "    " + QByteArray("peak memory").leftJustified( width ) + " " +
+                QByteArray::number( d_peakMemory ).rightJustified( 12 ) + " KB\n";
+    return res;
+}
+
+QByteArray PhaseStats::toJson() const
+{
+    // the separate measurements are listed apart from the phases of the pipeline
+    QByteArray phases, separate;
+    for( int i = 0; i < d_phases.size(); i++ )
+    {
+        QByteArray& l = d_separate.contains( d_phases[i].first ) ? separate : phases;
+        if( !l.isEmpty() )
+            l += ",";
+        l += Tracer::quoted( d_phases[i].first ) + ":" + toMs( d_phases[i].second );
+    }
+    QByteArray res = "{\"name\":" + Tracer::quoted( d_name ) + ",\"phases\":{" + phases + "}";
+    if( !separate.isEmpty() )
+        res += ",\"separate\":{" + separate + "}";
+    res += ",\"counters\":{";
+    for( int i = 0; i < d_counters.size(); i++ )
+    {
+        if( i != 0 )
+            res += ",";
+        res += Tracer::quoted( d_counters[i].first ) + ":" + QByteArray::number( d_counters[i].second );
+    }
+    res += "}";
+    if( d_peakMemory > 0 )
+        res += ",\"peakMemoryKB\":" + QByteArray::number( d_peakMemory );
+    res += "}";
+    return res;
+}
+
+qint64 PhaseStats::getPeakMemory()
+{
+#ifdef Q_OS_WIN
+    PROCESS_MEMORY_COUNTERS pmc;
+    if( GetProcessMemoryInfo( GetCurrentProcess(), &pmc, sizeof(pmc) ) )
+        return pmc.PeakWorkingSetSize / 1024;
+    return 0;
+#else
+    struct rusage u;
+    if( getrusage( RUSAGE_SELF, &u ) != 0 )
+        return 0;
+#ifdef Q_OS_MAC
+    return u.ru_maxrss / 1024; // bytes
+#else
+    return u.ru_maxrss; // KB
+#endif
+#endif
+}
@@ -0,0 +1,58 @@
+#ifndef PHASESTATS_H
+#define PHASESTATS_H
+
+/*
+* Copyright 2026 Rochus Keller <mailto:me@rochus-keller.ch>
+*
+* This file is part of the EbnfStudio application.
+*
+* The following is the license that applies to this copy of the
+* application. For a license to use the application under conditions
+* other than those described here, please email to me@rochus-keller.ch.
+*
+* GNU General Public License Usage
+* This file may be used under the terms of the GNU General Public
+* License (GPL) versions 2.0 or 3.0 as published by the Free Software
+* Foundation and appearing in the file LICENSE.GPL included in
+* the packaging of this file. Please review the following information
+* to ensure GNU General Public Licensing requirements will be met:
+* http://www.fsf.org/licensing/licenses/info/GPLv2.html and
+* http://www.gnu.org/copyleft/gpl.html.
+*/
+
+#include <QByteArray>
+#include <QList>
+#include <QPair>
+#include <QElapsedTimer>
+#include "FixpointSolver.h"
+
+// Timings of consecutive named phases and named counters of one run, reported as text or as
+// JSON (see ebnfc --stats). Counters are kept in the order they were added.
+class PhaseStats
+{
+public:
+    explicit PhaseStats( const QByteArray& name = QByteArray() );
+    void start( const char* phase ); // stops the running phase
+    void startSeparate( const char* phase ); // a measurement besides the pipeline, not in the total
+    void stop();
+    void addTime( const char* phase, qint64 nsecs ); // measured elsewhere
+    void addCounter( const QByteArray& name, qint64 value );
+    void addFixpoint( const QByteArray& name, const FixpointSolver::Stats& ); // updates, variables, components
+    void setPeakMemory(); // of the process, in KB, 0 if not supported
+
+    qint64 getTime( const char* phase ) const; // nanoseconds, summed over all runs of the phase
+    QByteArray toText() const;
+    QByteArray toJson() const;
+
+    static qint64 getPeakMemory();
+private:
+    QByteArray d_name;
+    QList< QPair<QByteArray,qint64> > d_phases; // nanoseconds
+    QList<QByteArray> d_separate; // phases not counted in the total
+    QList< QPair<QByteArray,qint64> > d_counters;
+    QElapsedTimer d_timer;
+    QByteArray d_running;
+    qint64 d_peakMemory;
+};
+
+#endif // PHASESTATS_H
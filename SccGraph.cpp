@@ -0,0 +1,114 @@
+/*
+* Copyright 2026 Rochus Keller <mailto:me@rochus-keller.ch>
+*
+* This file is part of the EbnfStudio application.
+*
+* The following is the license that applies to this copy of the
+* application. For a license to use the application under conditions
+* other than those described here, please email to me@rochus-keller.ch.
+*
+* GNU General Public License Usage
+* This file may be used under the terms of the GNU General Public
+* License (GPL) versions 2.0 or 3.0 as published by the Free Software
+* Foundation and appearing in the file LICENSE.GPL included in
+* the packaging of this file. Please review the following information
+* to ensure GNU General Public Licensing requirements will be met:
+* http://www.fsf.org/licensing/licenses/info/GPLv2.html and
+* http://www.gnu.org/copyleft/gpl.html.
+*/
+
+#include "SccGraph.h"
+#include <QPair>
+#include <algorithm>
+
+SccGraph::SccGraph(int vertexCount)
+{
+    reset(vertexCount);
+}
+
+void SccGraph::reset(int vertexCount)
+{
+    d_edges.clear();
+    d_edges.resize(vertexCount);
+    d_selfLoop.fill(false, vertexCount);
+    d_comps.clear();
+    d_compOf.clear();
+}
+
+void SccGraph::addEdge(int from, int to)
+{
+    Q_ASSERT( from >= 0 && from < d_edges.size() && to >= 0 && to < d_edges.size() );
+    if( from == to )
+        d_selfLoop[from] = true;
+    else
+        d_edges[from].append(to);
+}
+
+bool SccGraph::isCyclic(int comp) const
+{
+    const QVector<int>& c = d_comps[comp];
+    return c.size() > 1 || d_selfLoop[c.first()];
+}
+
+void SccGraph::calcComponents()
+{
+    // a component is emitted after all components it has edges to
+    const int n = d_edges.size();
+    d_comps.clear();
+    d_compOf.fill(-1, n);
+    QVector<int> index(n, -1);
+    QVector<int> low(n, 0);
+    QVector<bool> onStack(n, false);
+    QVector<int> stack;
+    QVector< QPair<int,int> > calls; // vertex, next edge to visit
+    int counter = 0;
+    for( int root = 0; root < n; root++ )
+    {
+        if( index[root] != -1 )
+            continue;
+        index[root] = low[root] = counter++;
+        stack.append(root);
+        onStack[root] = true;
+        calls.append(qMakePair(root, 0));
+        while( !calls.isEmpty() )
+        {
+            const int v = calls.last().first;
+            const int e = calls.last().second;
+            if( e < d_edges[v].size() )
+            {
+                calls.last().second = e + 1;
+                const int w = d_edges[v][e];
+                if( index[w] == -1 )
+                {
+                    index[w] = low[w] = counter++;
+                    stack.append(w);
+                    onStack[w] = true;
+                    calls.append(qMakePair(w, 0));
+                }else if( onStack[w] )
+                    low[v] = qMin(low[v], index[w]);
+                continue;
+            }
+            calls.removeLast();
+            if( !calls.isEmpty() )
+            {
+                const int u = calls.last().first;
+                low[u] = qMin(low[u], low[v]);
+            }
+            if( low[v] == index[v] )
+            {
+                QVector<int> comp;
+                int w;
+                do
+                {
+                    w = stack.last();
+                    stack.removeLast();
+                    onStack[w] = false;
+                    d_compOf[w] = d_comps.size();
+                    comp.append(w);
+                }while( w != v );
+                std::sort( comp.begin(), comp.end() );
+                d_comps.append(comp);
+            }
+        }
+    }
+}
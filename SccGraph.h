@@ -0,0 +1,52 @@
+#ifndef SCCGRAPH_H
+#define SCCGRAPH_H
+
+/*
+* Copyright 2026 Rochus Keller <mailto:me@rochus-keller.ch>
+*
+* This file is part of the EbnfStudio application.
+*
+* The following is the license that applies to this copy of the
+* application. For a license to use the application under conditions
+* other than those described here, please email to me@rochus-keller.ch.
+*
+* GNU General Public License Usage
+* This file may be used under the terms of the GNU General Public
+* License (GPL) versions 2.0 or 3.0 as published by the Free Software
+* Foundation and appearing in the file LICENSE.GPL included in
+* the packaging of this file. Please review the following information
+* to ensure GNU General Public Licensing requirements will be met:
+* http://www.fsf.org/licensing/licenses/info/GPLv2.html and
+* http://www.gnu.org/copyleft/gpl.html.
+*/
+
+#include <QVector>
+#include <QList>
+
+// Directed graph over the vertices 0..n-1, split into strongly connected components (Tarjan,
+// without recursion). The components are listed in reverse topological order, i.e. a component
+// comes after all components it has edges to; the members of a component are ascending.
+class SccGraph
+{
+public:
+    explicit SccGraph( int vertexCount = 0 );
+    void reset( int vertexCount );
+    void addEdge( int from, int to ); // from == to is allowed
+    void calcComponents();
+
+    int getVertexCount() const { return d_edges.size(); }
+    const QVector<int>& getEdges( int v ) const { return d_edges[v]; } // without the self loop
+    bool hasSelfLoop( int v ) const { return d_selfLoop[v]; }
+
+    // valid after calcComponents()
+    const QList< QVector<int> >& getComponents() const { return d_comps; }
+    int getComponentOf( int v ) const { return d_compOf[v]; }
+    bool isCyclic( int comp ) const; // more than one member or a self loop
+private:
+    QVector< QVector<int> > d_edges;
+    QVector<bool> d_selfLoop;
+    QList< QVector<int> > d_comps;
+    QVector<int> d_compOf;
+};
+
+#endif // SCCGRAPH_H
@@ -0,0 +1,66 @@
+/*
+* Copyright 2026 Rochus Keller <mailto:me@rochus-keller.ch>
+*
+* This file is part of the EbnfStudio application.
+*
+* The following is the license that applies to this copy of the
+* application. For a license to use the application under conditions
+* other than those described here, please email to me@rochus-keller.ch.
+*
+* GNU General Public License Usage
+* This file may be used under the terms of the GNU General Public
+* License (GPL) versions 2.0 or 3.0 as published by the Free Software
+* Foundation and appearing in the file LICENSE.GPL included in
+* the packaging of this file. Please review the following information
+* to ensure GNU General Public Licensing requirements will be met:
+* http://www.fsf.org/licensing/licenses/info/GPLv2.html and
+* http://www.gnu.org/copyleft/gpl.html.
+*/
+
+#include "SymbolTable.h"
+#include <string.h>
+
+EbnfToken::Sym SymbolTable::intern(const QByteArray& str)
+{
+    if( str.isEmpty() )
+        return EbnfToken::Sym::empty();
+    QMutexLocker lock(&d_lock);
+    QHash<QByteArray,EbnfToken::Sym>::const_iterator i = d_syms.find(str);
+    if( i != d_syms.end() )
+        return i.value();
+    char* mem = (char*)d_arena.allocate( sizeof(quint32) + str.size() + 1 );
+    *reinterpret_cast<quint32*>(mem) = str.size();
+    char* s = mem + sizeof(quint32);
+    ::memcpy( s, str.constData(), str.size() );
+    s[str.size()] = 0;
+    const EbnfToken::Sym sym(s);
+    d_syms.insert( QByteArray::fromRawData( s, str.size() ), sym );
+    return sym;
+}
+
+EbnfToken::Sym SymbolTable::find(const QByteArray& str) const
+{
+    if( str.isEmpty() )
+        return EbnfToken::Sym::empty();
+    QMutexLocker lock(&d_lock);
+    return d_syms.value(str);
+}
+
+void SymbolTable::clear()
+{
+    QMutexLocker lock(&d_lock);
+    d_syms.clear();
+    d_arena.clear();
+}
+
+int SymbolTable::getCount() const
+{
+    QMutexLocker lock(&d_lock);
+    return d_syms.size();
+}
+
+quint32 SymbolTable::getAllocated() const
+{
+    QMutexLocker lock(&d_lock);
+    return d_arena.getAllocated();
+}
@@ -0,0 +1,52 @@
+#ifndef SYMBOLTABLE_H
+#define SYMBOLTABLE_H
+
+/*
+* Copyright 2026 Rochus Keller <mailto:me@rochus-keller.ch>
+*
+* This file is part of the EbnfStudio application.
+*
+* The following is the license that applies to this copy of the
+* application. For a license to use the application under conditions
+* other than those described here, please email to me@rochus-keller.ch.
+*
+* GNU General Public License Usage
+* This file may be used under the terms of the GNU General Public
+* License (GPL) versions 2.0 or 3.0 as published by the Free Software
+* Foundation and appearing in the file LICENSE.GPL included in
+* the packaging of this file. Please review the following information
+* to ensure GNU General Public Licensing requirements will be met:
+* http://www.fsf.org/licensing/licenses/info/GPLv2.html and
+* http://www.gnu.org/copyleft/gpl.html.
+*/
+
+#include <QSharedData>
+#include <QHash>
+#include <QMutex>
+#include "EbnfToken.h"
+#include "AstArena.h"
+
+// Interns the identifiers and literals of a syntax. The characters of a Sym live in the arena of
+// the table, preceded by their length, and stay valid until clear() or until the last reference to
+// the table is gone. Lexer and syntax share one table; interning is synchronized, reading a Sym
+// is not, so a finished syntax can be read from any thread.
+class SymbolTable : public QSharedData
+{
+public:
+    SymbolTable() {}
+
+    EbnfToken::Sym intern( const QByteArray& );
+    EbnfToken::Sym find( const QByteArray& ) const; // a null Sym if not interned
+    void clear(); // all Syms of the table are invalid afterwards
+    int getCount() const;
+    quint32 getAllocated() const;
+private:
+    Q_DISABLE_COPY(SymbolTable)
+    QHash<QByteArray,EbnfToken::Sym> d_syms; // the keys refer to the arena
+    AstArena d_arena;
+    mutable QMutex d_lock;
+};
+
+typedef QExplicitlySharedDataPointer<SymbolTable> SymbolTableRef;
+
+#endif // SYMBOLTABLE_H
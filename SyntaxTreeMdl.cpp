@@ -22,6 +22,8 @@
 #include <QPixmap>
 #include <QtDebug>
 #include <QTreeView>
+#include <algorithm>
+#include <string.h>
 
 SyntaxTreeMdl::SyntaxTreeMdl(QTreeView* parent) :
     QAbstractItemModel(parent)
@@ -36,11 +38,10 @@ QTreeView*SyntaxTreeMdl::getParent() const
 
 void SyntaxTreeMdl::setSyntax( EbnfSyntax* syn )
 {
-    beginResetModel();
-    d_root = Slot();
+    // the old syntax must live until its symbols are compared with the new ones
+    EbnfSyntaxRef old = d_syn;
     d_syn = syn;
-    fillTop();
-    endResetModel();
+    reconcileTop();
 }
 
 const Ast::Symbol* SyntaxTreeMdl::getSymbol(const QModelIndex& index) const
@@ -54,7 +55,57 @@ const Ast::Symbol* SyntaxTreeMdl::getSymbol(const QModelIndex& index) const
 
 QModelIndex SyntaxTreeMdl::findSymbol(quint32 line, quint16 col)
 {
-    return findSymbol( &d_root, line, col );
+    if( d_syn.constData() == 0 )
+        return QModelIndex();
+    const Ast::Symbol* sym = d_syn->findSymbolAt( line, col );
+    if( sym == 0 )
+        return QModelIndex();
+
+    Subs path;
+    const Ast::Definition* def;
+    if( sym->d_tok.d_type == EbnfToken::Production )
+        def = static_cast<const Ast::Definition*>( sym );
+    else
+    {
+        const Ast::Node* n = static_cast<const Ast::Node*>( sym );
+        def = n->d_owner;
+        while( n )
+        {
+            path.prepend( n );
+            n = n->d_parent;
+        }
+    }
+    if( def == 0 )
+        return QModelIndex();
+
+    const QString key = keyOf( def );
+    int lo = 0;
+    int hi = d_root.d_children.size();
+    while( lo < hi )
+    {
+        const int mid = ( lo + hi ) / 2;
+        if( d_root.d_children[mid]->d_key < key )
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    const int row = lo;
+    if( row >= d_root.d_children.size() || d_root.d_children[row]->d_sym != def )
+        return QModelIndex(); // e.g. a pragma
+    QModelIndex index = createIndex( row, 0, d_root.d_children[row] );
+
+    foreach( const Ast::Symbol* step, path )
+    {
+        Slot* s = getSlot( index );
+        fetchMore( index );
+        int i = 0;
+        while( i < s->d_children.size() && s->d_children[i]->d_sym != step )
+            i++;
+        if( i >= s->d_children.size() )
+            return QModelIndex();
+        index = createIndex( i, 0, s->d_children[i] );
+    }
+    return index;
 }
 
 static inline QString _quant( quint8 q, const QString& txt, bool nullable = false, bool repeatable = false )
@@ -197,56 +248,179 @@ Qt::ItemFlags SyntaxTreeMdl::flags( const QModelIndex & index ) const
     return Qt::ItemIsEnabled | Qt::ItemIsSelectable; //  | Qt::ItemIsDragEnabled;
 }
 
-void SyntaxTreeMdl::fillTop()
+bool SyntaxTreeMdl::hasChildren(const QModelIndex& parent) const
 {
-    if( d_syn.constData() == 0 )
-        return;
-    typedef QMultiMap<QString,Ast::Definition*> Sorter;
-    Sorter sorter;
-    for( EbnfSyntax::Definitions::const_iterator i = d_syn->getDefs().begin(); i != d_syn->getDefs().end(); ++i )
-        sorter.insert( i.key().toStr().toLower(), i.value() );
+    const Slot* s = getSlot( parent );
+    if( s->d_filled )
+        return !s->d_children.isEmpty();
+    else
+        return !subsOf( s->d_sym ).isEmpty();
+}
 
-    for( Sorter::const_iterator j = sorter.begin(); j != sorter.end(); ++j )
-    {
-        Slot* s = new Slot();
-        s->d_parent = &d_root;
-        s->d_sym = j.value();
-        d_root.d_children.append( s );
+bool SyntaxTreeMdl::canFetchMore(const QModelIndex& parent) const
+{
+    const Slot* s = getSlot( parent );
+    return !s->d_filled && !subsOf( s->d_sym ).isEmpty();
+}
 
-        fill( s, j.value()->d_node );
+void SyntaxTreeMdl::fetchMore(const QModelIndex& parent)
+{
+    Slot* s = getSlot( parent );
+    if( s->d_filled )
+        return;
+    const int count = subsOf( s->d_sym ).size();
+    if( count == 0 )
+    {
+        s->d_filled = true;
+        return;
     }
+    beginInsertRows( parent, 0, count - 1 );
+    fill( s );
+    endInsertRows();
+}
+
+SyntaxTreeMdl::Slot* SyntaxTreeMdl::getSlot(const QModelIndex& index) const
+{
+    if( !index.isValid() )
+        return const_cast<Slot*>( &d_root );
+    Slot* s = static_cast<Slot*>( index.internalPointer() );
+    Q_ASSERT( s != 0 );
+    return s;
 }
 
-QModelIndex SyntaxTreeMdl::findSymbol(SyntaxTreeMdl::Slot* slot, quint32 line, quint16 col) const
+SyntaxTreeMdl::Subs SyntaxTreeMdl::subsOf(const Ast::Symbol* sym)
 {
-    for( int i = 0; i < slot->d_children.size(); i++ )
+    Subs res;
+    if( sym == 0 )
+        return res;
+    if( sym->d_tok.d_type == EbnfToken::Production )
+    {
+        const Ast::Definition* d = static_cast<const Ast::Definition*>( sym );
+        if( d->d_node )
+            res.append( d->d_node );
+    }else
     {
-        Slot* s = slot->d_children[i];
-        if( s->d_sym->d_tok.d_lineNr == line && s->d_sym->d_tok.d_colNr <= col &&
-                col < ( s->d_sym->d_tok.d_colNr + s->d_sym->d_tok.d_len ) )
-            return createIndex( i, 0, s );
-        QModelIndex index = findSymbol( s, line, col );
-        if( index.isValid() )
-            return index;
+        foreach( const Ast::Node* sub, static_cast<const Ast::Node*>( sym )->d_subs )
+            res.append( sub );
     }
-    return QModelIndex();
+    return res;
+}
 
+bool SyntaxTreeMdl::sameKind(const Ast::Symbol* lhs, const Ast::Symbol* rhs)
+{
+    if( lhs->d_tok.d_type != rhs->d_tok.d_type )
+        return false;
+    if( lhs->d_tok.d_type != EbnfToken::Production &&
+            static_cast<const Ast::Node*>( lhs )->d_type != static_cast<const Ast::Node*>( rhs )->d_type )
+        return false;
+    return ::strcmp( lhs->d_tok.d_val.c_str(), rhs->d_tok.d_val.c_str() ) == 0;
 }
 
-void SyntaxTreeMdl::fill(Slot* super, const Ast::Node* sym )
+QString SyntaxTreeMdl::keyOf(const Ast::Definition* d)
 {
-    if( sym == 0 )
-        return;
+    // case insensitive, but unique
+    const QString name = d->d_tok.d_val.toStr();
+    return name.toLower() + QChar(0) + name;
+}
 
-    Slot* s = new Slot();
-    s->d_parent = super;
-    s->d_sym = sym;
-    super->d_children.append( s );
+typedef QPair<QString,Ast::Definition*> KeyDef;
 
+static bool keyDefLessThan( const KeyDef& lhs, const KeyDef& rhs )
+{
+    return lhs.first < rhs.first;
+}
 
-    foreach( const Ast::Node* sub, sym->d_subs )
+void SyntaxTreeMdl::reconcileTop()
+{
+    QList<KeyDef> defs;
+    if( d_syn.constData() != 0 )
     {
-        fill(s, sub );
+        for( EbnfSyntax::Definitions::const_iterator i = d_syn->getDefs().begin(); i != d_syn->getDefs().end(); ++i )
+            defs.append( qMakePair( keyOf( i.value() ), i.value() ) );
+        std::sort( defs.begin(), defs.end(), keyDefLessThan );
     }
+
+    // merge the sorted productions with the rows; rows of the same name are kept
+    QList<Slot*>& rows = d_root.d_children;
+    int row = 0;
+    int j = 0;
+    while( row < rows.size() || j < defs.size() )
+    {
+        if( row < rows.size() && j < defs.size() && rows[row]->d_key == defs[j].first )
+        {
+            reconcile( rows[row], createIndex( row, 0, rows[row] ), defs[j].second );
+            row++;
+            j++;
+        }else if( row < rows.size() && ( j == defs.size() || !( defs[j].first < rows[row]->d_key ) ) )
+        {
+            int end = row + 1;
+            while( end < rows.size() && ( j == defs.size() || rows[end]->d_key < defs[j].first ) )
+                end++;
+            beginRemoveRows( QModelIndex(), row, end - 1 );
+            for( int i = row; i < end; i++ )
+                delete rows[i];
+            rows.erase( rows.begin() + row, rows.begin() + end );
+            endRemoveRows();
+        }else
+        {
+            int end = j + 1;
+            while( end < defs.size() && ( row == rows.size() || defs[end].first < rows[row]->d_key ) )
+                end++;
+            beginInsertRows( QModelIndex(), row, row + end - j - 1 );
+            for( int i = j; i < end; i++ )
+            {
+                Slot* s = new Slot();
+                s->d_parent = &d_root;
+                s->d_sym = defs[i].second;
+                s->d_key = defs[i].first;
+                rows.insert( row++, s );
+            }
+            endInsertRows();
+            j = end;
+        }
+    }
+    d_root.d_filled = true;
+    if( !rows.isEmpty() )
+        emit dataChanged( createIndex( 0, 0, rows.first() ), createIndex( rows.size() - 1, 0, rows.last() ) );
 }
 
+void SyntaxTreeMdl::reconcile(Slot* s, const QModelIndex& index, const Ast::Symbol* sym)
+{
+    s->d_sym = sym;
+    if( !s->d_filled )
+        return;
+    const Subs subs = subsOf( sym );
+    bool same = subs.size() == s->d_children.size();
+    for( int i = 0; same && i < subs.size(); i++ )
+        same = sameKind( s->d_children[i]->d_sym, subs[i] );
+    if( same )
+    {
+        for( int i = 0; i < subs.size(); i++ )
+            reconcile( s->d_children[i], createIndex( i, 0, s->d_children[i] ), subs[i] );
+        if( !subs.isEmpty() )
+            emit dataChanged( createIndex( 0, 0, s->d_children.first() ),
+                              createIndex( subs.size() - 1, 0, s->d_children.last() ) );
+        return;
+    }
+    // the subtree changed its shape; its rows are created again when asked for
+    if( !s->d_children.isEmpty() )
+    {
+        beginRemoveRows( index, 0, s->d_children.size() - 1 );
+        foreach( Slot* sub, s->d_children )
+            delete sub;
+        s->d_children.clear();
+        endRemoveRows();
+    }
+    s->d_filled = false;
+    fetchMore( index );
+}
+
+void SyntaxTreeMdl::fill(Slot* super)
+{
+    foreach( const Ast::Symbol* sub, subsOf( super->d_sym ) )
+    {
+        Slot* s = new Slot( super );
+        s->d_sym = sub;
+    }
+    super->d_filled = true;
+}
@@ -31,9 +31,10 @@ public:
     explicit SyntaxTreeMdl(QTreeView *parent = 0);
 
     QTreeView* getParent() const;
+    // keeps the rows of the productions and expanded subtrees which didn't change their shape
     void setSyntax( EbnfSyntax* );
     const Ast::Symbol* getSymbol( const QModelIndex & ) const;
-    QModelIndex findSymbol( quint32 line, quint16 col );
+    QModelIndex findSymbol( quint32 line, quint16 col ); // fetches the rows on the way
 
     // overrides
     int columnCount ( const QModelIndex & parent = QModelIndex() ) const { return 1; }
@@ -42,19 +43,30 @@ public:
     QModelIndex parent ( const QModelIndex & index ) const;
     int rowCount ( const QModelIndex & parent = QModelIndex() ) const;
     Qt::ItemFlags flags ( const QModelIndex & index ) const;
+    bool hasChildren( const QModelIndex & parent = QModelIndex() ) const;
+    bool canFetchMore( const QModelIndex & parent ) const;
+    void fetchMore( const QModelIndex & parent );
 
 private:
+    // the children of a slot are only created when the view asks for them
     struct Slot
     {
         const Ast::Symbol* d_sym;
         QList<Slot*> d_children;
         Slot* d_parent;
-        Slot(Slot* p = 0):d_parent(p){ if( p ) p->d_children.append(this); }
+        QString d_key; // sort key of the productions
+        bool d_filled;
+        Slot(Slot* p = 0):d_sym(0),d_parent(p),d_filled(false){ if( p ) p->d_children.append(this); }
         ~Slot() { foreach( Slot* s, d_children ) delete s; }
     };
-    void fill(Slot* super, const Ast::Node* sym);
-    void fillTop();
-    QModelIndex findSymbol(Slot*, quint32 line, quint16 col ) const;
+    typedef QList<const Ast::Symbol*> Subs;
+    static Subs subsOf( const Ast::Symbol* );
+    static bool sameKind( const Ast::Symbol*, const Ast::Symbol* );
+    static QString keyOf( const Ast::Definition* );
+    void fill( Slot* );
+    void reconcile( Slot*, const QModelIndex&, const Ast::Symbol* );
+    void reconcileTop();
+    Slot* getSlot( const QModelIndex& ) const;
     Slot d_root;
     EbnfSyntaxRef d_syn;
 };
@@ -0,0 +1,145 @@
+/*
+* Copyright 2026 Rochus Keller <mailto:me@rochus-keller.ch>
+*
+* This file is part of the EbnfStudio application.
+*
+* The following is the license that applies to this copy of the
+* application. For a license to use the application under conditions
+* other than those described here, please email to me@rochus-keller.ch.
+*
+* GNU General Public License Usage
+* This file may be used under the terms of the GNU General Public
+* License (GPL) versions 2.0 or 3.0 as published by the Free Software
+* Foundation and appearing in the file LICENSE.GPL included in
+* the packaging of this file. Please review the following information
+* to ensure GNU General Public Licensing requirements will be met:
+* http://www.fsf.org/licensing/licenses/info/GPLv2.html and
+* http://www.gnu.org/copyleft/gpl.html.
+*/
+
+#include "TermSet.h"
+
+void TermSet::reserve(int maxId)
+{
+    const int words = ( maxId >> 6 ) + 1;
+    if( d_bits.size() < words )
+        d_bits.resize( words ); // new words are zero
+}
+
+void TermSet::insert(quint16 id)
+{
+    reserve( id );
+    d_bits[ id >> 6 ] |= quint64(1) << ( id & 63 );
+}
+
+void TermSet::remove(quint16 id)
+{
+    const int w = id >> 6;
+    if( w < d_bits.size() )
+        d_bits[w] &= ~( quint64(1) << ( id & 63 ) );
+}
+
+bool TermSet::isEmpty() const
+{
+    for( int i = 0; i < d_bits.size(); i++ )
+    {
+        if( d_bits[i] )
+            return false;
+    }
+    return true;
+}
+
+int TermSet::count() const
+{
+    int res = 0;
+    for( int i = 0; i < d_bits.size(); i++ )
+    {
+        quint64 w = d_bits[i];
+        while( w )
+        {
+            w &= w - 1;
+            res++;
+        }
+    }
+    return res;
+}
+
+QList<quint16> TermSet::toList() const
+{
+    QList<quint16> res;
+    for( int i = 0; i < d_bits.size(); i++ )
+    {
+        const quint64 w = d_bits[i];
+        if( w == 0 )
+            continue;
+        for( int b = 0; b < 64; b++ )
+        {
+            if( w & ( quint64(1) << b ) )
+                res.append( quint16( ( i << 6 ) + b ) );
+        }
+    }
+    return res;
+}
+
+TermSet& TermSet::operator|=(const TermSet& rhs)
+{
+    if( d_bits.size() < rhs.d_bits.size() )
+        d_bits.resize( rhs.d_bits.size() );
+    quint64* l = d_bits.data();
+    const quint64* r = rhs.d_bits.constData();
+    for( int i = 0; i < rhs.d_bits.size(); i++ )
+        l[i] |= r[i];
+    return *this;
+}
+
+bool TermSet::unite(const TermSet& rhs)
+{
+    if( d_bits.size() < rhs.d_bits.size() )
+        d_bits.resize( rhs.d_bits.size() );
+    quint64* l = d_bits.data();
+    const quint64* r = rhs.d_bits.constData();
+    quint64 added = 0;
+    for( int i = 0; i < rhs.d_bits.size(); i++ )
+    {
+        added |= r[i] & ~l[i];
+        l[i] |= r[i];
+    }
+    return added != 0;
+}
+
+TermSet& TermSet::operator&=(const TermSet& rhs)
+{
+    if( d_bits.size() > rhs.d_bits.size() )
+        d_bits.resize( rhs.d_bits.size() );
+    quint64* l = d_bits.data();
+    const quint64* r = rhs.d_bits.constData();
+    for( int i = 0; i < d_bits.size(); i++ )
+        l[i] &= r[i];
+    return *this;
+}
+
+bool TermSet::intersects(const TermSet& rhs) const
+{
+    const int n = qMin( d_bits.size(), rhs.d_bits.size() );
+    const quint64* l = d_bits.constData();
+    const quint64* r = rhs.d_bits.constData();
+    for( int i = 0; i < n; i++ )
+    {
+        if( l[i] & r[i] )
+            return true;
+    }
+    return false;
+}
+
+bool TermSet::operator==(const TermSet& rhs) const
+{
+    const int n = qMax( d_bits.size(), rhs.d_bits.size() );
+    for( int i = 0; i < n; i++ )
+    {
+        const quint64 l = i < d_bits.size() ? d_bits[i] : 0;
+        const quint64 r = i < rhs.d_bits.size() ? rhs.d_bits[i] : 0;
+        if( l != r )
+            return false;
+    }
+    return true;
+}
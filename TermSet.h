@@ -0,0 +1,60 @@
+#ifndef TERMSET_H
+#define TERMSET_H
+
+/*
+* Copyright 2026 Rochus Keller <mailto:me@rochus-keller.ch>
+*
+* This file is part of the EbnfStudio application.
+*
+* The following is the license that applies to this copy of the
+* application. For a license to use the application under conditions
+* other than those described here, please email to me@rochus-keller.ch.
+*
+* GNU General Public License Usage
+* This file may be used under the terms of the GNU General Public
+* License (GPL) versions 2.0 or 3.0 as published by the Free Software
+* Foundation and appearing in the file LICENSE.GPL included in
+* the packaging of this file. Please review the following information
+* to ensure GNU General Public Licensing requirements will be met:
+* http://www.fsf.org/licensing/licenses/info/GPLv2.html and
+* http://www.gnu.org/copyleft/gpl.html.
+*/
+
+#include <QVector>
+#include <QList>
+
+// Dense set of terminal ids (see Ast::Node::d_termId), one bit per id. Union, intersection and
+// the emptiness tests are a few word operations; sets of different length are treated as
+// zero-extended.
+class TermSet
+{
+public:
+    TermSet() {}
+    explicit TermSet( int maxId ) { reserve( maxId ); }
+
+    void reserve( int maxId ); // ids up to maxId can be inserted without reallocation
+    void insert( quint16 id );
+    void remove( quint16 id );
+    bool contains( quint16 id ) const
+    {
+        const int w = id >> 6;
+        return w < d_bits.size() && ( d_bits[w] & ( quint64(1) << ( id & 63 ) ) );
+    }
+    bool isEmpty() const;
+    int count() const;
+    void clear() { d_bits.clear(); }
+    QList<quint16> toList() const; // ascending
+
+    TermSet& operator|=( const TermSet& );
+    bool unite( const TermSet& ); // |=, returns true if ids were added
+    TermSet& operator&=( const TermSet& );
+    TermSet operator|( const TermSet& rhs ) const { TermSet res = *this; res |= rhs; return res; }
+    TermSet operator&( const TermSet& rhs ) const { TermSet res = *this; res &= rhs; return res; }
+    bool intersects( const TermSet& ) const;
+    bool operator==( const TermSet& ) const;
+    bool operator!=( const TermSet& rhs ) const { return !( *this == rhs ); }
+private:
+    QVector<quint64> d_bits;
+};
+
+#endif // TERMSET_H
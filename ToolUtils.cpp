@@ -0,0 +1,47 @@
+/*
+* Copyright 2026 Rochus Keller <mailto:me@rochus-keller.ch>
+*
+* This file is part of the EbnfStudio application.
+*
+* The following is the license that applies to this copy of the
+* application. For a license to use the application under conditions
+* other than those described here, please email to me@rochus-keller.ch.
+*
+* GNU General Public License Usage
+* This file may be used under the terms of the GNU General Public
+* License (GPL) versions 2.0 or 3.0 as published by the Free Software
+* Foundation and appearing in the file LICENSE.GPL included in
+* the packaging of this file. Please review the following information
+* to ensure GNU General Public Licensing requirements will be met:
+* http://www.fsf.org/licensing/licenses/info/GPLv2.html and
+* http://www.gnu.org/copyleft/gpl.html.
+*/
+
+#include "ToolUtils.h"
+#include <QFile>
+#include <QFileInfo>
+#include <QDir>
+
+void ToolUtils::lexOnly( const QString& path, const EbnfLexer::Keywords& kw )
+{
+    QFile file(path);
+    if( !file.open(QIODevice::ReadOnly ) )
+        return;
+    EbnfLexer lex;
+    lex.setKeywords( kw );
+    lex.setStream( &file );
+    while( lex.nextToken().d_type != EbnfToken::Eof )
+        ;
+}
+
+void ToolUtils::addGrammars( const QString& arg, QStringList& paths )
+{
+    QFileInfo info( arg );
+    if( info.isDir() )
+    {
+        QDir dir( arg );
+        foreach( const QString& name, dir.entryList( QStringList() << "*.ebnf", QDir::Files, QDir::Name ) )
+            paths.append( dir.filePath( name ) );
+    }else if( info.suffix().toLower() == "ebnf" )
+        paths.append( arg );
+}
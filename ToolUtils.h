@@ -0,0 +1,38 @@
+#ifndef TOOLUTILS_H
+#define TOOLUTILS_H
+
+/*
+* Copyright 2026 Rochus Keller <mailto:me@rochus-keller.ch>
+*
+* This file is part of the EbnfStudio application.
+*
+* The following is the license that applies to this copy of the
+* application. For a license to use the application under conditions
+* other than those described here, please email to me@rochus-keller.ch.
+*
+* GNU General Public License Usage
+* This file may be used under the terms of the GNU General Public
+* License (GPL) versions 2.0 or 3.0 as published by the Free Software
+* Foundation and appearing in the file LICENSE.GPL included in
+* the packaging of this file. Please review the following information
+* to ensure GNU General Public Licensing requirements will be met:
+* http://www.fsf.org/licensing/licenses/info/GPLv2.html and
+* http://www.gnu.org/copyleft/gpl.html.
+*/
+
+#include <QStringList>
+#include "EbnfLexer.h"
+
+// Helpers shared by the command line tools ebnfc and ebnfbench
+class ToolUtils
+{
+public:
+    // reads all tokens of the file, so the lexer can be timed apart from the parser which pulls them
+    static void lexOnly( const QString& path, const EbnfLexer::Keywords& );
+    // appends arg if it is an EBNF file, or the EBNF files in it by name if it is a directory
+    static void addGrammars( const QString& arg, QStringList& paths );
+private:
+    ToolUtils();
+};
+
+#endif // TOOLUTILS_H
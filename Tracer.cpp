@@ -0,0 +1,135 @@
+/*
+* Copyright 2026 Rochus Keller <mailto:me@rochus-keller.ch>
+*
+* This file is part of the EbnfStudio application.
+*
+* The following is the license that applies to this copy of the
+* application. For a license to use the application under conditions
+* other than those described here, please email to me@rochus-keller.ch.
+*
+* GNU General Public License Usage
+* This file may be used under the terms of the GNU General Public
+* License (GPL) versions 2.0 or 3.0 as published by the Free Software
+* Foundation and appearing in the file LICENSE.GPL included in
+* the packaging of this file. Please review the following information
+* to ensure GNU General Public Licensing requirements will be met:
+* http://www.fsf.org/licensing/licenses/info/GPLv2.html and
+* http://www.gnu.org/copyleft/gpl.html.
+*/
+
+#include "Tracer.h"
+#include <QFile>
+#include <QThread>
+
+Tracer* Tracer::s_active = 0;
+
+QByteArray Tracer::quoted( const QByteArray& str )
+{
+    QByteArray res = "\"";
+    for( int i = 0; i < str.size(); i++ )
+    {
+        const char ch = str[i];
+        if( ch == '"' || ch == '\\' )
+        {
+            res += '\\';
+            res += ch;
+        }else if( quint8(ch) < 0x20 )
+            res += "\\u00" + QByteArray::number( quint8(ch), 16 ).rightJustified( 2, '0' );
+        else
+            res += ch;
+    }
+    res += '"';
+    return res;
+}
+
+static QByteArray toUs( qint64 nsecs )
+{
+    return QByteArray::number( double(nsecs) / 1000.0, 'f', 3 );
+}
+
+Tracer::Tracer()
+{
+    d_clock.start();
+}
+
+Tracer::~Tracer()
+{
+    deactivate();
+}
+
+void Tracer::activate()
+{
+    QMutexLocker lock(&d_lock);
+    if( d_tids.isEmpty() )
+        d_tids.insert( QThread::currentThreadId(), 1 );
+    s_active = this;
+}
+
+void Tracer::deactivate()
+{
+    if( s_active == this )
+        s_active = 0;
+}
+
+void Tracer::add(const char* name, qint64 start, qint64 end, const QByteArray& args)
+{
+    QMutexLocker lock(&d_lock);
+    Event e;
+    e.d_name = name;
+    e.d_start = start;
+    e.d_dur = end - start;
+    const Qt::HANDLE thread = QThread::currentThreadId();
+    QHash<Qt::HANDLE,int>::const_iterator i = d_tids.find( thread );
+    if( i == d_tids.end() )
+        i = d_tids.insert( thread, d_tids.size() + 1 );
+    e.d_tid = i.value();
+    e.d_args = args;
+    d_events.append( e );
+}
+
+bool Tracer::write(const QString& path) const
+{
+    QFile out( path );
+    if( !out.open( QIODevice::WriteOnly ) )
+        return false;
+    QMutexLocker lock(&d_lock);
+    out.write( "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n" );
+    for( int tid = 1; tid <= d_tids.size(); tid++ )
+    {
+        const QByteArray name = tid == 1 ? "main" : "worker " + QByteArray::number( tid - 1 );
+        out.write( "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" + QByteArray::number( tid ) +
+                   ",\"args\":{\"name\":" + quoted( name ) + "}},\n" );
+    }
+    for( int i = 0; i < d_events.size(); i++ )
+    {
+        const Event& e = d_events[i];
+        QByteArray line = "{\"name\":" + quoted( e.d_name ) + ",\"ph\":\"X\",\"pid\":1,\"tid\":" +
+                QByteArray::number( e.d_tid ) + ",\"ts\":" + toUs( e.d_start ) + ",\"dur\":" + toUs( e.d_dur );
+        if( !e.d_args.isEmpty() )
+            line += ",\"args\":{" + e.d_args + "}";
+        line += "}";
+        if( i + 1 < d_events.size() )
+            line += ",";
+        out.write( line + "\n" );
+    }
+    out.write( "]}\n" );
+    return true;
+}
+
+void TraceSpan::addArg(const char* key, const QByteArray& value)
+{
+    if( d_tracer == 0 )
+        return;
+    if( !d_args.isEmpty() )
+        d_args += ',';
+    d_args += Tracer::quoted( key ) + ":" + Tracer::quoted( value );
+}
+
+void TraceSpan::addArg(const char* key, qint64 value)
+{
+    if( d_tracer == 0 )
+        return;
+    if( !d_args.isEmpty() )
+        d_args += ',';
+    d_args += Tracer::quoted( key ) + ":" + QByteArray::number( value );
+}
@@ -0,0 +1,86 @@
+#ifndef TRACER_H
+#define TRACER_H
+
+/*
+* Copyright 2026 Rochus Keller <mailto:me@rochus-keller.ch>
+*
+* This file is part of the EbnfStudio application.
+*
+* The following is the license that applies to this copy of the
+* application. For a license to use the application under conditions
+* other than those described here, please email to me@rochus-keller.ch.
+*
+* GNU General Public License Usage
+* This file may be used under the terms of the GNU General Public
+* License (GPL) versions 2.0 or 3.0 as published by the Free Software
+* Foundation and appearing in the file LICENSE.GPL included in
+* the packaging of this file. Please review the following information
+* to ensure GNU General Public Licensing requirements will be met:
+* http://www.fsf.org/licensing/licenses/info/GPLv2.html and
+* http://www.gnu.org/copyleft/gpl.html.
+*/
+
+#include <QByteArray>
+#include <QList>
+#include <QHash>
+#include <QMutex>
+#include <QElapsedTimer>
+
+// Opt-in recording of nested spans, written in the Chrome trace event format (see ebnfc --trace)
+// which chrome://tracing and Perfetto load. TraceSpan reports to the active Tracer; while there
+// is none it only copies a null pointer. Spans may end in any thread.
+class Tracer
+{
+public:
+    Tracer();
+    ~Tracer();
+    void activate(); // before any worker is started
+    void deactivate(); // after all workers finished
+    bool write( const QString& path ) const;
+
+    static Tracer* getActive() { return s_active; }
+    qint64 now() const { return d_clock.nsecsElapsed(); }
+    void add( const char* name, qint64 start, qint64 end, const QByteArray& args );
+    static QByteArray quoted( const QByteArray& ); // as a JSON string, also used by PhaseStats
+private:
+    Q_DISABLE_COPY(Tracer)
+    struct Event
+    {
+        const char* d_name;
+        qint64 d_start; // nanoseconds
+        qint64 d_dur;
+        int d_tid;
+        QByteArray d_args; // JSON members
+    };
+    QList<Event> d_events;
+    QHash<Qt::HANDLE,int> d_tids;
+    mutable QMutex d_lock;
+    QElapsedTimer d_clock;
+    static Tracer* s_active;
+};
+
+class TraceSpan
+{
+public:
+    explicit TraceSpan( const char* name ):d_tracer(Tracer::getActive()),d_name(name),d_start(0)
+    {
+        if( d_tracer )
+            d_start = d_tracer->now();
+    }
+    ~TraceSpan()
+    {
+        if( d_tracer )
+            d_tracer->add( d_name, d_start, d_tracer->now(), d_args );
+    }
+    bool isActive() const { return d_tracer != 0; } // check before preparing an argument
+    void addArg( const char* key, const QByteArray& value );
+    void addArg( const char* key, qint64 value );
+private:
+    Q_DISABLE_COPY(TraceSpan)
+    Tracer* d_tracer;
+    const char* d_name; // a literal
+    qint64 d_start;
+    QByteArray d_args;
+};
+
+#endif // TRACER_H